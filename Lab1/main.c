@@ -2,6 +2,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "peripherals.h"
+#include "swtimer.h"
+#include "hsm.h"
+#include "prng.h"
+#include "simon_engine.h"
+#include "settings.h"
 #include "String.h"
 
 
@@ -10,30 +15,29 @@
  */
 
 // Function Prototypes
-void swDelay(char numLoops);
-void PlaySequence(int seq_turn, int speed);
-void DisplayCountDown();
-void DisplaySoundNumber(int number, int speed);
 void DisplayNumber(int number);
 void DisplayNumCentered(int number);
 void PlaySound(int number);
-void CheckInput(int speed);
 void ClearDisplay(void);
 void SimonDisplay(void);
 void GameOverDisplay(void);
 void WonDisplay(void);
+void SeedDisplay(void);
+void RecordScore(uint8_t rounds);
+
+void keypadScan(SWTimer *t);
+void ApplyOutput(HSM *me, const SimonOutput *out);
 
-#define MAX 10          // max number of number in random sequence, i.e. numbers to guess, also max rounds to play
-#define MAX_NOTES 6     // number of notes played in Game Over sequence. to be used for array
 #define OFF 0           // default value to be used to turn off Buzzer, when PWM = 0
 
-int sequence[MAX];      //
-int sequence_turn = 0;  // stores current round number of displaying numbers or of inputting numbers, goes up to MAX - 1 = 9
-bool flag = 0;          // variable to determine whether user input is correct, if correct then flag = 0, otherwise flag = 1
-int count = 0;          // keeps track of the number of times user has inputted number for multiple inputs
+// Play every game from this seed instead of a fresh one, e.g. one shown on the Game Over screen
+//#define SIMON_REPLAY_SEED 0x12345678UL
+
+// Length of one engine delay unit in ms, what one loop of the old swDelay() took at the default 1 MHz MCLK
+#define DELAY_UNIT_MS 40
 
 // Array storing PWM values for Game Over tune.
-int gameOverPitches[MAX_NOTES] = {64, 56, 52, 48, 68, 68};  // little song notes to be played in Game Over sequence
+const int gameOverPitches[SIMON_TUNE_NOTES] = {64, 56, 52, 48, 68, 68};    // little song notes to be played in Game Over sequence
 
 // Constant integers of PWM values for corresponding/associated number
 const int SOUND_1 = 128;    // SOUND_1 is sound to be used for number '1'
@@ -41,137 +45,179 @@ const int SOUND_2 = 96;     // SOUND_2 is sound to be used for number '2'
 const int SOUND_3 = 64;     // SOUND_3 is sound to be used for number '3'
 const int SOUND_4 = 32;     // SOUND_4 is sound to be used for number '4'
 
+// Settings kept in info memory (settings.h)
+#define SETTING_HIGH_SCORE  0                   // most rounds ever completed, one byte
+
+uint8_t highScore = 0;
+
+// Keypad: scanned from a software timer, each new key press is posted once
+#define KEYPAD_SCAN_MS  20
+SWTimer keypadTimer;
+unsigned char lastKey = 0;  // key seen by the previous scan
+
+
+//*****************************************************************************
+//
+// Adapter between the game engine (simon_engine.h) and the board. Key
+// presses and engine timeouts are queued as events; each one is stepped
+// through the engine, and its output is drawn, sounded and timed here.
+// Nothing blocks, so keys pressed while the display or buzzer is busy wait
+// in the queue instead of being lost.
+//
+//*****************************************************************************
+
+// Signals
+#define SIG_KEY         (HSM_SIG_USER + 0)      // param is the key
+#define SIG_TIMEOUT     (HSM_SIG_USER + 1)      // the delay asked for by the engine has passed
+
+SimonEngine game;
+HSM simon;
+HSM_Timer stepTimer;                            // delay until the engine's next timeout
+
+// Time from a key press being posted to its feedback being on the display, in time base ticks
+uint32_t feedbackTicks;                         // last key
+uint32_t maxFeedbackTicks;                      // worst since reset
+
+void playEntry(HSM *me);
+uint8_t playHandler(HSM *me, const HSM_Event *e);
+
+//                              parent  initial entry       exit    handler
+const HSM_State playState   = { 0,      0,      playEntry,  0,      playHandler };
+
+
 int main(void)
 {
     WDTCTL = WDTPW | WDTHOLD;   // stop watchdog timer
 
-    int state = 0;          // state of state machine starts at 0
-    int speed = 10;         // 10 is the lowest speed and 1 is the highest speed to display number
-
-    unsigned char currKey = 0;
-
     // Useful code starts here
     initLeds();
     configDisplay();
     configKeypad();
+    SWTimer_init();
 
-    // Constants for lower and upper range of numbers to be generated
-    const int lower = 1, upper = 4;
+    Settings_init();
+    Settings_get(SETTING_HIGH_SCORE, &highScore, 1);
 
-    // Loop to populate sequence array with random integers between lower and upper, i.e. between 1-4
-    int i;
-    for (i = 0; i < 10; i++) {
+    HSM_init(&simon, &playState, 0);
 
-        sequence[i] = (rand() % (upper - lower + 1)) + lower;   // random integers between lower and upper stored in array index
-    }
+    keypadTimer.callback = keypadScan;
+    SWTimer_startMs(&keypadTimer, KEYPAD_SCAN_MS, KEYPAD_SCAN_MS);
+
+    _BIS_SR(GIE);           // enables interrupts
 
-    // Forever loop
+    // Forever loop: handles each key press and timeout once, and sleeps in between
     while (1) {
+        HSM_dispatchAll(&simon);
+        HSM_sleep(&simon);
+    }
+}
 
-        // State Machine. Switch statements take value of state and proceeds to Case accordingly
-        switch (state) {
 
-        // state 0 calls SimonDisplay() method and then does state++, i.e. state = 1, goes to next state
-        case 0:
-            SimonDisplay();
-            state++;
-            break;
+// Keypad scan, runs from the Timer A1 ISR every KEYPAD_SCAN_MS
+void keypadScan(SWTimer *t) {
+    unsigned char key = getKey();
 
-        // state 1 waits until user inputs '*' by using method getKey()
-        // if currKey == '*', i.e. if user presses '*' then the SIMON screen is cleared,
-        // sequence_turn is set to 0 (round 0), flag = 0 (not incorrect user input),
-        // speed = 10 (slowest speed), and finally state++, i.e. goes to state = 2
-        case 1:
-            currKey = getKey();
-            if (currKey == '*') {
-                ClearDisplay();
-                sequence_turn = 0;
-                flag = 0;
-                speed = 10;
-                state++;
-            }
-            break;
+    if (key && (key != lastKey))
+        HSM_post(&simon, SIG_KEY, key);
+    lastKey = key;
+}
 
-        // Calls method to display countdown before game begins, then state++, i.e.  state = 3
-        case 2:
-            DisplayCountDown();
-            state++;
-            break;
 
-        // Calls PlaySequence() based on sequence_turn and speed, sets count = 0 which is used in next state
-        // Then goes to next state, i.e. state = 4
-        case 3:
-            PlaySequence(sequence_turn, speed);
-            count = 0;
-            state++;
-            break;
+// Starts the engine on the title screen
+void playEntry(HSM *me) {
+    SimonOutput out;
 
-        // Calls CheckInput() method to check user input, if flag is triggered, i.e. flag == 1, then
-        // state = 5, i.e. Game Over state; if sequence_turn == (MAX - 1), i.e. we reached end of game then
-        // state = 6, i.e. You Won state; otherwise, ClearDisplay() sequence_turn++ (increase round number),
-        // speed--, i.e. the actual speed is increased (goes faster), and state = 3, i.e. back to PlaySequence() state
-        case 4:
-            CheckInput(speed);
-
-            if (flag == 1) {
-                ClearDisplay();
-                state = 5;
-            }
-            else if (sequence_turn == (MAX - 1)) {
-                state = 6;
-            }
-            else {
-                ClearDisplay();
-                sequence_turn++;
-                speed--;
-                state = 3;
-            }
-            break;
-
-        // Calls GameOverDisplay() to display end of game and humiliation message, then back to state = 0, i.e. initial state
-        case 5:
-            GameOverDisplay();
-            state = 0;
-            break;
+    SimonEngine_init(&game, &out);
+    ApplyOutput(me, &out);
+}
 
-        // Calls YouWon() to display You Won! message, then back to state = 0, i.e. initial state
-        case 6:
-            WonDisplay();
-            state = 0;
-            break;
+// Feeds every key press and timeout to the engine
+uint8_t playHandler(HSM *me, const HSM_Event *e) {
+    SimonInput in;
+    SimonOutput out;
+
+    if (e->sig == SIG_KEY) {
+        in.type = SIMON_IN_KEY;
+        in.key = e->param;
+        in.seed = 0;
+
+        // a key that may start a game gets a fresh seed, from ADC noise and the time of the key press
+        if (SimonEngine_wantsSeed(&game)) {
+#ifdef SIMON_REPLAY_SEED
+            in.seed = SIMON_REPLAY_SEED;
+#else
+            in.seed = Prng_entropySeed();
+#endif
         }
+    } else if (e->sig == SIG_TIMEOUT) {
+        in.type = SIMON_IN_TIMEOUT;
+        in.key = 0;
+        in.seed = 0;
+    } else {
+        return HSM_SUPER;
     }
-}
-
-void PlaySequence(int seq_turn, int speed) {
 
-    int x;
-    for (x = 0; x < (seq_turn + 1); x++) {
+    SimonEngine_step(&game, &in, &out);
+    ApplyOutput(me, &out);
 
-        int num = sequence[x];
-        DisplaySoundNumber(num, speed);
+    if ((e->sig == SIG_KEY) && (out.display != SIMON_SHOW_NOTHING)) {
+        feedbackTicks = Timebase_ticks() - e->stamp;
+        if (feedbackTicks > maxFeedbackTicks)
+            maxFeedbackTicks = feedbackTicks;
     }
 
+    return HSM_HANDLED;
 }
 
-void DisplayCountDown() {
-    int x;
-    for (x = 3; x >= 0; x--) {
-        DisplayNumCentered(x);
-        swDelay(10);
+// Carries out one engine output: display, then buzzer, then the timer for the next timeout
+void ApplyOutput(HSM *me, const SimonOutput *out) {
+
+    switch (out->display) {
+    case SIMON_SHOW_CLEAR:
         ClearDisplay();
+        break;
+    case SIMON_SHOW_TITLE:
+        Graphics_clearDisplay(&g_sContext);
+        SimonDisplay();
+        break;
+    case SIMON_SHOW_NUMBER:
+        Graphics_clearDisplay(&g_sContext);
+        DisplayNumber(out->number);
+        break;
+    case SIMON_SHOW_COUNT:
+        Graphics_clearDisplay(&g_sContext);
+        DisplayNumCentered(out->number);
+        break;
+    case SIMON_SHOW_GAME_OVER:
+        Graphics_clearDisplay(&g_sContext);
+        GameOverDisplay();
+        SeedDisplay();
+        RecordScore(game.turn);             // the round that was lost was not completed
+        break;
+    case SIMON_SHOW_WON:
+        Graphics_clearDisplay(&g_sContext);
+        WonDisplay();
+        RecordScore(SIMON_ROUNDS);
+        break;
     }
-}
 
-void DisplaySoundNumber(int number, int speed) {
-    DisplayNumber(number);
-    PlaySound(number);
-    swDelay(speed);
-    Graphics_clearDisplay(&g_sContext);
-    PlaySound(OFF);       // no sound, pwm = 0
-    swDelay(1);
+    switch (out->sound) {
+    case SIMON_SOUND_OFF:
+        PlaySound(OFF);
+        break;
+    case SIMON_SOUND_NUMBER:
+        PlaySound(out->number);
+        break;
+    case SIMON_SOUND_TUNE:
+        PlaySound(gameOverPitches[out->number]);
+        break;
+    }
+
+    if (out->delay)
+        HSM_armTimer(&stepTimer, me, SIG_TIMEOUT, (unsigned long)out->delay * DELAY_UNIT_MS, 0);
 }
 
+
 // Displays a number based on the int parameter that is passed
 // Uses an equation to determine where on the display the number
 // will be located
@@ -253,55 +299,6 @@ void PlaySound(int number) {
         }
 }
 
-void CheckInput(int speed) {
-
-    unsigned char currKey;
-
-    while (!flag & (count <= sequence_turn)) {
-
-        currKey = getKey();
-        int currKeyInt = currKey - '0';
-
-        if (currKeyInt < 5 & currKeyInt > 0) {
-
-            DisplaySoundNumber(currKeyInt, speed);
-
-            if (currKeyInt == sequence[count]) {
-                ClearDisplay();
-                count++;
-            }
-            else {
-                flag = 1;
-            }
-        } else if (currKey != 0) {              // default value that getKey() returns is 0, so this is checking to see if
-            flag = 1;                           // a key other than 1-4 is pressed and NOT default return of 0 which is when nothing
-        }                                       // is pressed. if that is the case, then flag is raised and it is GAME OVER
-    }
-}
-
-
-void swDelay(char numLoops) {
-    // This function is a software delay. It performs
-    // useless loops to waste a bit of time
-    //
-    // Input: numLoops = number of delay loops to execute
-    // Output: none
-    //
-    // smj, ECE2049, 25 Aug 2013
-    // hamayel qureshi, 28 march 2020
-
-    volatile unsigned int i,j;  // volatile to prevent removal in optimization
-                                // by compiler. Functionally this is useless code
-
-    for (j = 0; j < numLoops; j++) {
-
-        i = 5000 ;                 // SW Delay
-        while (i > 0)               // could also have used while (i)
-           i--;
-    }
-}
-
-
 void ClearDisplay() {
 
     Graphics_clearDisplay(&g_sContext);
@@ -311,6 +308,12 @@ void ClearDisplay() {
 
 void SimonDisplay() {
 
+    unsigned char bestASCII[12];
+
+    if (highScore) {
+        sprintf((char *)bestASCII, "BEST %d", highScore);
+        Graphics_drawStringCentered(&g_sContext, bestASCII, AUTO_STRING_LENGTH, 64, 40, TRANSPARENT_TEXT);
+    }
     Graphics_drawStringCentered(&g_sContext, "SIMON", AUTO_STRING_LENGTH, 64, 60, TRANSPARENT_TEXT);
     Graphics_drawStringCentered(&g_sContext, "Start Game", AUTO_STRING_LENGTH, 64, 80, TRANSPARENT_TEXT);
     Graphics_drawStringCentered(&g_sContext, "Press *", AUTO_STRING_LENGTH, 64, 90, TRANSPARENT_TEXT);
@@ -323,15 +326,6 @@ void GameOverDisplay(void) {
     Graphics_drawStringCentered(&g_sContext, "GAME OVER!", AUTO_STRING_LENGTH, 64, 70, TRANSPARENT_TEXT);
     Graphics_drawStringCentered(&g_sContext, "YOU LOST!", AUTO_STRING_LENGTH, 64, 80, TRANSPARENT_TEXT);
     Graphics_flushBuffer(&g_sContext);
-
-    int x;
-    for (x = 0; x < MAX_NOTES; x++) {
-        PlaySound(gameOverPitches[x]);
-        swDelay(4);
-    }
-    swDelay(40);
-    PlaySound(OFF);
-    ClearDisplay();
 }
 
 
@@ -340,7 +334,30 @@ void WonDisplay(void) {
     Graphics_drawStringCentered(&g_sContext, "CONGRATULATIONS!", AUTO_STRING_LENGTH, 64, 70, TRANSPARENT_TEXT);
     Graphics_drawStringCentered(&g_sContext, "YOU WON!", AUTO_STRING_LENGTH, 64, 90, TRANSPARENT_TEXT);
     Graphics_flushBuffer(&g_sContext);
-    swDelay(40);
-    ClearDisplay();
 }
 
+
+// Keeps the most rounds completed in a game across resets
+void RecordScore(uint8_t rounds) {
+
+    if (rounds > highScore) {
+        highScore = rounds;
+        Settings_set(SETTING_HIGH_SCORE, &highScore, 1);
+    }
+}
+
+
+// Shows the game's seed in hex, so a lost game can be replayed with SIMON_REPLAY_SEED
+void SeedDisplay(void) {
+
+    const char hex[] = "0123456789ABCDEF";
+    unsigned char seedASCII[14] = "SEED ";
+    int i;
+
+    for (i = 0; i < 8; i++)
+        seedASCII[5 + i] = hex[(game.seed >> (28 - 4 * i)) & 0x0F];
+    seedASCII[13] = '\0';
+
+    Graphics_drawStringCentered(&g_sContext, seedASCII, AUTO_STRING_LENGTH, 64, 100, TRANSPARENT_TEXT);
+    Graphics_flushBuffer(&g_sContext);
+}
@@ -0,0 +1,88 @@
+/*
+ * prng.c
+ *
+ *  Seeded, replayable pseudo-random numbers. See prng.h.
+ */
+
+#include "prng.h"
+
+#ifndef HOST_BUILD
+#include <msp430.h>
+#include "timebase.h"
+#endif
+
+
+// Integer hash with full avalanche: every input bit affects every output
+// bit, so consecutive indexes give unrelated values
+static uint32_t mix(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7FEB352DUL;
+    x ^= x >> 15;
+    x *= 0x846CA68BUL;
+    x ^= x >> 16;
+    return x;
+}
+
+#ifndef HOST_BUILD
+// Makes a seed from hardware noise. The temperature sensor is converted
+// against the 1.5 V reference with the shortest sample time, which leaves
+// a few bits of noise in every result. Uses the ADC12 on its own and turns
+// it off again, so call it before anything else sets up the ADC.
+uint32_t Prng_entropySeed(void)
+{
+    uint32_t seed = Timebase_ticks();
+    uint16_t i;
+
+    REFCTL0 &= ~REFMSTR;
+    ADC12CTL0 = ADC12SHT0_0 | ADC12REFON | ADC12ON;
+    ADC12CTL1 = ADC12SHP | ADC12SSEL_0 | ADC12CONSEQ_0;
+    ADC12CTL2 = ADC12RES_2;
+    ADC12MCTL0 = ADC12SREF_1 | ADC12INCH_10;
+
+    __delay_cycles(100);                // delay to allow Ref to settle
+    ADC12CTL0 |= ADC12ENC;
+
+    for (i = 0; i < PRNG_ENTROPY_SAMPLES; i++) {
+        ADC12CTL0 |= ADC12SC;
+        while (ADC12CTL1 & ADC12BUSY)
+            ;
+
+        // Rotate in the two noisiest bits of each conversion
+        seed = (seed << 2) | (seed >> 30);
+        seed ^= ADC12MEM0 & 0x03;
+    }
+
+    ADC12CTL0 &= ~ADC12ENC;
+    ADC12CTL0 = 0;
+
+    return mix(seed);
+}
+#endif
+
+// Element index of the sequence belonging to seed
+uint32_t Prng_at(uint32_t seed, uint16_t index)
+{
+    return mix(seed ^ mix(index + 0x9E3779B9UL));
+}
+
+// Element index scaled to lower..upper, from the high bits, which are the
+// best mixed
+uint8_t Prng_range(uint32_t seed, uint16_t index, uint8_t lower, uint8_t upper)
+{
+    uint32_t span = (uint32_t)(upper - lower) + 1;
+
+    return lower + (uint8_t)(((Prng_at(seed, index) >> 16) * span) >> 16);
+}
+
+// xorshift32. The state must not be 0.
+uint32_t Prng_next(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
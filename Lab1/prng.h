@@ -0,0 +1,37 @@
+/*
+ * prng.h
+ *
+ *  Seeded pseudo-random numbers for the Simon sequence.
+ *
+ *  A game is identified by one 32-bit seed. Element i of its sequence is a
+ *  hash of the seed and i (Prng_at()), so any element can be regenerated
+ *  on demand: the sequence takes no RAM and has no length limit, and the
+ *  same seed always replays the same game.
+ *
+ *  Prng_entropySeed() makes a fresh seed from the noise in the low bits of
+ *  repeated ADC12 conversions of the temperature sensor, mixed with the
+ *  time base. Prng_next() is a plain xorshift32 generator for anything
+ *  that just needs a stream of numbers.
+ *
+ *  Define HOST_BUILD to compile this module on a PC, without the hardware
+ *  seed, e.g. to run the Simon engine there.
+ */
+
+#ifndef PRNG_H_
+#define PRNG_H_
+
+#include <stdint.h>
+
+// Conversions whose LSBs are folded into a seed
+#define PRNG_ENTROPY_SAMPLES    64
+
+#ifndef HOST_BUILD
+uint32_t Prng_entropySeed(void);
+#endif
+
+uint32_t Prng_at(uint32_t seed, uint16_t index);
+uint8_t Prng_range(uint32_t seed, uint16_t index, uint8_t lower, uint8_t upper);
+
+uint32_t Prng_next(uint32_t *state);
+
+#endif /* PRNG_H_ */
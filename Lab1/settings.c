@@ -0,0 +1,307 @@
+/*
+ * settings.c
+ *
+ *  Log-structured key/value store in info memory. See settings.h.
+ */
+
+#include "settings.h"
+#include "crc16.h"
+
+#ifndef HOST_BUILD
+#include <msp430.h>
+#endif
+
+#define HEADER_LEN      4
+#define ENTRY_LEN(n)    ((n) + 4)
+
+#define MAGIC           'K'
+#define STATE_ACTIVE    0x00
+#define ERASED          0xFF
+
+#ifdef HOST_BUILD
+static uint8_t flash[SETTINGS_SEGMENTS * SETTINGS_SEGMENT_SIZE];
+#define SEGMENT(n)      (&flash[(uint16_t)(n) * SETTINGS_SEGMENT_SIZE])
+#else
+#define SEGMENT(n)      ((uint8_t *)SETTINGS_START + (uint16_t)(n) * SETTINGS_SEGMENT_SIZE)
+#endif
+
+static uint8_t active;                  // segment in use
+static uint16_t seq;                    // its sequence number
+static uint8_t writePos;                // offset of the next entry in it
+static uint8_t entryAt[SETTINGS_MAX_KEYS];  // offset of each key's latest entry, 0 if unset
+
+
+//------------------------------------------------------------------------------
+// Flash controller
+//------------------------------------------------------------------------------
+
+static void flashErase(uint8_t n)
+{
+#ifdef HOST_BUILD
+    uint8_t i;
+
+    for (i = 0; i < SETTINGS_SEGMENT_SIZE; i++)
+        SEGMENT(n)[i] = ERASED;
+#else
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+
+    FCTL3 = FWKEY;                      // unlock, LOCKA stays set
+    FCTL1 = FWKEY | ERASE;
+    *(volatile uint8_t *)SEGMENT(n) = 0;    // dummy write starts the erase
+    while (FCTL3 & BUSY)
+        ;
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY | LOCK;
+
+    __set_interrupt_state(intState);
+#endif
+}
+
+static void flashWrite(uint8_t *dst, const uint8_t *src, uint8_t len)
+{
+#ifdef HOST_BUILD
+    while (len--)
+        *dst++ &= *src++;               // programming only clears bits
+#else
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+
+    FCTL3 = FWKEY;
+    FCTL1 = FWKEY | WRT;
+    while (len--) {
+        *(volatile uint8_t *)dst++ = *src++;
+        while (FCTL3 & BUSY)
+            ;
+    }
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY | LOCK;
+
+    __set_interrupt_state(intState);
+#endif
+}
+
+static void eraseIfUsed(uint8_t n)
+{
+    const uint8_t *p = SEGMENT(n);
+    uint8_t i;
+
+    for (i = 0; i < SETTINGS_SEGMENT_SIZE; i++) {
+        if (p[i] != ERASED) {
+            flashErase(n);
+            return;
+        }
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Segments
+//------------------------------------------------------------------------------
+
+static uint8_t isActive(uint8_t n)
+{
+    const uint8_t *p = SEGMENT(n);
+
+    return (p[0] == MAGIC) && (p[1] == STATE_ACTIVE);
+}
+
+static uint16_t segmentSeq(uint8_t n)
+{
+    const uint8_t *p = SEGMENT(n);
+
+    return p[2] | (p[3] << 8);
+}
+
+// Writes a segment header. The state byte is left erased until the
+// segment is complete.
+static void writeHeader(uint8_t n, uint16_t s)
+{
+    uint8_t header[HEADER_LEN];
+
+    header[0] = MAGIC;
+    header[1] = ERASED;
+    header[2] = s & 0xFF;
+    header[3] = s >> 8;
+    flashWrite(SEGMENT(n), header, HEADER_LEN);
+}
+
+static void markActive(uint8_t n)
+{
+    uint8_t state = STATE_ACTIVE;
+
+    flashWrite(SEGMENT(n) + 1, &state, 1);
+}
+
+// Rebuilds the index from the active segment. Entries with a bad CRC are
+// skipped. A length that cannot be right ends the scan and leaves the
+// segment full, so the next update compacts it.
+static void scan(void)
+{
+    const uint8_t *p = SEGMENT(active);
+    uint8_t pos = HEADER_LEN, key, len;
+
+    for (key = 0; key < SETTINGS_MAX_KEYS; key++)
+        entryAt[key] = 0;
+
+    while (pos + ENTRY_LEN(0) <= SETTINGS_SEGMENT_SIZE) {
+        key = p[pos];
+        len = p[pos + 1];
+
+        if (key == ERASED)
+            break;
+        if ((len > SETTINGS_MAX_LEN) || (pos + ENTRY_LEN(len) > SETTINGS_SEGMENT_SIZE)) {
+            pos = SETTINGS_SEGMENT_SIZE;
+            break;
+        }
+
+        if ((key < SETTINGS_MAX_KEYS) &&
+            (CRC16_compute(&p[pos], len + 2) == ((p[pos + len + 2] << 8) | p[pos + len + 3])))
+            entryAt[key] = pos;
+
+        pos += ENTRY_LEN(len);
+    }
+    writePos = pos;
+}
+
+// Appends an entry to the active segment, CRC last
+static void writeEntry(uint8_t key, const uint8_t *value, uint8_t len)
+{
+    uint8_t *dst = SEGMENT(active) + writePos;
+    uint8_t head[2];
+    uint8_t tail[2];
+    uint16_t crc;
+
+    head[0] = key;
+    head[1] = len;
+    crc = CRC16_update(CRC16_INIT, head, 2);
+    crc = CRC16_update(crc, value, len);
+    tail[0] = crc >> 8;
+    tail[1] = crc & 0xFF;
+
+    flashWrite(dst, head, 2);
+    flashWrite(dst + 2, value, len);
+    flashWrite(dst + 2 + len, tail, 2);
+
+    entryAt[key] = writePos;
+    writePos += ENTRY_LEN(len);
+}
+
+// Moves the latest entry of every key except skip into the next segment
+// and makes it the active one. Returns 0, changing nothing, if they and
+// an entry of extra bytes would not fit.
+static uint8_t compact(uint8_t skip, uint8_t extra)
+{
+    const uint8_t *old = SEGMENT(active);
+    uint8_t next = (active + 1) % SETTINGS_SEGMENTS;
+    uint16_t need = HEADER_LEN + ENTRY_LEN(extra);
+    uint8_t newEntryAt[SETTINGS_MAX_KEYS];
+    uint8_t pos = HEADER_LEN, key, len;
+
+    for (key = 0; key < SETTINGS_MAX_KEYS; key++)
+        if (entryAt[key] && (key != skip))
+            need += ENTRY_LEN(old[entryAt[key] + 1]);
+    if (need > SETTINGS_SEGMENT_SIZE)
+        return 0;
+
+    eraseIfUsed(next);
+    writeHeader(next, seq + 1);
+
+    for (key = 0; key < SETTINGS_MAX_KEYS; key++) {
+        newEntryAt[key] = 0;
+        if (entryAt[key] && (key != skip)) {
+            len = ENTRY_LEN(old[entryAt[key] + 1]);
+            flashWrite(SEGMENT(next) + pos, &old[entryAt[key]], len);     // CRC and all
+            newEntryAt[key] = pos;
+            pos += len;
+        }
+    }
+
+    markActive(next);                   // from here on the copy is the store
+    flashErase(active);
+
+    active = next;
+    seq++;
+    writePos = pos;
+    for (key = 0; key < SETTINGS_MAX_KEYS; key++)
+        entryAt[key] = newEntryAt[key];
+    return 1;
+}
+
+
+// Finds the active segment and indexes it. Segments left over by an
+// interrupted compaction are erased; with no store at all, segment D is
+// started empty.
+void Settings_init(void)
+{
+    uint8_t n, found = 0;
+
+    for (n = 0; n < SETTINGS_SEGMENTS; n++) {
+        if (isActive(n) && (!found || ((int16_t)(segmentSeq(n) - seq) > 0))) {
+            active = n;
+            seq = segmentSeq(n);
+            found = 1;
+        }
+    }
+
+    for (n = 0; n < SETTINGS_SEGMENTS; n++)
+        if (!found || (n != active))
+            eraseIfUsed(n);
+
+    if (!found) {
+        active = 0;
+        seq = 0;
+        writeHeader(active, seq);
+        markActive(active);
+    }
+
+    scan();
+}
+
+// Copies a key's value into value, at most maxLen bytes. Returns its
+// length, or 0 if the key has never been set.
+uint8_t Settings_get(uint8_t key, void *value, uint8_t maxLen)
+{
+    const uint8_t *p;
+    uint8_t *out = (uint8_t *)value;
+    uint8_t len, i;
+
+    if ((key >= SETTINGS_MAX_KEYS) || (entryAt[key] == 0))
+        return 0;
+
+    p = SEGMENT(active) + entryAt[key];
+    len = (p[1] < maxLen) ? p[1] : maxLen;
+    for (i = 0; i < len; i++)
+        out[i] = p[2 + i];
+    return len;
+}
+
+// Stores a key's value. Setting the value it already has writes nothing.
+// Returns 0 if the key or length is out of range or the store is full.
+uint8_t Settings_set(uint8_t key, const void *value, uint8_t len)
+{
+    const uint8_t *in = (const uint8_t *)value;
+    uint8_t i;
+
+    if ((key >= SETTINGS_MAX_KEYS) || (len > SETTINGS_MAX_LEN))
+        return 0;
+
+    if (entryAt[key]) {
+        const uint8_t *p = SEGMENT(active) + entryAt[key];
+
+        if (p[1] == len) {
+            for (i = 0; (i < len) && (p[2 + i] == in[i]); i++)
+                ;
+            if (i == len)
+                return 1;
+        }
+    }
+
+    if ((writePos + ENTRY_LEN(len) > SETTINGS_SEGMENT_SIZE) && !compact(key, len))
+        return 0;
+
+    writeEntry(key, in, len);
+    return 1;
+}
@@ -0,0 +1,213 @@
+/*
+ * simon_engine.c
+ *
+ *  Simon game logic as a step function. See simon_engine.h.
+ */
+
+#include "simon_engine.h"
+#include "prng.h"
+
+
+static void output(SimonOutput *out, uint8_t display, uint8_t sound, int8_t number, uint8_t delay)
+{
+    out->display = display;
+    out->sound = sound;
+    out->number = number;
+    out->delay = delay;
+}
+
+static void startCountdown(SimonEngine *g, SimonOutput *out)
+{
+    g->turn = 0;
+    g->speed = SIMON_START_SPEED;
+    g->keyCount = 0;
+    g->count = 3;
+    g->state = SIMON_COUNTDOWN;
+    output(out, SIMON_SHOW_COUNT, SIMON_SOUND_KEEP, g->count, 10);
+}
+
+// Shows and sounds number 'count' of the sequence
+static void showNext(SimonEngine *g, SimonOutput *out)
+{
+    int8_t number = SimonEngine_numberAt(g, g->count);
+
+    g->showing = 1;
+    output(out, SIMON_SHOW_NUMBER, SIMON_SOUND_NUMBER, number, g->speed);
+}
+
+static void startPlayback(SimonEngine *g, SimonOutput *out)
+{
+    g->keyCount = 0;                    // nothing typed ahead carries into a round
+    g->count = 0;
+    g->state = SIMON_PLAYBACK;
+    showNext(g, out);
+}
+
+static void gameOver(SimonEngine *g, SimonOutput *out)
+{
+    g->keyCount = 0;
+    g->count = 0;
+    g->state = SIMON_GAME_OVER;
+    output(out, SIMON_SHOW_GAME_OVER, SIMON_SOUND_TUNE, 0, 4);
+}
+
+// A key in SIMON_WAIT_KEY: 1-4 is echoed, anything else ends the game
+static void enterKey(SimonEngine *g, uint8_t key, SimonOutput *out)
+{
+    if ((key >= '1') && (key <= '4')) {
+        g->key = key - '0';
+        g->showing = 1;
+        g->state = SIMON_ECHO;
+        output(out, SIMON_SHOW_NUMBER, SIMON_SOUND_NUMBER, g->key, g->speed);
+    } else {
+        gameOver(g, out);
+    }
+}
+
+// End of an echo: wrong number, next number, next round or won
+static void checkKey(SimonEngine *g, SimonOutput *out)
+{
+    if (g->key != SimonEngine_numberAt(g, g->count)) {
+        gameOver(g, out);
+
+    } else if (g->count < g->turn) {
+        g->count++;
+        g->state = SIMON_WAIT_KEY;
+
+        if (g->keyCount) {
+            uint8_t key = g->keys[g->keyHead];
+            g->keyHead = (g->keyHead + 1) % SIMON_KEY_QUEUE;
+            g->keyCount--;
+            enterKey(g, key, out);
+        } else {
+            output(out, SIMON_SHOW_CLEAR, SIMON_SOUND_KEEP, 0, 0);
+        }
+
+    } else if (g->turn == (SIMON_ROUNDS - 1)) {
+        g->state = SIMON_WON;
+        output(out, SIMON_SHOW_WON, SIMON_SOUND_KEEP, 0, 40);
+
+    } else {
+        // next round, one more number and a bit faster
+        g->turn++;
+        g->speed--;
+        startPlayback(g, out);
+    }
+}
+
+// Puts the engine on the title screen
+void SimonEngine_init(SimonEngine *g, SimonOutput *out)
+{
+    g->state = SIMON_ATTRACT;
+    g->seed = 0;
+    g->keyHead = 0;
+    g->keyCount = 0;
+    output(out, SIMON_SHOW_TITLE, SIMON_SOUND_OFF, 0, 0);
+}
+
+// Advances the game by one input. Inputs a state does not expect are
+// ignored, with every field of out set to leave things as they are.
+void SimonEngine_step(SimonEngine *g, const SimonInput *in, SimonOutput *out)
+{
+    uint8_t key = in->key;
+    uint8_t timeout = (in->type == SIMON_IN_TIMEOUT);
+
+    output(out, SIMON_SHOW_NOTHING, SIMON_SOUND_KEEP, 0, 0);
+
+    switch (g->state) {
+
+    case SIMON_ATTRACT:
+        if (timeout)
+            break;
+
+        if (key == '*') {
+            g->seed = in->seed;
+            startCountdown(g, out);
+        } else if (key == '#') {
+            startCountdown(g, out);     // same seed, same game
+        }
+        break;
+
+    case SIMON_COUNTDOWN:
+        if (!timeout)
+            break;
+
+        g->count--;
+        if (g->count < 0)
+            startPlayback(g, out);
+        else
+            output(out, SIMON_SHOW_COUNT, SIMON_SOUND_KEEP, g->count, 10);
+        break;
+
+    case SIMON_PLAYBACK:
+        if (!timeout)
+            break;
+
+        if (g->showing) {
+            g->showing = 0;
+            output(out, SIMON_SHOW_CLEAR, SIMON_SOUND_OFF, 0, 1);
+        } else if (g->count < g->turn) {
+            g->count++;
+            showNext(g, out);
+        } else {
+            g->count = 0;
+            g->state = SIMON_WAIT_KEY;
+        }
+        break;
+
+    case SIMON_WAIT_KEY:
+        if (!timeout)
+            enterKey(g, key, out);
+        break;
+
+    case SIMON_ECHO:
+        if (!timeout) {
+            // held back until the echo is over, dropped if the queue is full
+            if (g->keyCount < SIMON_KEY_QUEUE) {
+                g->keys[(g->keyHead + g->keyCount) % SIMON_KEY_QUEUE] = key;
+                g->keyCount++;
+            }
+        } else if (g->showing) {
+            g->showing = 0;
+            output(out, SIMON_SHOW_CLEAR, SIMON_SOUND_OFF, 0, 1);
+        } else {
+            checkKey(g, out);
+        }
+        break;
+
+    case SIMON_GAME_OVER:
+        if (!timeout)
+            break;
+
+        g->count++;
+        if (g->count < SIMON_TUNE_NOTES) {
+            output(out, SIMON_SHOW_NOTHING, SIMON_SOUND_TUNE, g->count, 4);
+        } else if (g->count == SIMON_TUNE_NOTES) {
+            output(out, SIMON_SHOW_NOTHING, SIMON_SOUND_KEEP, 0, 40);     // holds the last note
+        } else {
+            g->state = SIMON_ATTRACT;
+            output(out, SIMON_SHOW_TITLE, SIMON_SOUND_OFF, 0, 0);
+        }
+        break;
+
+    case SIMON_WON:
+        if (timeout) {
+            g->state = SIMON_ATTRACT;
+            output(out, SIMON_SHOW_TITLE, SIMON_SOUND_KEEP, 0, 0);
+        }
+        break;
+    }
+}
+
+// 1 when the next key may start a new game, so the caller should put a
+// fresh seed in the input
+uint8_t SimonEngine_wantsSeed(const SimonEngine *g)
+{
+    return (g->state == SIMON_ATTRACT);
+}
+
+// Number 1-4 at position index of the current game's sequence
+uint8_t SimonEngine_numberAt(const SimonEngine *g, uint8_t index)
+{
+    return Prng_range(g->seed, index, 1, 4);
+}
@@ -0,0 +1,90 @@
+/*
+ * simon_engine.h
+ *
+ *  Simon game logic with no I/O. The engine is a pure step function: it is
+ *  fed one input at a time (a key press or the timeout it asked for) and
+ *  answers with the commands to carry out: what to show, what to sound and
+ *  how long to wait before the next timeout. It never blocks, reads a pin
+ *  or draws anything, so the same code runs under the firmware adapter in
+ *  main.c and in a host program that scripts whole games.
+ *
+ *  Keys pressed while an entered number is still being echoed are queued
+ *  and handled as soon as the echo ends, so fast players never lose one.
+ *  Time is counted in delay units; the adapter decides how long one is.
+ */
+
+#ifndef SIMON_ENGINE_H_
+#define SIMON_ENGINE_H_
+
+#include <stdint.h>
+
+#define SIMON_ROUNDS        10      // rounds to play to win
+#define SIMON_START_SPEED   10      // delay units a number is shown for in round 0, one less per round
+#define SIMON_TUNE_NOTES    6       // notes in the Game Over tune
+#define SIMON_KEY_QUEUE     SIMON_ROUNDS    // keys held back during an echo, a whole round
+
+// Engine states
+#define SIMON_ATTRACT       0       // title screen, '*' new game, '#' replay the last one
+#define SIMON_COUNTDOWN     1       // 3, 2, 1, 0
+#define SIMON_PLAYBACK      2       // shows the sequence up to this round
+#define SIMON_WAIT_KEY      3       // waits for the next number
+#define SIMON_ECHO          4       // shows the entered number, then checks it
+#define SIMON_GAME_OVER     5       // message and tune
+#define SIMON_WON           6       // message
+
+// Inputs
+#define SIMON_IN_KEY        0       // key holds the ASCII key
+#define SIMON_IN_TIMEOUT    1       // the delay from the last output has passed
+
+// Display commands, each replaces what is on the display
+#define SIMON_SHOW_NOTHING  0       // leave the display as it is
+#define SIMON_SHOW_CLEAR    1
+#define SIMON_SHOW_TITLE    2
+#define SIMON_SHOW_NUMBER   3       // number 1-4 at its own position
+#define SIMON_SHOW_COUNT    4       // countdown number, centered
+#define SIMON_SHOW_GAME_OVER 5
+#define SIMON_SHOW_WON      6
+
+// Sound commands
+#define SIMON_SOUND_KEEP    0       // leave the buzzer as it is
+#define SIMON_SOUND_OFF     1
+#define SIMON_SOUND_NUMBER  2       // tone of number 1-4
+#define SIMON_SOUND_TUNE    3       // note 'number' of the Game Over tune
+
+typedef struct SimonInput
+{
+    uint8_t type;               // SIMON_IN_*
+    uint8_t key;                // for SIMON_IN_KEY
+    uint32_t seed;              // sequence of the new game if this key starts one (see SimonEngine_wantsSeed)
+} SimonInput;
+
+typedef struct SimonOutput
+{
+    uint8_t display;            // SIMON_SHOW_*
+    uint8_t sound;              // SIMON_SOUND_*
+    int8_t number;              // for SIMON_SHOW_NUMBER, _COUNT, SIMON_SOUND_NUMBER and _TUNE
+    uint8_t delay;              // delay units until the next SIMON_IN_TIMEOUT, 0 for no new timeout
+} SimonOutput;
+
+typedef struct SimonEngine
+{
+    uint8_t state;              // SIMON_*
+    uint32_t seed;              // sequence of the current game
+    int8_t turn;                // round, 0 to SIMON_ROUNDS - 1
+    int8_t count;               // step within the state
+    uint8_t speed;              // delay units per shown number
+    uint8_t showing;            // a number is shown (1) or the gap after it (0)
+    uint8_t key;                // number being echoed
+
+    uint8_t keys[SIMON_KEY_QUEUE];
+    uint8_t keyHead;
+    uint8_t keyCount;
+} SimonEngine;
+
+void SimonEngine_init(SimonEngine *g, SimonOutput *out);
+void SimonEngine_step(SimonEngine *g, const SimonInput *in, SimonOutput *out);
+
+uint8_t SimonEngine_wantsSeed(const SimonEngine *g);
+uint8_t SimonEngine_numberAt(const SimonEngine *g, uint8_t index);
+
+#endif /* SIMON_ENGINE_H_ */
@@ -49,6 +49,19 @@
 #endif
 
 #include "HAL_MSP_EXP430FR5529_Sharp96x96.h"
+#include "spi_bus.h"
+
+// Bus handle used by Sharp96x96.c for every LCD transaction
+uint8_t lcdSpiDevice = SPI_BUS_NO_DEVICE;
+
+static const SPIBus_Device lcdDevice =
+{
+	&PORT_CS_OUT,
+	PIN_CS,
+	1,					// SCS is active high
+	(UCMSB|UCCKPH),
+	SPI_CLK_TICKS
+};
 
 //*****************************************************************************
 //
@@ -94,21 +107,7 @@ void Sharp96x96_Init(void)
 			
 	DeassertCS();
 
-	// Configure the SPI interface on USCI B0
-    USCI_B_SPI_masterInit(USCI_B0_BASE,
-                    USCI_B_SPI_CLOCKSOURCE_SMCLK,
-					8000000,
-                    1000000,
-                    USCI_B_SPI_MSB_FIRST,
-                    USCI_B_SPI_PHASE_DATA_CAPTURED_ONFIRST_CHANGED_ON_NEXT,
-                    USCI_B_SPI_CLOCKPOLARITY_INACTIVITY_LOW);
-
-    USCI_B_SPI_enable(USCI_B0_BASE);
-
 #else
-	// Configure SCLK and MOSI for peripheral mode
-	PORT_SPI_SEL |= (PIN_SPI_MOSI|PIN_SPI_SCLK);
-
 	// The LCD is powered using a GPIO pin, so configure it as output
 	PORT_PWR_SEL &= ~PIN_PWR;
 	PORT_PWR_DIR |=  PIN_PWR;
@@ -128,28 +127,13 @@ void Sharp96x96_Init(void)
 	// Initialize the chip select in a deasserted state
 	DeassertCS();
 
-	// Now configure UCSIB0 to function as our SPI controller
-
-	// Disable the module so we can configure it
-	SPI_REG_CTL1 |= UCSWRST;
-
-	SPI_REG_CTL0 &= ~(UCCKPH|UCCKPL|UC7BIT|UCMSB); // Reset the controller config parameters
-	SPI_REG_CTL1 &= ~UCSSEL_3; // Reset the clock configuration
-
-	SPI_REG_CTL1 |= SPI_CLK_SRC; // Select SMCLK for our clock source
-
-	// Set SPI clock frequency (which is the same frequency as SMCLK so this can apparently be 0)
-	SPI_REG_BRL  =  ((uint16_t)SPI_CLK_TICKS) & 0xFF;         // Load the low byte
-	SPI_REG_BRH  = (((uint16_t)SPI_CLK_TICKS) >> 8) & 0xFF;	  // Load the high byte
-
-	// Configure for SPI master, synchronous, 3 wire SPI, MSB first, capture data on first edge,
-	// and inactive low polarity
-	SPI_REG_CTL0 |= (UCMST|UCSYNC|UCMODE_0|UCMSB|UCCKPH);
-
-	// Reenable the module
-	SPI_REG_CTL1 &= ~UCSWRST;
-	SPI_REG_IFG  &= ~UCRXIFG;
 #endif
+
+	// UCB0 is shared with the DAC, so the LCD is registered as one device on
+	// the SPI bus rather than configuring the USCI here. SMCLK, MSB first,
+	// capture data on first edge, inactive low polarity.
+	SPIBus_init();
+	lcdSpiDevice = SPIBus_registerDevice(&lcdDevice);
 }
 
 //*****************************************************************************
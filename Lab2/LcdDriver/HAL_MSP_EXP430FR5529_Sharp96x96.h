@@ -55,6 +55,7 @@
 #define __HAL_MSP_EXP430F5529_SHARPLCD_H__
 
 #include<msp430.h>
+#include <stdint.h>
 
 #ifdef USE_DRIVERLIB
 #include "inc/hw_memmap.h"
@@ -188,57 +189,6 @@
 #define AssertCS()    PORT_CS_OUT |= PIN_CS
 #endif
 
-//*****************************************************************************
-//
-// Waits until the SPI communication with the LCD is finished a command to
-// the LCD Driver
-//
-// \param None
-//
-// \return None
-//*****************************************************************************
-#ifdef USE_DRIVERLIB
-#define WaitUntilLcdWriteFinished()                \
-        while  (USCI_B_SPI_isBusy(USCI_B0_BASE))
-#else
-#define WaitUntilLcdWriteFinished()					\
-		do {										\
-				while(SPI_REG_STAT & UCBUSY);		\
-			} while (0)
-#endif
-
-
-//*****************************************************************************
-//
-// Writes command or data to the LCD Driver
-//
-// \param ucCmdData is the 8 or 16 bit command to send to the LCD driver
-// Uses the SET_LCD_DATA macro
-//
-// \return None
-//
-//*****************************************************************************
-#ifdef USE_DRIVERLIB
-#define WriteCmdData(ucCmdData)                    	                 \
-        do                                         	                 \
-        {                                                            \
-			while (!USCI_B_SPI_getInterruptStatus(USCI_B0_BASE,      \
-                    USCI_B_SPI_TRANSMIT_INTERRUPT));                 \
-            	USCI_B_SPI_transmitData(USCI_B0_BASE,ucCmdData);   	 \
-        }                                                            \
-        while(0)
-#else
-#define WriteCmdData(ucCmdData)										\
-	do																\
-	{																\
-		/* Wait for the TX buffer to be ready */					\
-		while(!(SPI_REG_IFG & UCTXIFG));							\
-																	\
-		/* Send the data */											\
-		SPI_REG_TXBUF = ucCmdData;									\
-	} while(0)
-#endif
-
 //*****************************************************************************
 //
 // Prepare to write memory
@@ -270,5 +220,6 @@
 // Prototypes for the globals exported by this driver.
 //
 //*****************************************************************************
+extern uint8_t lcdSpiDevice;
 extern void Sharp96x96_Init(void);
 #endif // __HAL_MSP-EXP430F5529_SHARPLCD_H__
@@ -53,6 +53,11 @@
 #define LANDSCAPE
 #define ROTATE_90
 
+// Sends each flushed frame's changed lines to a PC over the telemetry
+// stream (lcd_mirror.h). lcd_mirror.c and telemetry.c exist only in Lab 3
+// and Lab 4; defining this in Lab 2 fails to link.
+//#define LCD_MIRROR
+
 //Maximum Colors in an image color palette
 #define MAX_PALETTE_COLORS  2
 
@@ -0,0 +1,42 @@
+/*
+ * crc16.h
+ *
+ *  CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF, MSB first, no
+ *  final XOR; "123456789" gives 0x29B1) on the F5529's CRC16 module.
+ *  Bytes are written to CRCDIRB, the bit-reversed input, which makes the
+ *  hardware match the usual MSB-first definition. Host builds
+ *  (HOST_BUILD) use the table-driven software version, which gives the
+ *  same result bit for bit.
+ *
+ *  A calculation can be split across calls by passing the last result
+ *  back in as crc. The module is fed CRC16_CHUNK_LEN bytes at a time with
+ *  interrupts disabled, reloaded each time from the running value, so an
+ *  interrupt waits for one chunk at most and may use the module itself
+ *  between chunks of a main-loop calculation.
+ */
+
+#ifndef CRC16_H_
+#define CRC16_H_
+
+#include <stdint.h>
+
+#define CRC16_INIT      0xFFFF
+#define CRC16_CHUNK_LEN 32              // bytes fed with interrupts disabled
+
+uint16_t CRC16_compute(const void *data, uint16_t len);
+uint16_t CRC16_update(uint16_t crc, const void *data, uint16_t len);
+uint16_t CRC16_software(uint16_t crc, const void *data, uint16_t len);
+
+typedef struct CRC16_Bench
+{
+    uint16_t len;               // bytes per block
+    uint16_t blocks;            // blocks timed with each method
+    uint32_t hardwareTicks;     // time base ticks for all blocks
+    uint32_t softwareTicks;
+} CRC16_Bench;
+
+#ifndef HOST_BUILD
+void CRC16_benchmark(const void *data, uint16_t len, uint16_t blocks, CRC16_Bench *bench);
+#endif
+
+#endif /* CRC16_H_ */
@@ -0,0 +1,215 @@
+/*
+ * dma.c
+ *
+ *  DMA channel manager and block copy/fill. See dma.h.
+ */
+
+#include <string.h>
+#include "dma.h"
+#include "timebase.h"
+
+// Per-channel registers, DMA0 to DMA2
+static volatile unsigned int * const ctlReg[DMA_NUM_CHANNELS] = {&DMA0CTL, &DMA1CTL, &DMA2CTL};
+static volatile unsigned int * const szReg[DMA_NUM_CHANNELS] = {&DMA0SZ, &DMA1SZ, &DMA2SZ};
+static volatile void * const srcReg[DMA_NUM_CHANNELS] = {&DMA0SA, &DMA1SA, &DMA2SA};
+static volatile void * const dstReg[DMA_NUM_CHANNELS] = {&DMA0DA, &DMA1DA, &DMA2DA};
+
+static uint8_t taken[DMA_NUM_CHANNELS];
+static DMA_Callback callbacks[DMA_NUM_CHANNELS];
+
+
+// DMA0TSEL and DMA1TSEL are the low and high bytes of DMACTL0, DMA2TSEL
+// the low byte of DMACTL1
+static void setTrigger(uint8_t channel, uint8_t trigger)
+{
+    switch (channel) {
+    case 0:
+        DMACTL0 = (DMACTL0 & 0xFF00) | trigger;
+        break;
+    case 1:
+        DMACTL0 = (DMACTL0 & 0x00FF) | ((uint16_t)trigger << 8);
+        break;
+    case 2:
+        DMACTL1 = (DMACTL1 & 0xFF00) | trigger;
+        break;
+    }
+}
+
+// One software-triggered block transfer on a borrowed channel, word-sized
+// when both addresses and the length are even. The CPU stops until the
+// block is done. Returns 0 if no channel was free.
+static uint8_t blockTransfer(void *dst, const void *src, uint16_t len, uint16_t srcIncr)
+{
+    uint8_t channel = DMA_alloc(DMA_TRIGGER_DMAREQ, DMA_PRIO_LOW, 0);
+    uint16_t ctl = DMADT_1 | srcIncr | DMADSTINCR_3;
+
+    if (channel == DMA_NO_CHANNEL)
+        return 0;
+
+    if ((((uint16_t)dst | (uint16_t)src | len) & 1) == 0)
+        len >>= 1;
+    else
+        ctl |= DMASRCBYTE | DMADSTBYTE;
+
+    DMA_start(channel, src, dst, len, ctl);
+    *ctlReg[channel] |= DMAREQ;
+    while (*ctlReg[channel] & DMAEN)
+        ;                               // already clear when the CPU resumes
+
+    DMA_free(channel);
+    return 1;
+}
+
+
+// Takes a channel and routes trigger to it. Returns the channel number,
+// or DMA_NO_CHANNEL if all are in use. Callable from interrupts.
+uint8_t DMA_alloc(uint8_t trigger, uint8_t priority, DMA_Callback done)
+{
+    __istate_t intState = __get_interrupt_state();
+    uint8_t channel = DMA_NO_CHANNEL;
+    uint8_t i;
+
+    __disable_interrupt();
+
+    for (i = 0; i < DMA_NUM_CHANNELS; i++) {
+        uint8_t c = (priority == DMA_PRIO_HIGH) ? i : DMA_NUM_CHANNELS - 1 - i;
+
+        if (!taken[c]) {
+            channel = c;
+            break;
+        }
+    }
+
+    if (channel != DMA_NO_CHANNEL) {
+        taken[channel] = 1;
+        callbacks[channel] = done;
+        *ctlReg[channel] = 0;
+        setTrigger(channel, trigger);
+    }
+
+    __set_interrupt_state(intState);
+    return channel;
+}
+
+// Stops a channel and gives it back
+void DMA_free(uint8_t channel)
+{
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+
+    *ctlReg[channel] = 0;
+    setTrigger(channel, DMA_TRIGGER_DMAREQ);
+    callbacks[channel] = 0;
+    taken[channel] = 0;
+
+    __set_interrupt_state(intState);
+}
+
+void DMA_start(uint8_t channel, const volatile void *src, volatile void *dst,
+               uint16_t size, uint16_t ctl)
+{
+    *ctlReg[channel] = 0;               // disabled while it is reprogrammed
+
+    __data16_write_addr((unsigned short)srcReg[channel], (unsigned long)src);
+    __data16_write_addr((unsigned short)dstReg[channel], (unsigned long)dst);
+    *szReg[channel] = size;
+
+    *ctlReg[channel] = ctl | DMAEN;
+}
+
+void DMA_stop(uint8_t channel)
+{
+    *ctlReg[channel] &= ~(DMAEN | DMAIE | DMAIFG);
+}
+
+// A single or block transfer is over once DMAEN clears; repeated modes
+// stay busy until stopped
+uint8_t DMA_isBusy(uint8_t channel)
+{
+    return (*ctlReg[channel] & DMAEN) != 0;
+}
+
+// Clears each finished channel's flag and runs its callback. The flag is
+// cleared first so a callback may start the channel again. Returns
+// non-zero if a callback asked to wake the main loop.
+uint8_t DMA_service(void)
+{
+    uint8_t wake = 0;
+    uint8_t channel;
+
+    for (channel = 0; channel < DMA_NUM_CHANNELS; channel++) {
+        if ((*ctlReg[channel] & (DMAIE | DMAIFG)) == (DMAIE | DMAIFG)) {
+            *ctlReg[channel] &= ~DMAIFG;
+            if (callbacks[channel] && callbacks[channel](channel))
+                wake = 1;
+        }
+    }
+    return wake;
+}
+
+// Copies len bytes. Blocks are moved at one or two bytes per two MCLK
+// cycles, and interrupts wait until the block is done.
+void DMA_memcpy(void *dst, const void *src, uint16_t len)
+{
+    if ((len < DMA_MIN_BLOCK_LEN) || !blockTransfer(dst, src, len, DMASRCINCR_3))
+        memcpy(dst, src, len);
+}
+
+// Fills len bytes with value, reading it from a fixed source address
+void DMA_memset(void *dst, uint8_t value, uint16_t len)
+{
+    uint16_t fill = ((uint16_t)value << 8) | value;    // both bytes, for word transfers
+
+    if ((len < DMA_MIN_BLOCK_LEN) || !blockTransfer(dst, &fill, len, DMASRCINCR_0))
+        memset(dst, value, len);
+}
+
+// Times copying and filling one block blocks times, with the CPU (the
+// library memcpy/memset) and with a DMA block transfer including the
+// channel set-up, so the shortest length where DMA wins can be found.
+// Returns 0, with the DMA times unset, if no channel was free for a
+// transfer.
+uint8_t DMA_benchmark(void *dst, const void *src, uint16_t len, uint16_t blocks, DMA_Bench *bench)
+{
+    uint32_t start;
+    uint16_t i;
+
+    bench->len = len;
+    bench->blocks = blocks;
+
+    start = Timebase_ticks();
+    for (i = 0; i < blocks; i++)
+        memcpy(dst, src, len);
+    bench->cpuCopyTicks = Timebase_ticks() - start;
+
+    start = Timebase_ticks();
+    for (i = 0; i < blocks; i++)
+        if (!blockTransfer(dst, src, len, DMASRCINCR_3))
+            return 0;
+    bench->dmaCopyTicks = Timebase_ticks() - start;
+
+    start = Timebase_ticks();
+    for (i = 0; i < blocks; i++)
+        memset(dst, 0xA5, len);
+    bench->cpuFillTicks = Timebase_ticks() - start;
+
+    start = Timebase_ticks();
+    for (i = 0; i < blocks; i++) {
+        uint16_t fill = 0xA5A5;
+        if (!blockTransfer(dst, &fill, len, DMASRCINCR_0))
+            return 0;
+    }
+    bench->dmaFillTicks = Timebase_ticks() - start;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+// DMA Interrupt Service Routine
+//------------------------------------------------------------------------------
+#pragma vector=DMA_VECTOR
+__interrupt void DMA_ISR(void)
+{
+    if (DMA_service())
+        __bic_SR_register_on_exit(LPM3_bits);
+}
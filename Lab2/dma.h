@@ -0,0 +1,95 @@
+/*
+ * dma.h
+ *
+ *  Owner of the F5529's three DMA channels. Drivers that move data with
+ *  DMA (the SPI bus today; the LCD, ADC or DAC can follow) ask for a
+ *  channel once with DMA_alloc(), giving the trigger it runs on and a
+ *  completion callback, instead of claiming DMA0..DMA2 by number. The
+ *  trigger select fields in DMACTL0/DMACTL1 and the shared DMA_VECTOR
+ *  interrupt live here.
+ *
+ *  Channels are arbitrated by number, DMA0 first, so DMA_PRIO_HIGH hands
+ *  out the lowest free channel and DMA_PRIO_LOW the highest.
+ *
+ *  DMA_memcpy() and DMA_memset() run as block transfers on a channel
+ *  borrowed for the call. The CPU is halted while a block transfer runs,
+ *  so they return with the copy done; below DMA_MIN_BLOCK_LEN, or with no
+ *  channel free, they fall back to the CPU. DMA_benchmark() times both
+ *  ways for one length to find where the crossover lies.
+ */
+
+#ifndef DMA_H_
+#define DMA_H_
+
+#include <msp430.h>
+#include <stdint.h>
+
+#define DMA_NUM_CHANNELS        3
+
+// Shortest block that DMA_memcpy/DMA_memset hand to the DMA. Programming
+// a channel costs about as much as copying a dozen bytes in a loop;
+// DMA_benchmark gives the crossover on the board.
+#define DMA_MIN_BLOCK_LEN       16
+
+// Returned by DMA_alloc when every channel is taken
+#define DMA_NO_CHANNEL          0xFF
+
+// Channel preference for DMA_alloc
+#define DMA_PRIO_HIGH           0
+#define DMA_PRIO_LOW            1
+
+// Trigger numbers on the F5529 (DMAxTSEL)
+#define DMA_TRIGGER_DMAREQ      0       // software, DMAREQ bit
+#define DMA_TRIGGER_TA0CCR0     1
+#define DMA_TRIGGER_TA0CCR2     2
+#define DMA_TRIGGER_TA1CCR0     3
+#define DMA_TRIGGER_TA1CCR2     4
+#define DMA_TRIGGER_TA2CCR0     5
+#define DMA_TRIGGER_TA2CCR2     6
+#define DMA_TRIGGER_TB0CCR0     7
+#define DMA_TRIGGER_TB0CCR2     8
+#define DMA_TRIGGER_UCA0RX      16
+#define DMA_TRIGGER_UCA0TX      17
+#define DMA_TRIGGER_UCB0RX      18
+#define DMA_TRIGGER_UCB0TX      19
+#define DMA_TRIGGER_UCA1RX      20
+#define DMA_TRIGGER_UCA1TX      21
+#define DMA_TRIGGER_UCB1RX      22
+#define DMA_TRIGGER_UCB1TX      23
+#define DMA_TRIGGER_ADC12       24
+
+// Runs from the DMA interrupt (or DMA_service) when a channel's transfer
+// ends. Returns non-zero to wake the main loop from low power mode.
+typedef uint8_t (*DMA_Callback)(uint8_t channel);
+
+uint8_t DMA_alloc(uint8_t trigger, uint8_t priority, DMA_Callback done);
+void DMA_free(uint8_t channel);
+
+// Programs and enables a channel. ctl is the DMAxCTL value without DMAEN:
+// transfer mode, address steps, byte/word sizes, and DMAIE to have the
+// channel's callback run when the transfer ends.
+void DMA_start(uint8_t channel, const volatile void *src, volatile void *dst,
+               uint16_t size, uint16_t ctl);
+void DMA_stop(uint8_t channel);
+uint8_t DMA_isBusy(uint8_t channel);
+
+// Runs the callbacks of finished channels; for callers that wait with
+// interrupts disabled
+uint8_t DMA_service(void);
+
+void DMA_memcpy(void *dst, const void *src, uint16_t len);
+void DMA_memset(void *dst, uint8_t value, uint16_t len);
+
+typedef struct DMA_Bench
+{
+    uint16_t len;               // bytes per block
+    uint16_t blocks;            // blocks timed with each method
+    uint32_t cpuCopyTicks;      // time base ticks for all blocks
+    uint32_t dmaCopyTicks;
+    uint32_t cpuFillTicks;
+    uint32_t dmaFillTicks;
+} DMA_Bench;
+
+uint8_t DMA_benchmark(void *dst, const void *src, uint16_t len, uint16_t blocks, DMA_Bench *bench);
+
+#endif /* DMA_H_ */
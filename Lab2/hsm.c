@@ -0,0 +1,296 @@
+/*
+ * hsm.c
+ *
+ *  Event queue, dispatch and transitions for hierarchical state machines.
+ *  See hsm.h.
+ */
+
+#include "hsm.h"
+
+
+// Number of states from this one up to the top
+static uint8_t depthOf(const HSM_State *state)
+{
+    uint8_t depth = 0;
+
+    while (state) {
+        depth++;
+        state = state->parent;
+    }
+    return depth;
+}
+
+// 1 if ancestor is a strict parent, grandparent, ... of state
+static uint8_t isAncestor(const HSM_State *ancestor, const HSM_State *state)
+{
+    for (state = state->parent; state; state = state->parent)
+        if (state == ancestor)
+            return 1;
+    return 0;
+}
+
+// Enters every state on the way from below the state 'from' (0 for the top)
+// down to target, then target's initial children. Entry actions may post
+// events and arm timers, but not request transitions.
+static void enter(HSM *me, const HSM_State *from, const HSM_State *target)
+{
+    const HSM_State *path[HSM_MAX_DEPTH];
+    const HSM_State *state;
+    int8_t n = 0;
+
+    for (state = target; state && (state != from) && (n < HSM_MAX_DEPTH); state = state->parent)
+        path[n++] = state;
+
+    while (n > 0) {
+        state = path[--n];
+        if (state->entry)
+            state->entry(me);
+    }
+
+    while (target->initial) {
+        target = target->initial;
+        if (target->entry)
+            target->entry(me);
+    }
+
+    me->current = target;
+}
+
+// Runs the transition requested by the last handler: leaves states until
+// the nearest one that contains the target, then enters down to it
+static void transition(HSM *me)
+{
+    const HSM_State *target = me->target;
+    const HSM_State *state = me->current;
+
+    me->target = 0;
+
+    while (state && !isAncestor(state, target)) {
+        if (state->exit)
+            state->exit(me);
+        state = state->parent;
+    }
+
+    enter(me, state, target);
+}
+
+// Removes the oldest event. Called with interrupts disabled.
+static uint8_t pop(HSM *me, HSM_Event *e)
+{
+    if (me->count == 0)
+        return 0;
+
+    *e = me->queue[me->head];
+    me->head = (me->head + 1) % HSM_QUEUE_LEN;
+    me->count--;
+    return 1;
+}
+
+// Appends an event. Called with interrupts disabled.
+static uint8_t push(HSM *me, const HSM_Event *e)
+{
+    if (me->count >= HSM_QUEUE_LEN) {
+        me->stats.dropped++;
+        return 0;
+    }
+
+    me->queue[(me->head + me->count) % HSM_QUEUE_LEN] = *e;
+    me->count++;
+
+    if (me->notify)
+        me->notify();
+    return 1;
+}
+
+static void dispatch(HSM *me, const HSM_Event *e)
+{
+    const HSM_State *state = me->current;
+    uint32_t start = Timebase_ticks();
+    uint32_t latency = start - e->stamp;
+    uint32_t run;
+    uint8_t result = HSM_SUPER;
+
+    me->stats.dispatched++;
+    me->stats.totalLatencyTicks += latency;
+    if (latency > me->stats.maxLatencyTicks)
+        me->stats.maxLatencyTicks = latency;
+
+    // Innermost state first, outwards until someone handles the event
+    while (state && (result == HSM_SUPER)) {
+        if (state->handler)
+            result = state->handler(me, e);
+        if (result == HSM_SUPER)
+            state = state->parent;
+    }
+
+    if ((result == HSM_DEFERRED) && (me->deferredCount < HSM_DEFER_LEN))
+        me->deferred[me->deferredCount++] = *e;
+
+    if (me->target)
+        transition(me);
+
+    run = Timebase_ticks() - start;
+    if (run > me->stats.maxRunTicks)
+        me->stats.maxRunTicks = run;
+}
+
+// Starts the machine: empties the queues and enters the initial state
+void HSM_init(HSM *me, const HSM_State *initial, HSM_Notify notify)
+{
+    me->head = 0;
+    me->count = 0;
+    me->deferredCount = 0;
+    me->notify = notify;
+    me->target = 0;
+    me->current = 0;
+    HSM_resetStats(me);
+
+    SWTimer_init();
+    enter(me, 0, initial);
+}
+
+// Queues a signal. Callable from interrupts. Returns 0 if the queue was full.
+uint8_t HSM_post(HSM *me, uint8_t sig, uint8_t param)
+{
+    HSM_Event e;
+    uint8_t posted;
+    __istate_t intState = __get_interrupt_state();
+
+    e.sig = sig;
+    e.param = param;
+    e.stamp = Timebase_ticks();
+
+    __disable_interrupt();
+    posted = push(me, &e);
+    __set_interrupt_state(intState);
+
+    return posted;
+}
+
+// Dispatches every queued event, including those posted while dispatching.
+// Returns the number of events dispatched.
+uint8_t HSM_dispatchAll(HSM *me)
+{
+    __istate_t intState;
+    HSM_Event e;
+    uint8_t n = 0, got;
+
+    while (1) {
+        intState = __get_interrupt_state();
+        __disable_interrupt();
+        got = pop(me, &e);
+        __set_interrupt_state(intState);
+
+        if (!got)
+            break;
+
+        dispatch(me, &e);
+        n++;
+    }
+    return n;
+}
+
+// Sleeps in LPM0 until an interrupt if no event is waiting. GIE and the
+// LPM bits are set in one instruction, so a post that lands after the
+// check still wakes the CPU. For apps without another run loop.
+void HSM_sleep(HSM *me)
+{
+    __disable_interrupt();
+
+    if (me->count == 0)
+        __bis_SR_register(LPM0_bits | GIE);
+    else
+        __enable_interrupt();
+}
+
+// Requests a transition, taken as soon as the running handler returns
+void HSM_transition(HSM *me, const HSM_State *target)
+{
+    me->target = target;
+}
+
+// 1 if the state is active, either innermost or as a parent
+uint8_t HSM_isIn(const HSM *me, const HSM_State *state)
+{
+    return (me->current == state) || isAncestor(state, me->current);
+}
+
+// Requeues the deferred events behind those already waiting, oldest first
+void HSM_recall(HSM *me)
+{
+    __istate_t intState = __get_interrupt_state();
+    uint8_t i;
+
+    __disable_interrupt();
+    for (i = 0; i < me->deferredCount; i++)
+        push(me, &me->deferred[i]);
+    __set_interrupt_state(intState);
+
+    me->deferredCount = 0;
+}
+
+// Software timer callback, runs from the Timer A1 ISR
+static void timerExpired(SWTimer *timer)
+{
+    HSM_Timer *t = (HSM_Timer *)timer->arg;
+
+    HSM_post(t->owner, t->sig, 0);
+}
+
+// Posts sig to the machine after delayMs, then every periodMs if that is not 0
+void HSM_armTimer(HSM_Timer *t, HSM *me, uint8_t sig, uint32_t delayMs, uint32_t periodMs)
+{
+    HSM_armTimerTicks(t, me, sig, TIMEBASE_MS_TO_TICKS(delayMs), TIMEBASE_MS_TO_TICKS(periodMs));
+}
+
+// As HSM_armTimer(), in time base ticks
+void HSM_armTimerTicks(HSM_Timer *t, HSM *me, uint8_t sig, uint32_t delayTicks, uint32_t periodTicks)
+{
+    HSM_disarmTimer(t);
+
+    t->owner = me;
+    t->sig = sig;
+    t->timer.callback = timerExpired;
+    t->timer.arg = t;
+    SWTimer_start(&t->timer, delayTicks, periodTicks);
+}
+
+// Stops the timer and drops any of its events still in the queue, so a
+// state that disarms its timer on exit never sees a stale timeout
+void HSM_disarmTimer(HSM_Timer *t)
+{
+    HSM *me = t->owner;
+    __istate_t intState;
+    uint8_t i, kept;
+
+    SWTimer_stop(&t->timer);
+    if (me == 0)
+        return;
+
+    intState = __get_interrupt_state();
+    __disable_interrupt();
+
+    kept = 0;
+    for (i = 0; i < me->count; i++) {
+        HSM_Event *e = &me->queue[(me->head + i) % HSM_QUEUE_LEN];
+        if (e->sig != t->sig)
+            me->queue[(me->head + kept++) % HSM_QUEUE_LEN] = *e;
+    }
+    me->count = kept;
+
+    __set_interrupt_state(intState);
+}
+
+const HSM_Stats *HSM_getStats(const HSM *me)
+{
+    return &me->stats;
+}
+
+void HSM_resetStats(HSM *me)
+{
+    me->stats.dispatched = 0;
+    me->stats.totalLatencyTicks = 0;
+    me->stats.maxLatencyTicks = 0;
+    me->stats.maxRunTicks = 0;
+    me->stats.dropped = 0;
+}
@@ -2,9 +2,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "peripherals.h"
+#include "swtimer.h"
+#include "hsm.h"
 #include "String.h"
-#include <pitches.h>
-#include <songs.h>
+#include "songs.h"
+#include "settings.h"
 
 
 /**
@@ -12,20 +14,22 @@
  */
 
 // Function Prototypes
-void playSong(int notes[], int durations[], float speed);
+void loadNote(void);
+void soundNote(void);
+void changeSpeed(uint8_t step);
+uint32_t scaleToStep(uint32_t ticks, uint8_t from, uint8_t to);
 
 void configUCS(void);
-void configTimerA2(void);
-__interrupt void Timer_A2_ISR(void);
 void resetTimer(void);
-unsigned int getMS();
-void stopTimerA2(void);
-void enableTimerA2(void);
+uint32_t getTicks(void);
+void pauseTimer(void);
+void resumeTimer(void);
 
 void ClearDisplay(void);
 void WelcomeDisplay(void);
 void SongMenuDisplay(void);
 void SettingsDisplay(void);
+void CountdownDisplay(void);
 
 void GoMainMenu(void);
 
@@ -33,382 +37,393 @@ void SongResetVars(void);
 
 void ledFunction(char inbits);
 
+void keypadScan(SWTimer *t);
+
 
 const unsigned int defaultSpeed = 1500;         // default speed of a whole note is 1500 ms
 const unsigned int one_second = 1000;           // one second in ms
 
-int chosenSongSize;                             // stores size of array of song to be played
-int songToPlay;                                 // stores song number to be played
-
-int noteNumber = 0;                             // note number to be played, used for arrays storing notes and durations
-int note;                                       // intermediate variable stores current note in hz to be played
-int noteDuration;                               // intermediate variable stores duration in milliseconds (ms) of current note to be played
-bool firstTime = 1;                             // stores whether it is first time playing note
+const Song *chosenSong;                         // song to be played, from songList
+SongReader songReader;                          // position in the chosen song, read one note at a time
+SongNote currentNote;                           // note (frequency in hz, 0 for a rest) and length being played
+uint32_t wholeNoteTicks;                        // length of a whole note at normal speed, in time base ticks
+uint32_t noteTicks;                             // length of the current note at the current speed, in time base ticks
 
 const char led1ON = BIT0;                       // stores BIT0 for LED 1
 const char led2ON = BIT1;                       // stores BIT1 for LED 2
 const char OFF = 0;                             // used to turn off both LEDs
 
-unsigned int timer = 0;                         // timer count for TimerA2, increased by TimerA2 ISR
-unsigned int leapCount = 0;                     // leap count for TimerA2, for ISR
-const int resolutionMS = 5;                     // resolution of TimerA2 in milliseconds
-
-bool isPaused;                                  // state of song, isPaused = 0 song not paused, isPaused = 1 song is paused
-float speed = 1.0;                              // default playing speed
-const float increment = 0.15;                   // const increment of speed to play faster or slower
-
-bool lastButtonState = 0;                       // stores last button state, whether pressed or unpressed
-unsigned int lastDebounceTime = 0;              // time since last button press, for debounce
-const unsigned int debounceDelay = 75;          // debounce delay in milliseconds
+uint32_t timerStartTicks = 0;                   // time base reading when the song timer was reset
+uint32_t pausedTicks = 0;                       // song timer value while paused
+bool timerPaused = 0;                           // whether the song timer is paused
+
+// Playing speed steps, each exactly 9/8 faster than the one before (see
+// scaleToStep). Step SPEED_NORMAL is normal speed.
+#define SPEED_NORMAL    5
+#define SPEED_STEPS     12
+uint8_t speedStep = SPEED_NORMAL;
+
+// Settings kept in info memory (settings.h). The speed step is saved when
+// playback pauses or the song is left, not on each key press: a write can
+// compact the store and erase a segment with interrupts off for ~25 ms.
+#define SETTING_SPEED_STEP  0                   // speed step songs start at, one byte
+
+int countStep;                                  // 0-3 for '3', '2', '1', 'GO' in the countdown
+
+// Keypad: scanned from a software timer, each new key press is posted once,
+// which also debounces it
+#define KEYPAD_SCAN_MS  20
+SWTimer keypadTimer;
+unsigned char lastKey = 0;                      // key seen by the previous scan
+
+
+//*****************************************************************************
+//
+// Player state machine
+//
+//  welcome                 '*' -> menu
+//  menu                    '1'-'9' -> song, '#' -> welcome
+//  song                    '#' -> welcome
+//      countdown           3, 2, 1, GO one second apart, then -> player
+//      player              '2' faster, '3' slower, '4' -> menu
+//          playing         '1' -> paused, last note done -> welcome
+//          paused          '1' -> playing
+//
+//*****************************************************************************
+
+// Signals
+#define SIG_KEY         (HSM_SIG_USER + 0)      // param is the key
+#define SIG_COUNT       (HSM_SIG_USER + 1)      // next countdown step
+#define SIG_NOTE_END    (HSM_SIG_USER + 2)      // current note has played for its duration
+
+HSM player;
+HSM_Timer countdownTimer;                       // one second steps of the 3-2-1-GO countdown
+HSM_Timer noteTimer;                            // end of the current note
+
+void welcomeEntry(HSM *me);
+uint8_t welcomeHandler(HSM *me, const HSM_Event *e);
+void menuEntry(HSM *me);
+uint8_t menuHandler(HSM *me, const HSM_Event *e);
+void songEntry(HSM *me);
+void songExit(HSM *me);
+uint8_t songHandler(HSM *me, const HSM_Event *e);
+void countdownEntry(HSM *me);
+void countdownExit(HSM *me);
+uint8_t countdownHandler(HSM *me, const HSM_Event *e);
+void playerEntry(HSM *me);
+uint8_t playerHandler(HSM *me, const HSM_Event *e);
+void playingEntry(HSM *me);
+void playingExit(HSM *me);
+uint8_t playingHandler(HSM *me, const HSM_Event *e);
+void pausedEntry(HSM *me);
+uint8_t pausedHandler(HSM *me, const HSM_Event *e);
+
+extern const HSM_State countdownState;
+extern const HSM_State playingState;
+
+//                                  parent          initial             entry           exit            handler
+const HSM_State welcomeState    = { 0,              0,                  welcomeEntry,   0,              welcomeHandler };
+const HSM_State menuState       = { 0,              0,                  menuEntry,      0,              menuHandler };
+const HSM_State songState       = { 0,              &countdownState,    songEntry,      songExit,       songHandler };
+const HSM_State countdownState  = { &songState,     0,                  countdownEntry, countdownExit,  countdownHandler };
+const HSM_State playerState     = { &songState,     &playingState,      playerEntry,    0,              playerHandler };
+const HSM_State playingState    = { &playerState,   0,                  playingEntry,   playingExit,    playingHandler };
+const HSM_State pausedState     = { &playerState,   0,                  pausedEntry,    0,              pausedHandler };
 
 
 int main(void)
 {
     WDTCTL = WDTPW | WDTHOLD;   // stop watchdog timer
 
-    int state = 0;                  // state of state machine starts at 0
-    int countState = 1;             // state of countdown state machine starts at 1
-
-    unsigned char currKey = 0;
-
     // Useful code starts here
-    // Initialization and configuration of LEDs, Display, Keypad, UCS, TimerA2
+    // Initialization and configuration of LEDs, Display (which also starts the time base), Keypad, UCS
     initLeds();
     configDisplay();
     configKeypad();
     configUCS();
-    configTimerA2();
+    SWTimer_init();
+    Settings_init();
 
     BuzzerOff();
-    WelcomeDisplay();       // starts with welcome display
+    HSM_init(&player, &welcomeState, 0);   // starts with welcome display
+
+    keypadTimer.callback = keypadScan;
+    SWTimer_startMs(&keypadTimer, KEYPAD_SCAN_MS, KEYPAD_SCAN_MS);
 
     _BIS_SR(GIE);           // enables interrupts
 
 
-    // Forever loop
+    // Forever loop: handles each key press and timer event once, and sleeps
+    // in between (LPM0, the buzzer runs from SMCLK)
     while (1) {
+        HSM_dispatchAll(&player);
+        HSM_sleep(&player);
+    }
+}
 
-        // State Machine. Switch statements take value of state and proceeds to Case accordingly
-        switch (state) {
-
-        // Waits until '*' is pressed to move to next state
-        case 0:
-            currKey = getKey();
-
-            // If '#' is pressed, returns to main menu, i.e. state = 0
-            if (currKey == '*') {
-                ClearDisplay();             // clears display of any previous stuff
-                SongMenuDisplay();          // displays song menu
-                state++;                    // moves to next state
-            }
-
-            break;
-
-        // Prompts user input to determine which song to play
-        case 1:
-            currKey = getKey();
-
-            // If '1' is pressed, then chooses settings to play song 1
-            if (currKey == '1') {
-                ClearDisplay();
-                SongResetVars();
-                countState = 1;                                     // sets countState = 1 for countdown state machine in case 2
-                chosenSongSize = sizeof(melody)/sizeof(int);        // sets chosenSongSize to size of array for song 1
-                songToPlay = 1;                                     // sets songToPlay to song 1
-                resetTimer();
-                state++;
-            }
-
-            // If '2' is pressed, then chooses settings to play song 2
-            else if (currKey == '2') {
-                ClearDisplay();
-                SongResetVars();
-                countState = 1;                                     // sets countState = 1 for countdown state machine in case 2
-                chosenSongSize = sizeof(melody2)/sizeof(int);       // sets chosenSongSize to size of array for song 2
-                songToPlay = 2;                                     // sets songToPlay to song 2
-                resetTimer();
-                state++;
-            }
-
-            // If '#' is pressed, returns to main menu, i.e. state = 0
-            if (currKey == '#') {
-                GoMainMenu();
-                state = 0;
-            }
-            break;
-
-        // Triggers countdown through use of countdown state machine
-        case 2:
-
-            // COUNTDOWN State machine
-            switch (countState) {
-
-
-                    // If countState = 1, turn LED 1 ON and display '3' for one second
-                    case 1:
-
-                        ledFunction(led1ON);
-                        Graphics_drawStringCentered(&g_sContext, "3", AUTO_STRING_LENGTH, 64, 64, TRANSPARENT_TEXT);
-                        Graphics_flushBuffer(&g_sContext);
-
-                        // Checks for one second to pass, then clears display, resets timer and countState++
-                        if(getMS() >= one_second) {
-                            ClearDisplay();
-                            resetTimer();
-                            countState++;
-                        }
-
-                        break;
-
-                    // If countState = 2, turn LED 2 ON and display '2' for one second
-                    case 2:
-
-                        ledFunction(led2ON);
-                        Graphics_drawStringCentered(&g_sContext, "2", AUTO_STRING_LENGTH, 64, 64, TRANSPARENT_TEXT);
-                        Graphics_flushBuffer(&g_sContext);
-
-                        // Checks for one second to pass, then clears display, resets timer and countState++
-                        if(getMS() >= one_second) {
-                            ClearDisplay();
-                            resetTimer();
-                            countState++;
-                        }
-
-                        break;
-
-                    // If countState = 3, turn LED 1 ON and display '1' for one second
-                    case 3:
-
-                        ledFunction(led1ON);
-                        Graphics_drawStringCentered(&g_sContext, "1", AUTO_STRING_LENGTH, 64, 64, TRANSPARENT_TEXT);
-                        Graphics_flushBuffer(&g_sContext);
-
-                        // Checks for one second to pass, then clears display, resets timer and countState++
-                        if(getMS() >= one_second) {
-                            ClearDisplay();
-                            resetTimer();
-                            countState++;
-                        }
-
-                        break;
-
-                    // If countState = 4, turn LED 1 and LED 2 ON and display 'GO' for one second
-                    case 4:
-
-                        ledFunction(led1ON | led2ON);
-                        Graphics_drawStringCentered(&g_sContext, "GO", AUTO_STRING_LENGTH, 64, 64, TRANSPARENT_TEXT);
-                        Graphics_flushBuffer(&g_sContext);
-
-                        // Checks for one second to pass, then clears display, resets timer and state++ for general (not countdown) state machine
-                        if(getMS() >= one_second) {
-                            ClearDisplay();
-                            ledFunction(OFF);
-                            state++;
-                        }
-
-                        break;
-
-            }
-
-            currKey = getKey();
-
-            // If '#' is pressed, returns to main menu, i.e. state = 0
-            if (currKey == '#') {
-                GoMainMenu();
-                state = 0;
-            }
-
-            break;
-
-        // Display song settings (i.e. play/pause, faster, slower, return), resets timer, goes next state
-        case 3:
-            SettingsDisplay();                      // Display song settings (i.e. play/pause, faster, slower, return)
-            resetTimer();                           // resets TimerA2
-            lastButtonState = 0;                    // sets lastButtonState = 0, i.e. button has not been pressed
-            state++;
-            break;
-
-        // Plays song note, checks to see if song has not finished
-        case 4:
-            ledFunction(led2ON);                    // turns green LED on to indiciate song is playing
-
-            // If note number is bigger or equal to the array of song chosen to be played, then go back to main menu
-            if (noteNumber >= chosenSongSize) {
-                GoMainMenu();
-                state = 0;
-                break;
-            }
-
-            // Determines which song to play based on songToPlay, which was determined in Case 1
-            if (songToPlay == 1)
-                playSong(melody, tempo, speed);         // Calls playSong() with melody, tempo, speed as parameters, i.e. play song 1 at speed
-            else if (songToPlay == 2)
-                playSong(melody2, tempo2, speed);       // Calls playSong() with melody2, tempo2, speed as parameters, i.e. play song 2 at speed
-
-            currKey = getKey();
-
-            // If '#' is pressed, returns to main menu, i.e. state = 0
-            if (currKey == '#') {
-                GoMainMenu();
-                state = 0;
-            }
-            else {
-                state++;
-            }
-            break;
-
-        // Extra case, just skips it
-        case 5:
-            state++;
-            break;
-
-        // Receives user input for Song Settings menu and determines whether to play/pause, faster, slower or return to song options menu
-        case 6:
-            currKey = getKey();
-            int currKeyInt = currKey - '0';
-
-            switch (currKeyInt) {
-
-            // If user input is '1', it either pauses or plays song, depending on current state of song
-            case 1:
-
-                // Sets lastDebounceTime to current time in ms if lastButtonState = 0, not pressed
-                if (!lastButtonState) {
-                    lastDebounceTime = getMS();         // Sets lastDebounceTime to current time in ms
-                    lastButtonState = 1;                // Sets lastButtonState = 1, i.e. button has been pressed
-                }
-
-                if ((getMS() - lastDebounceTime) > debounceDelay) {     // Checks for time debounceDelay (75 ms) to have passed
-                    if (!isPaused) {                // if song is not currently paused
-                        isPaused = 1;               // set isPaused = 1, i.e. song is now paused
-                        ledFunction(OFF);           // turn off all LEDs
-                        ledFunction(led1ON);        // turn on red LED ON
-                        stopTimerA2();              // stop TimerA2
-                        BuzzerOff();                // turn buzzer off, paused buzzer
-                    }
-                    else if (isPaused) {            // is song is currently paused
-                        isPaused = 0;               // set isPaused = 0, song is now not paused
-                        enableTimerA2();            // enables TimerA2 (which was stopped)
-                        lastButtonState = 0;        // sets lastButtonState = 0, i.e. button is not pressed
-                        state = 4;                  // goes back to Case/State 4
-                    }
-                    lastButtonState = 0;            // sets lastButtonState = 0, i.e. button is not pressed
-                }
-                break;
-
-            // If user input is '1', it either pauses or plays song, depending on state of song
-            case 2:
-                // Sets lastDebounceTime to current time in ms if lastButtonState = 0, not pressed
-                if (!lastButtonState) {
-                    lastDebounceTime = getMS();
-                    lastButtonState = 1;
-                }
-
-                if ((getMS() - lastDebounceTime) > debounceDelay) {     // debounce for button
-                    speed = speed + increment;      // increments speed by 'increment' interval
-                    lastButtonState = 0;
-                }
-                break;
-
-            // If user input is '1', it either pauses or plays song, depending on state of song
-            case 3:
-                // Sets lastDebounceTime to current time in ms if lastButtonState = 0, not pressed
-                if (!lastButtonState) {
-                    lastDebounceTime = getMS();
-                    lastButtonState = 1;
-                }
-
-                if ((getMS() - lastDebounceTime) > debounceDelay) {     // debounce for button
-                    speed = speed - increment;      // decrements speed by 'increment' interval
-                    lastButtonState = 0;
-                }
-                break;
-
-            // If user input is '1', it either pauses or plays song, depending on state of song
-            case 4:
-                BuzzerOff();
-                ClearDisplay();
-                SongMenuDisplay();
-                ledFunction(OFF);
-                state = 1;
-                break;
-
-            // If no user input, if not paused, go back to State 4
-            default:
-                if (!isPaused)      // if song is not currently paused
-                    state = 4;      // go back to Case 4
-                break;
-            }
-
-            break;
-        }
+
+// Keypad scan, runs from the Timer A1 ISR every KEYPAD_SCAN_MS
+void keypadScan(SWTimer *t) {
+    unsigned char key = getKey();
+
+    if (key && (key != lastKey))
+        HSM_post(&player, SIG_KEY, key);
+    lastKey = key;
+}
+
+
+// Welcome screen, waits until '*' is pressed to go to the song menu
+void welcomeEntry(HSM *me) {
+    GoMainMenu();
+}
+
+uint8_t welcomeHandler(HSM *me, const HSM_Event *e) {
+    if ((e->sig == SIG_KEY) && (e->param == '*')) {
+        HSM_transition(me, &menuState);
+        return HSM_HANDLED;
     }
+    return HSM_SUPER;
 }
 
 
-void playSong(int notes[], int durations[], float speed) {
-    note = notes[noteNumber];
-    noteDuration = defaultSpeed / (durations[noteNumber] * speed);      // noteduraiton in ms
+// Song menu, prompts user input to determine which song to play
+void menuEntry(HSM *me) {
+    ClearDisplay();             // clears display of any previous stuff
+    SongMenuDisplay();          // displays song menu
+}
+
+uint8_t menuHandler(HSM *me, const HSM_Event *e) {
+    if (e->sig != SIG_KEY)
+        return HSM_SUPER;
 
-    if (firstTime) {           //this if-statement ensures that the note is only played once
-      BuzzerOnFreq(note);
-      firstTime = 0;
-    } else if (getMS() > (noteDuration)) {    //songTimer reset and noteNumber is increased to play next note
-      resetTimer();
-      noteNumber = noteNumber + 1;          // increments noteNumber to play next note
-      firstTime = 1;
+    // If '1' to '9' is pressed, then chooses that song from the song list
+    if ((e->param >= '1') && (e->param < '1' + SONG_COUNT)) {
+        chosenSong = &songList[e->param - '1'];
+        HSM_transition(me, &songState);
     }
+
+    // If '#' is pressed, returns to main menu
+    if (e->param == '#')
+        HSM_transition(me, &welcomeState);
+
+    return HSM_HANDLED;
 }
 
 
-// configures UCS
-void configUCS() {
-    P5SEL |= (BIT5 | BIT4 | BIT3 |BIT2);    // enables XT1CLK and XT2CLK, both crystal clocks
+// Song: countdown and playback of the chosen song, '#' returns to the main menu from anywhere in it
+void songEntry(HSM *me) {
+    SongResetVars();
 }
 
-// configures TimerA2, including source clk, divider, up mode; also sets Max count to 164; enables TimerA2 interrupt
-void configTimerA2 () {
-    TA2CTL = TASSEL_1 + ID_0 + MC_1;         // sets ACLK as TimerA2 source, divider is 1, up mode
-    TA2CCR0 = 163;                         // TA2CCR0 = MaxCount - 1 = 164 - 1 = 163
-    TA2CCTL0 = CCIE;                        // TA2CCR0 interrupt enabled
+void songExit(HSM *me) {
+    BuzzerOff();
+    ledFunction(OFF);
+    Settings_set(SETTING_SPEED_STEP, &speedStep, 1);  // the next song starts here
+}
+
+uint8_t songHandler(HSM *me, const HSM_Event *e) {
+    if ((e->sig == SIG_KEY) && (e->param == '#')) {
+        HSM_transition(me, &welcomeState);
+        return HSM_HANDLED;
+    }
+    return HSM_SUPER;
+}
+
+
+// Countdown, 3-2-1-GO with the LEDs, each step drawn once when the countdown timer fires
+void countdownEntry(HSM *me) {
+    countStep = 0;
+    CountdownDisplay();
+    HSM_armTimer(&countdownTimer, me, SIG_COUNT, one_second, one_second);  // steps the countdown every second
+}
+
+void countdownExit(HSM *me) {
+    HSM_disarmTimer(&countdownTimer);
 }
 
-// TimerA2 ISR configuration
-// Leap counting implemented for timer
-#pragma vector=TIMER2_A0_VECTOR
-__interrupt void Timer_A2_ISR(void) {
+uint8_t countdownHandler(HSM *me, const HSM_Event *e) {
+    if (e->sig != SIG_COUNT)
+        return HSM_SUPER;
 
-    if (leapCount < 1024) {     // after 1024 interrupts, timer is off by resolution, i.e. 0.005 seconds
-        timer++;
-        leapCount++;
+    countStep++;
+    if (countStep > 3) {
+        ledFunction(OFF);
+        HSM_transition(me, &playerState);
+    } else {
+        CountdownDisplay();
     }
-    else {
-        timer = timer + 2;      // increase timer by 2 at 1024 interrupt count
-        leapCount = 0;          // leap count is reset to 0 at 1024 interrupt count
+    return HSM_HANDLED;
+}
+
+
+// Player, shows the song settings (i.e. play/pause, faster, slower, return) and handles speed and return
+void playerEntry(HSM *me) {
+    ClearDisplay();
+    SettingsDisplay();                      // Display song settings (i.e. play/pause, faster, slower, return)
+    loadNote();                             // times the first note
+}
+
+uint8_t playerHandler(HSM *me, const HSM_Event *e) {
+    if (e->sig != SIG_KEY)
+        return HSM_SUPER;
+
+    switch (e->param) {
+
+    // If user input is '2', plays one step faster, from now on
+    case '2':
+        if (speedStep < SPEED_STEPS - 1)
+            changeSpeed(speedStep + 1);
+        return HSM_HANDLED;
+
+    // If user input is '3', plays one step slower, from now on
+    case '3':
+        if (speedStep > 0)
+            changeSpeed(speedStep - 1);
+        return HSM_HANDLED;
+
+    // If user input is '4', goes back to the song options menu
+    case '4':
+        HSM_transition(me, &menuState);
+        return HSM_HANDLED;
     }
+
+    return HSM_SUPER;
+}
+
+
+// Playing, each note is started once and ends on the note timer
+void playingEntry(HSM *me) {
+    ledFunction(led2ON);                    // turns green LED on to indicate song is playing
+    resumeTimer();                          // continues the song timer if it was paused
+    soundNote();
 }
 
-// resets TimerA2
+void playingExit(HSM *me) {
+    HSM_disarmTimer(&noteTimer);
+}
+
+uint8_t playingHandler(HSM *me, const HSM_Event *e) {
+
+    if (e->sig == SIG_NOTE_END) {
+
+        // Reads the next note, at the end of the song goes back to main menu
+        if (!Song_next(&songReader, &currentNote)) {
+            HSM_transition(me, &welcomeState);
+        } else {
+            loadNote();
+            soundNote();
+        }
+        return HSM_HANDLED;
+    }
+
+    // If user input is '1', pauses the song
+    if ((e->sig == SIG_KEY) && (e->param == '1')) {
+        HSM_transition(me, &pausedState);
+        return HSM_HANDLED;
+    }
+
+    return HSM_SUPER;
+}
+
+
+// Paused, red LED on and buzzer off until '1' is pressed again
+void pausedEntry(HSM *me) {
+    ledFunction(led1ON);                    // turn on red LED ON
+    pauseTimer();                           // freeze the song timer
+    BuzzerOff();                            // turn buzzer off, paused buzzer
+    Settings_set(SETTING_SPEED_STEP, &speedStep, 1);  // nothing is playing while flash is written
+}
+
+uint8_t pausedHandler(HSM *me, const HSM_Event *e) {
+    if ((e->sig == SIG_KEY) && (e->param == '1')) {
+        HSM_transition(me, &playingState);
+        return HSM_HANDLED;
+    }
+    return HSM_SUPER;
+}
+
+
+// Works out the length of the note just read, in ticks at the current
+// speed, and starts timing it
+void loadNote() {
+    noteTicks = scaleToStep(wholeNoteTicks, SPEED_NORMAL, speedStep) / currentNote.divisor;
+    if (currentNote.dotted)
+        noteTicks = noteTicks + noteTicks / 2;
+
+    resetTimer();
+}
+
+// Sounds the current note (a rest for 0) and arms the note timer for
+// what is left of it
+void soundNote() {
+    uint32_t elapsed = getTicks();
+
+    if (currentNote.hz)
+        BuzzerOnFreq(currentNote.hz);
+    else
+        BuzzerOff();
+
+    HSM_armTimerTicks(&noteTimer, &player, SIG_NOTE_END,
+                      (elapsed < noteTicks) ? (noteTicks - elapsed) : 0, 0);
+}
+
+// Scales a duration at speed step from to the same length of music at
+// step to: times 8/9 for each step faster, 9/8 for each step slower,
+// rounded to the nearest tick at each step
+uint32_t scaleToStep(uint32_t ticks, uint8_t from, uint8_t to) {
+    for (; from < to; from++)
+        ticks = (ticks * 8 + 4) / 9;
+    for (; from > to; from--)
+        ticks = (ticks * 9 + 4) / 8;
+    return ticks;
+}
+
+// Moves to another speed step. What is left of the current note is
+// scaled by the ratio of the two speeds, so the change takes effect at
+// once, and the note timer is re-armed if the song is playing.
+void changeSpeed(uint8_t step) {
+    uint32_t elapsed = getTicks();
+    uint32_t left = (elapsed < noteTicks) ? (noteTicks - elapsed) : 0;
+
+    left = scaleToStep(left, speedStep, step);
+    speedStep = step;
+    noteTicks = elapsed + left;
+
+    if (HSM_isIn(&player, &playingState))
+        HSM_armTimerTicks(&noteTimer, &player, SIG_NOTE_END, left, 0);
+}
+
+
+// configures UCS
+void configUCS() {
+    P5SEL |= (BIT5 | BIT4 | BIT3 |BIT2);    // enables XT1CLK and XT2CLK, both crystal clocks
+}
+
+// resets the song timer to 0
 void resetTimer() {
-    timer = 0;
-    leapCount = 0;
+    timerStartTicks = Timebase_ticks();
+    pausedTicks = 0;
+    timerPaused = 0;
 }
 
-// returns time in milliseconds
-unsigned int getMS() {
-    unsigned int ms = timer * resolutionMS;     // milliseconds is current imer count * 5 ms, resolution of timer in ms
+// returns time base ticks since the song timer was reset, not counting time spent paused
+uint32_t getTicks() {
+    if (timerPaused)
+        return pausedTicks;
 
-    return ms;
+    return Timebase_ticks() - timerStartTicks;
 }
 
-// stops timer A2
-void stopTimerA2() {
-    TA2CTL |= MC_0;         // stop timer, enable stop mode
+// freezes the song timer at its current value
+void pauseTimer() {
+    pausedTicks = getTicks();
+    timerPaused = 1;
 }
 
-// enables TimerA2 after being stopped
-void enableTimerA2() {
-    TA2CTL |= MC_1;        // up mode
+// restarts the song timer from the value it was paused at
+void resumeTimer() {
+    timerStartTicks = Timebase_ticks() - pausedTicks;
+    timerPaused = 0;
 }
 
 
@@ -424,10 +439,25 @@ void WelcomeDisplay() {
     Graphics_flushBuffer(&g_sContext);
 }
 
+// Lists the songs as "1. name", as many as fit below the title
 void SongMenuDisplay() {
+    char line[24];
+    const char *name;
+    unsigned int i, n;
+
     Graphics_drawStringCentered(&g_sContext, "CHOOSE SONG", AUTO_STRING_LENGTH, 64, 50, TRANSPARENT_TEXT);
-    Graphics_drawStringCentered(&g_sContext, "1. Mario Theme Song", AUTO_STRING_LENGTH, 64, 70, TRANSPARENT_TEXT);
-    Graphics_drawStringCentered(&g_sContext, "2. HBD Song", AUTO_STRING_LENGTH, 64, 80, TRANSPARENT_TEXT);
+
+    for (i = 0; (i < SONG_COUNT) && (i < 4); i++) {
+        // Built by hand, as minimal printf has no %u
+        line[0] = (i + 1) + '0';
+        line[1] = '.';
+        line[2] = ' ';
+        name = songList[i].name;
+        for (n = 3; (n < sizeof(line) - 1) && *name; n++)
+            line[n] = *name++;
+        line[n] = '\0';
+        Graphics_drawStringCentered(&g_sContext, (uint8_t *)line, AUTO_STRING_LENGTH, 64, 70 + 10 * i, TRANSPARENT_TEXT);
+    }
     Graphics_flushBuffer(&g_sContext);
 }
 
@@ -440,6 +470,17 @@ void SettingsDisplay() {
     Graphics_flushBuffer(&g_sContext);
 }
 
+// Draws the current countdown step, '3', '2', '1' then 'GO', with alternating LEDs
+void CountdownDisplay() {
+    const char *text[4] = {"3", "2", "1", "GO"};
+    const char leds[4] = {led1ON, led2ON, led1ON, led1ON | led2ON};
+
+    ledFunction(leds[countStep]);
+    Graphics_clearDisplay(&g_sContext);
+    Graphics_drawStringCentered(&g_sContext, (uint8_t *)text[countStep], AUTO_STRING_LENGTH, 64, 64, TRANSPARENT_TEXT);
+    Graphics_flushBuffer(&g_sContext);
+}
+
 void GoMainMenu() {
     BuzzerOff();
     ClearDisplay();
@@ -447,11 +488,19 @@ void GoMainMenu() {
     WelcomeDisplay();
 }
 
+// Starts the chosen song from its first note at the last speed chosen,
+// taking the song's own tempo if it sets one
 void SongResetVars() {
-    firstTime = 1;
-    noteNumber = 0;
-    isPaused = 0;
-    speed = 1.0;
+    Song_start(&songReader, chosenSong);
+    Song_next(&songReader, &currentNote);
+
+    if (songReader.bpm)
+        wholeNoteTicks = (4 * 60 * TIMEBASE_TICKS_PER_SEC) / songReader.bpm;
+    else
+        wholeNoteTicks = TIMEBASE_MS_TO_TICKS(defaultSpeed);
+
+    if (!Settings_get(SETTING_SPEED_STEP, &speedStep, 1) || (speedStep >= SPEED_STEPS))
+        speedStep = SPEED_NORMAL;
 }
 
 // Function that turns LED 1 or LED 2 on (and off)
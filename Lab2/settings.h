@@ -0,0 +1,46 @@
+/*
+ * settings.h
+ *
+ *  Small key/value store that survives resets, kept in info memory
+ *  segments D, C and B (128 bytes each, 0x1800-0x197F; segment A is left
+ *  alone). The store is an append-only log: setting a key adds an entry
+ *  to the end of the active segment, so an update costs a few byte
+ *  writes and no erase. A RAM index holds where each key's latest entry
+ *  is, so reads go straight to it.
+ *
+ *  Segment:  'K' | state | seq (2) | entries ... | erased
+ *  Entry:    key | len | value (len) | CRC high | CRC low
+ *
+ *  An entry counts only once its CRC-16/CCITT (crc16.h, over key, len and
+ *  value) has been written, so a reset in the middle of an update leaves
+ *  the previous value in force. When the active segment is full, the
+ *  latest entry of every key is copied into the next segment, which is
+ *  then marked active (state 0xFF -> 0x00) with the next seq, and only
+ *  then is the old one erased. Among active segments the highest seq
+ *  wins. The three segments take turns, so erases are spread evenly over
+ *  them.
+ *
+ *  The latest values of all keys together must fit in one segment:
+ *  (4 + len) bytes each, 124 bytes in all.
+ *
+ *  HOST_BUILD keeps the segments in a RAM array with the same erase and
+ *  write rules, for trying the store on a PC.
+ */
+
+#ifndef SETTINGS_H_
+#define SETTINGS_H_
+
+#include <stdint.h>
+
+#define SETTINGS_START          0x1800  // INFOD, then INFOC and INFOB
+#define SETTINGS_SEGMENTS       3
+#define SETTINGS_SEGMENT_SIZE   128
+
+#define SETTINGS_MAX_KEYS       16      // keys 0 to 15
+#define SETTINGS_MAX_LEN        16      // bytes per value
+
+void Settings_init(void);
+uint8_t Settings_get(uint8_t key, void *value, uint8_t maxLen);
+uint8_t Settings_set(uint8_t key, const void *value, uint8_t len);
+
+#endif /* SETTINGS_H_ */
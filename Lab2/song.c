@@ -0,0 +1,229 @@
+/*
+ * song.c
+ *
+ *  Streaming decoder for packed songs. See song.h.
+ */
+
+#include "song.h"
+#include "pitches.h"
+
+// Note frequencies in Hz by note index, 0 being a rest
+static const uint16_t noteHz[SONG_NUM_PITCHES + 1] = {
+    0,
+    NOTE_B0,
+    NOTE_C1, NOTE_CS1, NOTE_D1, NOTE_DS1, NOTE_E1, NOTE_F1, NOTE_FS1, NOTE_G1, NOTE_GS1, NOTE_A1, NOTE_AS1, NOTE_B1,
+    NOTE_C2, NOTE_CS2, NOTE_D2, NOTE_DS2, NOTE_E2, NOTE_F2, NOTE_FS2, NOTE_G2, NOTE_GS2, NOTE_A2, NOTE_AS2, NOTE_B2,
+    NOTE_C3, NOTE_CS3, NOTE_D3, NOTE_DS3, NOTE_E3, NOTE_F3, NOTE_FS3, NOTE_G3, NOTE_GS3, NOTE_A3, NOTE_AS3, NOTE_B3,
+    NOTE_C4, NOTE_CS4, NOTE_D4, NOTE_DS4, NOTE_E4, NOTE_F4, NOTE_FS4, NOTE_G4, NOTE_GS4, NOTE_A4, NOTE_AS4, NOTE_B4,
+    NOTE_C5, NOTE_CS5, NOTE_D5, NOTE_DS5, NOTE_E5, NOTE_F5, NOTE_FS5, NOTE_G5, NOTE_GS5, NOTE_A5, NOTE_AS5, NOTE_B5,
+    NOTE_C6, NOTE_CS6, NOTE_D6, NOTE_DS6, NOTE_E6, NOTE_F6, NOTE_FS6, NOTE_G6, NOTE_GS6, NOTE_A6, NOTE_AS6, NOTE_B6,
+    NOTE_C7, NOTE_CS7, NOTE_D7, NOTE_DS7, NOTE_E7, NOTE_F7, NOTE_FS7, NOTE_G7, NOTE_GS7, NOTE_A7, NOTE_AS7, NOTE_B7,
+    NOTE_C8, NOTE_CS8, NOTE_D8, NOTE_DS8
+};
+
+// Note length until a song sets one: a quarter note
+#define SONG_DEFAULT_DIVISOR    4
+
+// RTTTL octave when the string does not give one
+#define RTTTL_DEFAULT_OCTAVE    6
+
+// Semitone of RTTTL note letters 'a' to 'h', 'h' being the German B
+static const int8_t rtttlSemitone[8] = {
+    SONG_A, SONG_B, SONG_C, SONG_D, SONG_E, SONG_F, SONG_G, SONG_B
+};
+
+static uint8_t isDigit(char c)
+{
+    return (c >= '0') && (c <= '9');
+}
+
+// Reads a decimal number at *text, 0 if there is none
+static uint16_t readNumber(const char **text)
+{
+    uint16_t n = 0;
+
+    while (isDigit(**text))
+        n = n * 10 + (*(*text)++ - '0');
+    return n;
+}
+
+// Opens the song in whichever form it is stored
+void Song_start(SongReader *r, const Song *song)
+{
+    if (song->data)
+        Song_open(r, song->data);
+    else
+        Song_openRtttl(r, song->rtttl);
+}
+
+void Song_open(SongReader *r, const uint8_t *data)
+{
+    r->pos = data;
+    r->mark = 0;
+    r->markDivisor = SONG_DEFAULT_DIVISOR;
+    r->divisor = SONG_DEFAULT_DIVISOR;
+    r->repeatsLeft = 0;
+    r->repeating = 0;
+    r->bpm = 0;
+    r->rtttl = 0;
+    r->octave = RTTTL_DEFAULT_OCTAVE;
+}
+
+// Opens an RTTTL string: skips the name and reads the d=, o= and b=
+// defaults, leaving the reader at the first note
+void Song_openRtttl(SongReader *r, const char *text)
+{
+    uint16_t value;
+    char key;
+
+    Song_open(r, 0);
+    r->rtttl = 1;
+
+    while (*text && (*text != ':'))     // name
+        text++;
+    if (*text)
+        text++;
+
+    while (1) {
+        while ((*text == ' ') || (*text == ','))
+            text++;
+        if ((*text == '\0') || (*text == ':'))
+            break;
+
+        key = *text++ | 0x20;
+        while ((*text == ' ') || (*text == '='))
+            text++;
+        value = readNumber(&text);
+
+        if ((key == 'd') && (value >= 1) && (value <= 63))
+            r->divisor = value;
+        else if ((key == 'o') && (value <= 8))
+            r->octave = value;
+        else if (key == 'b')
+            r->bpm = value;
+
+        while (*text && (*text != ',') && (*text != ':'))
+            text++;
+    }
+
+    if (*text == ':')
+        text++;
+    r->pos = (const uint8_t *)text;
+}
+
+// Parses one RTTTL note: [duration] letter [#] [.] [octave] [.]
+static uint8_t nextRtttl(SongReader *r, SongNote *note)
+{
+    const char *text = (const char *)r->pos;
+    uint16_t divisor;
+    uint8_t octave = r->octave;
+    int16_t index = 0;
+    char letter;
+
+    while ((*text == ',') || (*text == ' '))
+        text++;
+    if (*text == '\0') {
+        r->pos = (const uint8_t *)text;
+        return 0;
+    }
+
+    divisor = readNumber(&text);
+    note->divisor = ((divisor >= 1) && (divisor <= 63)) ? divisor : r->divisor;
+    note->dotted = 0;
+
+    letter = *text | 0x20;              // lower case
+    if (*text)
+        text++;
+
+    if ((letter >= 'a') && (letter <= 'h')) {
+        index = rtttlSemitone[letter - 'a'];
+        if (*text == '#') {
+            index++;
+            text++;
+        }
+        if (*text == '.') {
+            note->dotted = 1;
+            text++;
+        }
+        if (isDigit(*text))
+            octave = readNumber(&text);
+        index += (int16_t)octave * 12 - 10;   // as SONG_NOTE
+        if ((index < 1) || (index > SONG_NUM_PITCHES))
+            index = 0;                  // out of range, kept silent
+    }
+    // 'p' and anything unknown is a rest
+
+    if (*text == '.') {
+        note->dotted = 1;
+        text++;
+    }
+    while (*text && (*text != ','))
+        text++;
+
+    note->hz = noteHz[index];
+    r->pos = (const uint8_t *)text;
+    return 1;
+}
+
+// Decodes the next note or rest. Returns 0 at the end of the song.
+uint8_t Song_next(SongReader *r, SongNote *note)
+{
+    uint8_t code;
+    uint8_t dotted = 0;
+
+    if (r->rtttl)
+        return nextRtttl(r, note);
+
+    while (1) {
+        code = *r->pos++;
+
+        if (code < 0x80) {
+            note->hz = (code <= SONG_NUM_PITCHES) ? noteHz[code] : 0;
+            note->divisor = r->divisor;
+            note->dotted = dotted;
+            return 1;
+        }
+
+        if ((code & 0xC0) == 0xC0) {
+            if (code & 0x3F)
+                r->divisor = code & 0x3F;
+            continue;
+        }
+
+        switch (code) {
+
+        case SONG_MARK:
+            r->mark = r->pos;
+            r->markDivisor = r->divisor;
+            break;
+
+        case 0x82:                      // SONG_REPEAT
+            if (!r->repeating) {
+                r->repeatsLeft = *r->pos;
+                r->repeating = 1;
+            }
+            r->pos++;
+
+            if (r->mark && r->repeatsLeft) {
+                r->repeatsLeft--;
+                r->pos = r->mark;
+                r->divisor = r->markDivisor;
+            } else {
+                r->repeating = 0;
+            }
+            break;
+
+        case SONG_DOT:
+            dotted = 1;
+            break;
+
+        case 0x84:                      // SONG_TEMPO
+            r->bpm = *r->pos++;
+            break;
+
+        default:                        // SONG_END and anything unknown
+            r->pos--;                   // stay at the end
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ * song.h
+ *
+ *  Packed song format and its streaming decoder. Songs are const byte
+ *  strings kept in flash, one byte per note:
+ *
+ *  0x00            rest
+ *  0x01 - 0x59     note, index into the pitches.h table (SONG_NOTE)
+ *  0xC0 | d        following notes last a 1/d note, d = 1-63 (SONG_LEN)
+ *  0x81            start of a section to repeat (SONG_MARK)
+ *  0x82 n          play the section since the mark n more times (SONG_REPEAT)
+ *  0x83            the next note lasts half as long again (SONG_DOT)
+ *  0x84 b          tempo of b quarter notes a minute (SONG_TEMPO)
+ *  0x80            end of song (SONG_END)
+ *
+ *  A note length stays in force until the next SONG_LEN, so a length byte
+ *  is only needed where it changes. The decoder reads one note at a time
+ *  and keeps no copy of the song, so songs take no RAM at all.
+ *
+ *  A song can instead be an RTTTL ringtone string ("name:d=4,o=5,b=120:
+ *  8e6,8e6,..."), parsed note by note from flash the same way. Songs in
+ *  either form can be converted to packed bytes with tools/songconv.
+ */
+
+#ifndef SONG_H_
+#define SONG_H_
+
+#include <stdint.h>
+
+// Semitones within an octave, for SONG_NOTE
+#define SONG_C      0
+#define SONG_CS     1
+#define SONG_D      2
+#define SONG_DS     3
+#define SONG_E      4
+#define SONG_F      5
+#define SONG_FS     6
+#define SONG_G      7
+#define SONG_GS     8
+#define SONG_A      9
+#define SONG_AS     10
+#define SONG_B      11
+
+// Song bytes
+#define SONG_REST               0x00
+#define SONG_NOTE(name, octave) ((octave) * 12 + SONG_##name - 10)    // B0 is 1, DS8 is 89
+#define SONG_LEN(divisor)       (0xC0 | (divisor))
+#define SONG_MARK               0x81
+#define SONG_REPEAT(times)      0x82, (times)
+#define SONG_DOT                0x83
+#define SONG_TEMPO(bpm)         0x84, (bpm)
+#define SONG_END                0x80
+
+#define SONG_NUM_PITCHES        89
+
+typedef struct Song
+{
+    const char *name;
+    const uint8_t *data;        // packed bytes, or 0 for an RTTTL song
+    const char *rtttl;          // RTTTL string when data is 0
+} Song;
+
+typedef struct SongNote
+{
+    uint16_t hz;                // 0 for a rest
+    uint8_t divisor;            // the note lasts a whole note divided by this
+    uint8_t dotted;             // 1 if it lasts half as long again
+} SongNote;
+
+typedef struct SongReader
+{
+    const uint8_t *pos;         // next byte
+    const uint8_t *mark;        // start of the section to repeat, or 0
+    uint8_t markDivisor;        // note length in force at the mark
+    uint8_t divisor;            // current note length
+    uint8_t repeatsLeft;
+    uint8_t repeating;          // between the first SONG_REPEAT and the last pass
+    uint16_t bpm;               // quarter notes a minute, 0 if the song does not set it
+    uint8_t rtttl;              // 1 if pos points into an RTTTL string
+    uint8_t octave;             // RTTTL default octave
+} SongReader;
+
+void Song_start(SongReader *r, const Song *song);
+void Song_open(SongReader *r, const uint8_t *data);
+void Song_openRtttl(SongReader *r, const char *text);
+uint8_t Song_next(SongReader *r, SongNote *note);
+
+#endif /* SONG_H_ */
@@ -1,69 +1,70 @@
+/*
+ * songs.h
+ *
+ *  Songs for the player, packed bytes or RTTTL strings as described in
+ *  song.h, kept in flash. Add a song by writing its bytes (tools/songconv
+ *  makes them from RTTTL or MIDI) or its RTTTL string, and listing it in
+ *  songList.
+ */
 
+#ifndef SONGS_H_
+#define SONGS_H_
 
-int melody[] = {
-  NOTE_E7, NOTE_E7, 0, NOTE_E7,
-  0, NOTE_C7, NOTE_E7, 0,
-  NOTE_G7, 0, 0,  0,
-  NOTE_G6, 0, 0, 0,
+#include "song.h"
 
-  NOTE_C7, 0, 0, NOTE_G6,
-  0, 0, NOTE_E6, 0,
-  0, NOTE_A6, 0, NOTE_B6,
-  0, NOTE_AS6, NOTE_A6, 0,
+const uint8_t songMario[] = {
+    SONG_LEN(12),
+    SONG_NOTE(E, 7), SONG_NOTE(E, 7), SONG_REST, SONG_NOTE(E, 7),
+    SONG_REST, SONG_NOTE(C, 7), SONG_NOTE(E, 7), SONG_REST,
+    SONG_NOTE(G, 7), SONG_REST, SONG_REST, SONG_REST,
+    SONG_NOTE(G, 6), SONG_REST, SONG_REST, SONG_REST,
 
-  NOTE_G6, NOTE_E7, NOTE_G7,
-  NOTE_A7, 0, NOTE_F7, NOTE_G7,
-  0, NOTE_E7, 0, NOTE_C7,
-  NOTE_D7, NOTE_B6, 0, 0,
+    // played twice
+    SONG_MARK,
+    SONG_NOTE(C, 7), SONG_REST, SONG_REST, SONG_NOTE(G, 6),
+    SONG_REST, SONG_REST, SONG_NOTE(E, 6), SONG_REST,
+    SONG_REST, SONG_NOTE(A, 6), SONG_REST, SONG_NOTE(B, 6),
+    SONG_REST, SONG_NOTE(AS, 6), SONG_NOTE(A, 6), SONG_REST,
 
-  NOTE_C7, 0, 0, NOTE_G6,
-  0, 0, NOTE_E6, 0,
-  0, NOTE_A6, 0, NOTE_B6,
-  0, NOTE_AS6, NOTE_A6, 0,
+    SONG_LEN(9),
+    SONG_NOTE(G, 6), SONG_NOTE(E, 7), SONG_NOTE(G, 7),
+    SONG_LEN(12),
+    SONG_NOTE(A, 7), SONG_REST, SONG_NOTE(F, 7), SONG_NOTE(G, 7),
+    SONG_REST, SONG_NOTE(E, 7), SONG_REST, SONG_NOTE(C, 7),
+    SONG_NOTE(D, 7), SONG_NOTE(B, 6), SONG_REST, SONG_REST,
+    SONG_REPEAT(1),
 
-  NOTE_G6, NOTE_E7, NOTE_G7,
-  NOTE_A7, 0, NOTE_F7, NOTE_G7,
-  0, NOTE_E7, 0, NOTE_C7,
-  NOTE_D7, NOTE_B6, 0, 0
+    SONG_END
 };
 
-int tempo[] = {
-  12, 12, 12, 12,
-  12, 12, 12, 12,
-  12, 12, 12, 12,
-  12, 12, 12, 12,
-
-  12, 12, 12, 12,
-  12, 12, 12, 12,
-  12, 12, 12, 12,
-  12, 12, 12, 12,
-
-  9, 9, 9,
-  12, 12, 12, 12,
-  12, 12, 12, 12,
-  12, 12, 12, 12,
+const uint8_t songBirthday[] = {
+    SONG_LEN(8), SONG_NOTE(C, 4), SONG_NOTE(C, 4),
+    SONG_LEN(4), SONG_NOTE(D, 4), SONG_NOTE(C, 4), SONG_NOTE(F, 4),
+    SONG_LEN(2), SONG_NOTE(E, 4),
+    SONG_LEN(8), SONG_NOTE(C, 4), SONG_NOTE(C, 4),
+    SONG_LEN(4), SONG_NOTE(D, 4), SONG_NOTE(C, 4), SONG_NOTE(G, 4),
+    SONG_LEN(2), SONG_NOTE(F, 4),
+    SONG_LEN(8), SONG_NOTE(C, 4), SONG_NOTE(C, 4),
+    SONG_LEN(4), SONG_NOTE(C, 5), SONG_NOTE(A, 4), SONG_NOTE(F, 4), SONG_NOTE(E, 4), SONG_NOTE(D, 4),
+    SONG_LEN(8), SONG_NOTE(AS, 4), SONG_NOTE(AS, 4),
+    SONG_LEN(4), SONG_NOTE(A, 4), SONG_NOTE(F, 4), SONG_NOTE(G, 4),
+    SONG_LEN(2), SONG_NOTE(F, 4),
+    SONG_END
+};
 
-  12, 12, 12, 12,
-  12, 12, 12, 12,
-  12, 12, 12, 12,
-  12, 12, 12, 12,
+// RTTTL songs are parsed as they play, see song.h
+const char songOdeToJoy[] =
+    "Ode to Joy:d=4,o=5,b=140:"
+    "e,e,f,g,g,f,e,d,c,c,d,e,e.,8d,2d,"
+    "e,e,f,g,g,f,e,d,c,c,d,e,d.,8c,2c";
 
-  9, 9, 9,
-  12, 12, 12, 12,
-  12, 12, 12, 12,
-  12, 12, 12, 12,
+// Menu order, picked with keys '1' to '9'
+const Song songList[] = {
+    {"Mario Theme Song", songMario},
+    {"HBD Song", songBirthday},
+    {"Ode to Joy", 0, songOdeToJoy},
 };
 
-int melody2[] = {
-  NOTE_C4, NOTE_C4, NOTE_D4, NOTE_C4, NOTE_F4, NOTE_E4,
-  NOTE_C4, NOTE_C4, NOTE_D4, NOTE_C4, NOTE_G4, NOTE_F4,
-  NOTE_C4, NOTE_C4, NOTE_C5, NOTE_A4, NOTE_F4, NOTE_E4,
-  NOTE_D4, NOTE_AS4, NOTE_AS4, NOTE_A4, NOTE_F4, NOTE_G4, NOTE_F4
-};
+#define SONG_COUNT  (sizeof(songList) / sizeof(songList[0]))
 
-int tempo2[] = {
-  8, 8, 4, 4, 4, 2,
-  8, 8, 4, 4, 4, 2,
-  8, 8, 4, 4, 4, 4,
-  4, 8, 8, 4, 4, 4, 2,
-};
+#endif /* SONGS_H_ */
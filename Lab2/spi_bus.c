@@ -0,0 +1,356 @@
+/*
+ * spi_bus.c
+ *
+ *  Transaction queue for the shared USCI_B0 SPI port. See spi_bus.h.
+ *
+ *  Transmit-only transactions are pipelined off UCTXIFG so the shifter
+ *  never idles between bytes. Transactions that also receive run lock-step
+ *  off UCRXIFG so every byte that was clocked in is captured; with DMA
+ *  they are pipelined too, RXBUF being emptied by its own channel two
+ *  cycles after each byte arrives.
+ */
+
+#include "spi_bus.h"
+#ifdef SPI_BUS_USE_DMA
+#include "dma.h"
+#endif
+
+#define NUM_PRIORITIES  2
+
+static SPIBus_Device devices[SPI_BUS_MAX_DEVICES];
+static uint8_t numDevices = 0;
+static uint8_t configuredDevice = SPI_BUS_NO_DEVICE;
+static uint8_t initialized = 0;
+
+// One FIFO per priority, highest priority drained first
+static SPIBus_Xfer *queueHead[NUM_PRIORITIES];
+static SPIBus_Xfer *queueTail[NUM_PRIORITIES];
+
+static SPIBus_Xfer * volatile active = 0;   // transaction owning the bus
+static uint16_t txIndex;                    // next byte to load into TXBUF
+static uint16_t rxIndex;                    // next byte to read from RXBUF
+
+#ifdef SPI_BUS_USE_DMA
+static const uint8_t zeroByte = 0;
+static uint8_t txChannel = DMA_NO_CHANNEL;  // channels from the DMA manager
+static uint8_t rxChannel = DMA_NO_CHANNEL;
+#endif
+
+static void startNext(void);
+
+
+// Chip select helpers, honouring each device's CS polarity
+static void assertCS(const SPIBus_Device *dev)
+{
+    if (dev->csActiveHigh)
+        *dev->csOut |= dev->csPin;
+    else
+        *dev->csOut &= ~dev->csPin;
+}
+
+static void deassertCS(const SPIBus_Device *dev)
+{
+    if (dev->csActiveHigh)
+        *dev->csOut &= ~dev->csPin;
+    else
+        *dev->csOut |= dev->csPin;
+}
+
+// Reprograms clock phase/polarity and bit rate, but only when the device
+// differs from the one the USCI was last set up for
+static void selectDevice(uint8_t device)
+{
+    const SPIBus_Device *dev = &devices[device];
+
+    if (configuredDevice == device)
+        return;
+
+    SPI_BUS_REG_CTL1 |= UCSWRST;
+    SPI_BUS_REG_CTL0 = UCMST | UCSYNC | UCMODE_0 | dev->ctl0;
+    SPI_BUS_REG_BRL  = dev->clkTicks & 0xFF;
+    SPI_BUS_REG_BRH  = (dev->clkTicks >> 8) & 0xFF;
+    SPI_BUS_REG_CTL1 &= ~UCSWRST;       // also clears UCB0IE, sets UCTXIFG
+
+    configuredDevice = device;
+}
+
+// Ends the active transaction: waits for the shifter to drain (at most the
+// last two bytes), releases CS and runs the completion callback
+static void finish(SPIBus_Xfer *xfer)
+{
+    const SPIBus_Device *dev = &devices[xfer->device];
+
+    while (SPI_BUS_REG_STAT & UCBUSY)
+        ;
+
+    __delay_cycles(SPI_BUS_CS_HOLD_CYCLES);
+    deassertCS(dev);
+
+    (void)SPI_BUS_REG_RXBUF;            // drop the last byte and any overrun
+
+    xfer->state = SPI_XFER_DONE;
+
+    // active is still set while the callback runs, so a resubmission from
+    // the callback is queued behind any higher priority work
+    if (xfer->done)
+        xfer->done(xfer);
+
+    active = 0;
+    startNext();
+}
+
+#ifdef SPI_BUS_USE_DMA
+// The TX channel feeds TXBUF. When the transaction also receives, the RX
+// channel empties RXBUF and its completion ends the transaction, since
+// the last byte arrives after the last one is written.
+static void startDMA(SPIBus_Xfer *xfer)
+{
+    uint16_t txDone = xfer->rx ? 0 : DMAIE;
+
+    if (xfer->rx) {
+        (void)SPI_BUS_REG_RXBUF;        // no stale UCRXIFG to trigger on
+        DMA_start(rxChannel, &SPI_BUS_REG_RXBUF, xfer->rx, xfer->len,
+                  DMADT_0 | DMASRCINCR_0 | DMADSTINCR_3 | DMASRCBYTE | DMADSTBYTE | DMAIE);
+    }
+
+    if (xfer->tx)
+        DMA_start(txChannel, xfer->tx, &SPI_BUS_REG_TXBUF, xfer->len,
+                  DMADT_0 | DMASRCINCR_3 | DMADSTINCR_0 | DMASRCBYTE | DMADSTBYTE | txDone);
+    else
+        DMA_start(txChannel, &zeroByte, &SPI_BUS_REG_TXBUF, xfer->len,
+                  DMADT_0 | DMASRCINCR_0 | DMADSTINCR_0 | DMASRCBYTE | DMADSTBYTE | txDone);
+
+    // UCTXIFG is already set, so toggle it to give the DMA its trigger edge
+    SPI_BUS_REG_IFG &= ~UCTXIFG;
+    SPI_BUS_REG_IFG |= UCTXIFG;
+}
+
+// Completion callback of both channels, from the DMA interrupt. Wakes a
+// sleeping main loop once the queue has drained.
+static uint8_t dmaDone(uint8_t channel)
+{
+    if (active)
+        finish(active);
+
+    return (active == 0);
+}
+#endif
+
+// Takes the oldest transaction of the highest waiting priority and starts
+// shifting it out. Called with interrupts disabled.
+static void startNext(void)
+{
+    SPIBus_Xfer *xfer = 0;
+    int8_t prio;
+
+    for (prio = NUM_PRIORITIES - 1; prio >= 0; prio--) {
+        if (queueHead[prio]) {
+            xfer = queueHead[prio];
+            queueHead[prio] = xfer->next;
+            if (queueHead[prio] == 0)
+                queueTail[prio] = 0;
+            break;
+        }
+    }
+
+    if (xfer == 0)
+        return;
+
+    active = xfer;
+    xfer->state = SPI_XFER_ACTIVE;
+    txIndex = 0;
+    rxIndex = 0;
+
+    selectDevice(xfer->device);
+    assertCS(&devices[xfer->device]);
+
+#ifdef SPI_BUS_USE_DMA
+    if ((xfer->len >= SPI_BUS_DMA_MIN_LEN) && (rxChannel != DMA_NO_CHANNEL)) {
+        startDMA(xfer);
+        return;
+    }
+#endif
+
+    if (xfer->rx) {
+        // Lock-step: each received byte releases the next transmit
+        (void)SPI_BUS_REG_RXBUF;
+        SPI_BUS_REG_TXBUF = xfer->tx ? xfer->tx[0] : 0;
+        txIndex = 1;
+        SPI_BUS_REG_IE |= UCRXIE;
+    }
+    else {
+        SPI_BUS_REG_IE |= UCTXIE;
+    }
+}
+
+// Moves the active transaction along by one byte. Runs from the USCI_B0
+// ISR, or from SPIBus_wait when it is called with interrupts disabled.
+static void service(void)
+{
+    SPIBus_Xfer *xfer = active;
+
+    if (xfer == 0)
+        return;
+
+    if ((SPI_BUS_REG_IE & UCRXIE) && (SPI_BUS_REG_IFG & UCRXIFG)) {
+        xfer->rx[rxIndex++] = SPI_BUS_REG_RXBUF;
+
+        if (rxIndex < xfer->len) {
+            SPI_BUS_REG_TXBUF = xfer->tx ? xfer->tx[txIndex] : 0;
+            txIndex++;
+        } else {
+            SPI_BUS_REG_IE &= ~UCRXIE;
+            finish(xfer);
+        }
+    }
+    else if ((SPI_BUS_REG_IE & UCTXIE) && (SPI_BUS_REG_IFG & UCTXIFG)) {
+        SPI_BUS_REG_TXBUF = xfer->tx ? xfer->tx[txIndex] : 0;
+
+        if (++txIndex >= xfer->len) {
+            SPI_BUS_REG_IE &= ~UCTXIE;
+            finish(xfer);
+        }
+    }
+}
+
+
+// Configures UCB0 as an SMCLK-clocked SPI master. Safe to call from every
+// driver that uses the bus; only the first call does anything.
+void SPIBus_init(void)
+{
+    uint8_t i;
+
+    if (initialized)
+        return;
+
+    // Configure SCLK and MOSI for peripheral mode
+    SPI_BUS_PORT_SEL |= (SPI_BUS_PIN_MOSI | SPI_BUS_PIN_SCLK);
+
+    SPI_BUS_REG_CTL1 = UCSWRST | UCSSEL__SMCLK;
+    SPI_BUS_REG_CTL0 = UCMST | UCSYNC | UCMODE_0 | UCMSB | UCCKPH;
+    SPI_BUS_REG_BRL  = 0;
+    SPI_BUS_REG_BRH  = 0;
+    SPI_BUS_REG_CTL1 &= ~UCSWRST;
+    SPI_BUS_REG_IFG  &= ~UCRXIFG;
+
+    for (i = 0; i < NUM_PRIORITIES; i++) {
+        queueHead[i] = 0;
+        queueTail[i] = 0;
+    }
+    active = 0;
+    configuredDevice = SPI_BUS_NO_DEVICE;
+
+#ifdef SPI_BUS_USE_DMA
+    // Highest priority channels, so the shifter is fed ahead of any block
+    // copy. Without both, transactions stay on the USCI interrupt.
+    txChannel = DMA_alloc(SPI_BUS_DMA_TRIGGER, DMA_PRIO_HIGH, dmaDone);
+    rxChannel = DMA_alloc(SPI_BUS_DMA_RX_TRIGGER, DMA_PRIO_HIGH, dmaDone);
+    if ((txChannel == DMA_NO_CHANNEL) || (rxChannel == DMA_NO_CHANNEL)) {
+        if (txChannel != DMA_NO_CHANNEL)
+            DMA_free(txChannel);
+        txChannel = DMA_NO_CHANNEL;
+        rxChannel = DMA_NO_CHANNEL;
+    }
+#endif
+
+    initialized = 1;
+}
+
+// Adds a device to the bus and releases its chip select. The caller
+// configures the CS pin as a GPIO output beforehand.
+// Returns the handle to put in SPIBus_Xfer.device.
+uint8_t SPIBus_registerDevice(const SPIBus_Device *device)
+{
+    uint8_t handle;
+
+    if (numDevices >= SPI_BUS_MAX_DEVICES)
+        return SPI_BUS_NO_DEVICE;
+
+    handle = numDevices++;
+    devices[handle] = *device;
+    deassertCS(&devices[handle]);
+
+    return handle;
+}
+
+// Changes a device's bit rate divider from its next transaction on
+void SPIBus_setClock(uint8_t device, uint16_t clkTicks)
+{
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+
+    devices[device].clkTicks = clkTicks;
+    if (configuredDevice == device)
+        configuredDevice = SPI_BUS_NO_DEVICE;   // reprogrammed when it next starts
+
+    __set_interrupt_state(intState);
+}
+
+// Queues a transaction and returns immediately. The transaction must not
+// already be queued or active. Callable from interrupts.
+void SPIBus_submit(SPIBus_Xfer *xfer)
+{
+    uint8_t prio = (xfer->priority >= NUM_PRIORITIES) ? NUM_PRIORITIES - 1 : xfer->priority;
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+
+    xfer->next = 0;
+    xfer->state = SPI_XFER_QUEUED;
+
+    if (queueTail[prio])
+        queueTail[prio]->next = xfer;
+    else
+        queueHead[prio] = xfer;
+    queueTail[prio] = xfer;
+
+    if (active == 0)
+        startNext();
+
+    __set_interrupt_state(intState);
+}
+
+// Blocks until the transaction has completed. With interrupts disabled
+// (before GIE is set, or inside an ISR) the bus is driven from here.
+void SPIBus_wait(SPIBus_Xfer *xfer)
+{
+    while (SPIBus_isBusy(xfer)) {
+        if (!(__get_SR_register() & GIE)) {
+            service();
+#ifdef SPI_BUS_USE_DMA
+            DMA_service();
+#endif
+        }
+    }
+}
+
+// Queues a transaction and waits for it to complete
+void SPIBus_transfer(SPIBus_Xfer *xfer)
+{
+    SPIBus_submit(xfer);
+    SPIBus_wait(xfer);
+}
+
+uint8_t SPIBus_isBusy(const SPIBus_Xfer *xfer)
+{
+    return (xfer->state == SPI_XFER_QUEUED) || (xfer->state == SPI_XFER_ACTIVE);
+}
+
+uint8_t SPIBus_isIdle(void)
+{
+    return (active == 0);
+}
+
+//------------------------------------------------------------------------------
+// USCI_B0 Interrupt Service Routine
+//------------------------------------------------------------------------------
+#pragma vector=USCI_B0_VECTOR
+__interrupt void USCI_B0_ISR(void)
+{
+    service();
+
+    // Wake a sleeping main loop once the queue has drained
+    if (active == 0)
+        __bic_SR_register_on_exit(LPM3_bits);
+}
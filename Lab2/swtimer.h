@@ -0,0 +1,52 @@
+/*
+ * swtimer.h
+ *
+ *  Software timers on Timer A1 CCR1. Any number of one-shot and periodic
+ *  timers are kept in a list sorted by deadline, and CCR1 is only ever
+ *  programmed for the nearest one. Deadlines are absolute counts of the
+ *  shared time base (timebase.h), so periodic timers do not drift.
+ *
+ *  An expiry sets the timer's expired flag, which a polling main loop picks
+ *  up with SWTimer_expired(), runs the optional callback from the Timer A1
+ *  ISR, and wakes the CPU if it was in a low power mode. Blocking delays
+ *  and getMS() polling become a started timer and a later check.
+ */
+
+#ifndef SWTIMER_H_
+#define SWTIMER_H_
+
+#include <stdint.h>
+#include "timebase.h"
+
+// Timers whose deadline is closer than this are expired immediately
+// instead of risking a compare that TA1R has already passed
+#define SWTIMER_MIN_TICKS   2
+
+typedef struct SWTimer SWTimer;
+
+// Expiry callback. Runs in interrupt context; it may stop or restart any
+// timer, including this one.
+typedef void (*SWTimer_Callback)(SWTimer *timer);
+
+struct SWTimer
+{
+    SWTimer *next;              // list link, owned by the service
+    uint32_t deadline;          // Timebase_ticks() value of the next expiry
+    uint32_t period;            // ticks between expiries, 0 for a one-shot
+    SWTimer_Callback callback;  // optional
+    void *arg;                  // free for the owner's use
+    volatile uint8_t running;
+    volatile uint8_t expired;   // set at every expiry, cleared by SWTimer_expired()
+};
+
+void SWTimer_init(void);
+
+// Delays and periods up to 2^31 ticks (18 hours)
+void SWTimer_start(SWTimer *timer, uint32_t delayTicks, uint32_t periodTicks);
+void SWTimer_startMs(SWTimer *timer, uint32_t delayMs, uint32_t periodMs);
+void SWTimer_stop(SWTimer *timer);
+
+uint8_t SWTimer_isRunning(const SWTimer *timer);
+uint8_t SWTimer_expired(SWTimer *timer);
+
+#endif /* SWTIMER_H_ */
@@ -0,0 +1,127 @@
+/*
+ * calendar.c
+ *
+ *  Leap-year aware date arithmetic. See calendar.h.
+ */
+
+#include "calendar.h"
+
+// Days in each month of a common year
+static const uint8_t monthDays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+// Three letter month names for the display, indexed by month - 1
+static const char monthNames[12][4] = {
+    "JAN", "FEB", "MAR", "APR", "MAY", "JUN",
+    "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"
+};
+
+
+uint8_t Calendar_isLeapYear(uint16_t year)
+{
+    if (year & 3)
+        return 0;
+    if ((year % 100) != 0)
+        return 1;
+    return (year % 400) == 0;
+}
+
+// month is 1-12
+uint8_t Calendar_daysInMonth(uint8_t month, uint16_t year)
+{
+    if ((month == 2) && Calendar_isLeapYear(year))
+        return 29;
+    return monthDays[month - 1];
+}
+
+// Returns "???" for a month outside 1-12
+const char *Calendar_monthName(uint8_t month)
+{
+    if ((month < 1) || (month > 12))
+        return "???";
+    return monthNames[month - 1];
+}
+
+// Breaks a count of seconds since January 1st of epochYear down into a
+// date and time. One 32-bit division splits days from the time of day;
+// the date is then found by walking years and months.
+void Calendar_fromSeconds(uint32_t seconds, uint16_t epochYear, CalendarTime *t)
+{
+    uint32_t days = seconds / SECONDS_PER_DAY;
+    uint32_t timeOfDay = seconds - days * SECONDS_PER_DAY;
+    uint16_t secOfHour;
+    uint16_t year = epochYear;
+    uint8_t month = 1;
+    uint16_t length;
+
+    t->hours = (uint8_t)(timeOfDay / SECONDS_PER_HOUR);
+    secOfHour = (uint16_t)(timeOfDay - t->hours * SECONDS_PER_HOUR);
+    t->minutes = secOfHour / SECONDS_PER_MINUTE;
+    t->seconds = secOfHour - t->minutes * SECONDS_PER_MINUTE;
+
+    for (;;) {
+        length = Calendar_isLeapYear(year) ? 366 : 365;
+        if (days < length)
+            break;
+        days -= length;
+        year++;
+    }
+
+    for (;;) {
+        length = Calendar_daysInMonth(month, year);
+        if (days < length)
+            break;
+        days -= length;
+        month++;
+    }
+
+    t->year = year;
+    t->month = month;
+    t->day = (uint8_t)days + 1;
+}
+
+// Inverse of Calendar_fromSeconds. t->year must not be before epochYear.
+uint32_t Calendar_toSeconds(const CalendarTime *t, uint16_t epochYear)
+{
+    uint32_t days = 0;
+    uint16_t year;
+    uint8_t month;
+
+    for (year = epochYear; year < t->year; year++)
+        days += Calendar_isLeapYear(year) ? 366 : 365;
+    for (month = 1; month < t->month; month++)
+        days += Calendar_daysInMonth(month, t->year);
+    days += t->day - 1;
+
+    return days * SECONDS_PER_DAY + t->hours * SECONDS_PER_HOUR
+           + t->minutes * SECONDS_PER_MINUTE + t->seconds;
+}
+
+// Moves t forward by one second, carrying into the larger fields.
+// Returns the CAL_CHANGED_* bits of every field that changed.
+uint8_t Calendar_advance(CalendarTime *t)
+{
+    if (++t->seconds < 60)
+        return CAL_CHANGED_SECOND;
+    t->seconds = 0;
+
+    if (++t->minutes < 60)
+        return CAL_CHANGED_SECOND | CAL_CHANGED_MINUTE;
+    t->minutes = 0;
+
+    if (++t->hours < 24)
+        return CAL_CHANGED_SECOND | CAL_CHANGED_MINUTE | CAL_CHANGED_HOUR;
+    t->hours = 0;
+
+    if (++t->day <= Calendar_daysInMonth(t->month, t->year))
+        return CAL_CHANGED_SECOND | CAL_CHANGED_MINUTE | CAL_CHANGED_HOUR | CAL_CHANGED_DAY;
+    t->day = 1;
+
+    if (++t->month <= 12)
+        return CAL_CHANGED_SECOND | CAL_CHANGED_MINUTE | CAL_CHANGED_HOUR | CAL_CHANGED_DAY
+               | CAL_CHANGED_MONTH;
+    t->month = 1;
+    t->year++;
+
+    return CAL_CHANGED_SECOND | CAL_CHANGED_MINUTE | CAL_CHANGED_HOUR | CAL_CHANGED_DAY
+           | CAL_CHANGED_MONTH | CAL_CHANGED_YEAR;
+}
@@ -0,0 +1,49 @@
+/*
+ * calendar.h
+ *
+ *  Integer calendar arithmetic for the clock. A CalendarTime is converted
+ *  to and from a count of seconds since 00:00:00 on January 1st of an epoch
+ *  year, and the displayed time is kept as a CalendarTime that the 1 Hz
+ *  tick advances in place with Calendar_advance(), so the common path is a
+ *  few increments and compares instead of 32-bit divisions.
+ *
+ *  Leap years follow the Gregorian rule.
+ */
+
+#ifndef CALENDAR_H_
+#define CALENDAR_H_
+
+#include <stdint.h>
+
+#define SECONDS_PER_MINUTE  60
+#define SECONDS_PER_HOUR    3600UL
+#define SECONDS_PER_DAY     86400UL
+
+// Calendar_advance() return bits: which fields rolled over
+#define CAL_CHANGED_SECOND  0x01
+#define CAL_CHANGED_MINUTE  0x02
+#define CAL_CHANGED_HOUR    0x04
+#define CAL_CHANGED_DAY     0x08
+#define CAL_CHANGED_MONTH   0x10
+#define CAL_CHANGED_YEAR    0x20
+
+typedef struct CalendarTime
+{
+    uint16_t year;
+    uint8_t month;      // 1-12
+    uint8_t day;        // 1-31
+    uint8_t hours;      // 0-23
+    uint8_t minutes;    // 0-59
+    uint8_t seconds;    // 0-59
+} CalendarTime;
+
+uint8_t Calendar_isLeapYear(uint16_t year);
+uint8_t Calendar_daysInMonth(uint8_t month, uint16_t year);
+const char *Calendar_monthName(uint8_t month);
+
+void Calendar_fromSeconds(uint32_t seconds, uint16_t epochYear, CalendarTime *t);
+uint32_t Calendar_toSeconds(const CalendarTime *t, uint16_t epochYear);
+
+uint8_t Calendar_advance(CalendarTime *t);
+
+#endif /* CALENDAR_H_ */
@@ -0,0 +1,181 @@
+/*
+ * event_loop.c
+ *
+ *  Event posting, low power sleep and per-state CPU accounting. See event_loop.h.
+ */
+
+#include "event_loop.h"
+#include "peripherals.h"
+#include "spi_bus.h"
+
+static volatile uint16_t pending = 0;          // posted and not yet collected
+static uint8_t smclkUsers = 0;
+
+static EventLoop_Stats stats[EVENT_LOOP_MAX_STATES];
+static uint8_t currentState = 0;
+static uint32_t lastStamp;                      // Timebase_ticks() at the last accounting
+
+static SWTimer keypadTimer;
+static volatile unsigned char lastKey = 0;      // key seen by the previous scan
+static volatile unsigned char newKey = 0;       // pressed key not yet taken
+
+
+// Charges the ticks since the last stamp to the current state as active time
+static uint32_t chargeActive(void)
+{
+    uint32_t now = Timebase_ticks();
+
+    stats[currentState].activeTicks += now - lastStamp;
+    lastStamp = now;
+    return now;
+}
+
+// Keypad scan, runs from the Timer A1 ISR. Only the transition to a new
+// key is posted, so holding a key gives one event.
+static void keypadScan(SWTimer *timer)
+{
+    unsigned char key = getKey();
+
+    if (key && (key != lastKey)) {
+        newKey = key;
+        pending |= EVENT_KEY;
+    }
+    lastKey = key;
+}
+
+// Starts the time base and the software timers the loop sleeps on
+void EventLoop_init(void)
+{
+    SWTimer_init();
+
+    pending = 0;
+    smclkUsers = 0;
+    EventLoop_resetStats();
+}
+
+// Marks events as pending. Callable from interrupts, but only
+// EVENT_LOOP_POST_FROM_ISR() also wakes the CPU; software timer callbacks
+// need neither, the Timer A1 ISR wakes it after every expiry.
+void EventLoop_post(uint16_t events)
+{
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+    pending |= events;
+    __set_interrupt_state(intState);
+}
+
+// Returns the pending events and clears them. If there are none, the CPU
+// first sleeps until an interrupt wakes it, so the result can be 0 after a
+// wake-up that posted nothing (e.g. an RTC second when the caller polls
+// RTCClock_takeEvents()).
+uint16_t EventLoop_wait(void)
+{
+    uint16_t events;
+    uint16_t lpmBits;
+    uint32_t sleepStart;
+
+    __disable_interrupt();
+
+    if (pending == 0) {
+        sleepStart = chargeActive();
+
+        // SMCLK has to keep running for queued SPI transactions and for
+        // drivers that hold it. Work submitted from an ISR while asleep is
+        // covered by the UCS clock request from the USCI.
+        if (smclkUsers || !SPIBus_isIdle())
+            lpmBits = LPM0_bits;
+        else
+            lpmBits = LPM3_bits;
+
+        // Sets GIE and the LPM bits in one instruction, so an interrupt
+        // that posts between the check above and the sleep still wakes us
+        __bis_SR_register(lpmBits | GIE);
+        __no_operation();
+
+        __disable_interrupt();
+        lastStamp = Timebase_ticks();
+        stats[currentState].sleepTicks += lastStamp - sleepStart;
+        stats[currentState].wakeups++;
+    }
+
+    events = pending;
+    pending = 0;
+
+    __enable_interrupt();
+
+    return events;
+}
+
+// Keeps the loop out of LPM3 while a driver needs SMCLK (e.g. Timer B on SMCLK)
+void EventLoop_requireSMCLK(void)
+{
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+    smclkUsers++;
+    __set_interrupt_state(intState);
+}
+
+void EventLoop_releaseSMCLK(void)
+{
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+    if (smclkUsers)
+        smclkUsers--;
+    __set_interrupt_state(intState);
+}
+
+// Charges the time so far to the old state and starts counting for the new one
+void EventLoop_setState(uint8_t state)
+{
+    if (state >= EVENT_LOOP_MAX_STATES)
+        state = EVENT_LOOP_MAX_STATES - 1;
+
+    if (state == currentState)
+        return;
+
+    chargeActive();
+    currentState = state;
+}
+
+const EventLoop_Stats *EventLoop_getStats(uint8_t state)
+{
+    if (state >= EVENT_LOOP_MAX_STATES)
+        return 0;
+
+    chargeActive();
+    return &stats[state];
+}
+
+void EventLoop_resetStats(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < EVENT_LOOP_MAX_STATES; i++) {
+        stats[i].activeTicks = 0;
+        stats[i].sleepTicks = 0;
+        stats[i].wakeups = 0;
+    }
+    lastStamp = Timebase_ticks();
+}
+
+// Scans the keypad every periodMs from a software timer and posts EVENT_KEY
+// for each new key press, so the main loop no longer polls getKey()
+void EventLoop_startKeypadScan(uint16_t periodMs)
+{
+    lastKey = 0;
+    newKey = 0;
+    keypadTimer.callback = keypadScan;
+    SWTimer_startMs(&keypadTimer, periodMs, periodMs);
+}
+
+// The key behind the last EVENT_KEY, or 0 once it has been taken
+unsigned char EventLoop_takeKey(void)
+{
+    unsigned char key = newKey;
+
+    newKey = 0;
+    return key;
+}
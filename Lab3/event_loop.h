@@ -0,0 +1,63 @@
+/*
+ * event_loop.h
+ *
+ *  Run loop that sleeps between events. Interrupt handlers post event bits
+ *  and leave low power mode on return; the main loop collects them with
+ *  EventLoop_wait(), which puts the CPU in the deepest low power mode the
+ *  running peripherals allow whenever nothing is pending:
+ *
+ *  LPM0    while SMCLK is needed: a transaction is on the SPI bus, or a
+ *          driver holds EventLoop_requireSMCLK() (e.g. a buzzer on TB0)
+ *  LPM3    otherwise. ACLK keeps the time base, software timers, RTC and
+ *          ADC trigger running.
+ *
+ *  For every application state set with EventLoop_setState(), the loop
+ *  counts time spent active and asleep (in time base ticks) and the number
+ *  of wake-ups, so the CPU load of each state can be read in the debugger
+ *  or reported.
+ */
+
+#ifndef EVENT_LOOP_H_
+#define EVENT_LOOP_H_
+
+#include <msp430.h>
+#include <stdint.h>
+#include "swtimer.h"
+
+// Event bits
+#define EVENT_TICK          0x0001      // periodic application tick
+#define EVENT_KEY           0x0002      // keypad key pressed, see EventLoop_takeKey()
+#define EVENT_BUTTON        0x0004      // launchpad button edge
+#define EVENT_TIMER         0x0008      // software timer expired
+#define EVENT_ADC           0x0010      // ADC block ready
+#define EVENT_SPI           0x0020      // SPI transaction completed
+#define EVENT_USER          0x0100      // first bit free for the application
+
+#define EVENT_LOOP_MAX_STATES   8
+
+// Posts events from an ISR and wakes the main loop when the ISR returns
+#define EVENT_LOOP_POST_FROM_ISR(events)    do { EventLoop_post(events);                \
+                                                 __bic_SR_register_on_exit(LPM4_bits); } while (0)
+
+typedef struct EventLoop_Stats
+{
+    uint32_t activeTicks;       // time base ticks spent running
+    uint32_t sleepTicks;        // time base ticks spent in LPM0 or LPM3
+    uint32_t wakeups;
+} EventLoop_Stats;
+
+void EventLoop_init(void);
+void EventLoop_post(uint16_t events);
+uint16_t EventLoop_wait(void);
+
+void EventLoop_requireSMCLK(void);
+void EventLoop_releaseSMCLK(void);
+
+void EventLoop_setState(uint8_t state);
+const EventLoop_Stats *EventLoop_getStats(uint8_t state);
+void EventLoop_resetStats(void);
+
+void EventLoop_startKeypadScan(uint16_t periodMs);
+unsigned char EventLoop_takeKey(void);
+
+#endif /* EVENT_LOOP_H_ */
@@ -0,0 +1,136 @@
+/*
+ * filters.c
+ *
+ *  Constant-time streaming filters. See filters.h.
+ */
+
+#include "filters.h"
+
+// Orders a pair of samples in place, smaller first
+#define SORT_PAIR(a, b)     { if ((a) > (b)) { int16_t t = (a); (a) = (b); (b) = t; } }
+
+
+// window is clamped to 1..FILTER_MAX_WINDOW
+void MovingAvg_init(MovingAvg *f, uint8_t window)
+{
+    uint8_t shift;
+
+    if (window == 0)
+        window = 1;
+    if (window > FILTER_MAX_WINDOW)
+        window = FILTER_MAX_WINDOW;
+
+    f->window = window;
+    f->shift = FILTER_NO_SHIFT;
+    for (shift = 0; shift < 8; shift++) {
+        if ((1 << shift) == window) {
+            f->shift = shift;
+            break;
+        }
+    }
+
+    MovingAvg_reset(f);
+}
+
+// Forgets every sample; the next average covers only new samples
+void MovingAvg_reset(MovingAvg *f)
+{
+    f->sum = 0;
+    f->index = 0;
+    f->count = 0;
+    f->value = 0;
+}
+
+// Replaces the oldest sample and returns the average of the samples held.
+// Until the window has filled, that is the average of the samples so far.
+int16_t MovingAvg_update(MovingAvg *f, int16_t sample)
+{
+    if (f->count == f->window)
+        f->sum -= f->samples[f->index];
+    else
+        f->count++;
+
+    f->samples[f->index] = sample;
+    f->sum += sample;
+    if (++f->index >= f->window)
+        f->index = 0;
+
+    if (f->count < f->window)
+        f->value = (int16_t)(f->sum / f->count);
+    else if (f->shift != FILTER_NO_SHIFT)
+        f->value = (int16_t)(f->sum >> f->shift);
+    else
+        f->value = (int16_t)(f->sum / f->window);
+
+    return f->value;
+}
+
+// alpha = 1 / 2^shift: 2 follows quickly, 4-5 suits a noisy input
+void EMA_init(EMAFilter *f, uint8_t shift)
+{
+    f->shift = shift;
+    f->state = 0;
+    f->primed = 0;
+    f->value = 0;
+}
+
+int16_t EMA_update(EMAFilter *f, int16_t sample)
+{
+    if (!f->primed) {
+        // Start at the first sample instead of ramping up from zero
+        f->state = (int32_t)sample << f->shift;
+        f->primed = 1;
+    } else {
+        f->state += sample - (f->state >> f->shift);
+    }
+
+    f->value = (int16_t)(f->state >> f->shift);
+    return f->value;
+}
+
+// size is 5 or 7; anything else is treated as 5
+void Median_init(MedianFilter *f, uint8_t size)
+{
+    f->size = (size == 7) ? 7 : 5;
+    f->index = 0;
+    f->primed = 0;
+    f->value = 0;
+}
+
+// Adds a sample and returns the median of the last 5 or 7. The history is
+// copied and partially sorted with a fixed compare-exchange network (7 or 13
+// exchanges), so the cost does not depend on the data.
+int16_t Median_update(MedianFilter *f, int16_t sample)
+{
+    int16_t p[7];
+    uint8_t i;
+
+    if (!f->primed) {
+        for (i = 0; i < f->size; i++)
+            f->samples[i] = sample;
+        f->primed = 1;
+    }
+
+    f->samples[f->index] = sample;
+    if (++f->index >= f->size)
+        f->index = 0;
+
+    for (i = 0; i < f->size; i++)
+        p[i] = f->samples[i];
+
+    if (f->size == 5) {
+        SORT_PAIR(p[0], p[1]); SORT_PAIR(p[3], p[4]); SORT_PAIR(p[0], p[3]);
+        SORT_PAIR(p[1], p[4]); SORT_PAIR(p[1], p[2]); SORT_PAIR(p[2], p[3]);
+        SORT_PAIR(p[1], p[2]);
+        f->value = p[2];
+    } else {
+        SORT_PAIR(p[0], p[5]); SORT_PAIR(p[0], p[3]); SORT_PAIR(p[1], p[6]);
+        SORT_PAIR(p[2], p[4]); SORT_PAIR(p[0], p[1]); SORT_PAIR(p[3], p[5]);
+        SORT_PAIR(p[2], p[6]); SORT_PAIR(p[2], p[3]); SORT_PAIR(p[3], p[6]);
+        SORT_PAIR(p[4], p[5]); SORT_PAIR(p[1], p[4]); SORT_PAIR(p[1], p[3]);
+        SORT_PAIR(p[3], p[4]);
+        f->value = p[3];
+    }
+
+    return f->value;
+}
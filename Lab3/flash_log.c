@@ -0,0 +1,442 @@
+/*
+ * flash_log.c
+ *
+ *  Delta/varint sample log in a ring of flash segments. See flash_log.h.
+ */
+
+#include "flash_log.h"
+#include "crc16.h"
+
+#ifndef HOST_BUILD
+#include <msp430.h>
+#endif
+
+#define HEADER_LEN      12
+#define TRAILER_LEN     4
+#define RECORDS_END     (FLASH_LOG_SEGMENT_SIZE - TRAILER_LEN)
+#define MAX_RECORD_LEN  (1 + 3 * FLASH_LOG_MAX_VALUES)  // a 16-bit delta takes at most 3 varint bytes
+
+#define MAGIC1          'L'
+#define MAGIC2          'G'
+#define ERASED          0xFF
+
+// Gaps longer than this with an unchanged value start a new block instead
+// of a run of filler records
+#define MAX_FILL_DT     (FLASH_LOG_MAX_DT * 8)
+
+typedef struct Block
+{
+    uint8_t segment;
+    uint32_t seq;
+    uint32_t startTime;
+    uint16_t used;              // record bytes
+} Block;
+
+#ifdef HOST_BUILD
+static uint8_t flash[FLASH_LOG_SEGMENTS * FLASH_LOG_SEGMENT_SIZE];
+#define SEGMENT(n)      (&flash[(uint16_t)(n) * FLASH_LOG_SEGMENT_SIZE])
+#else
+#define SEGMENT(n)      ((uint8_t *)FLASH_LOG_START + (uint16_t)(n) * FLASH_LOG_SEGMENT_SIZE)
+#endif
+
+static uint8_t numValues;
+static uint8_t blockOpen;               // a block is being written
+static uint8_t segment;                 // segment being written, or the next one
+static uint16_t writePos;               // offset of the next record in it
+static uint32_t nextSeq;
+static uint32_t lastTime;               // time and values of the last record
+static int16_t lastValues[FLASH_LOG_MAX_VALUES];
+
+
+//------------------------------------------------------------------------------
+// Flash controller
+//------------------------------------------------------------------------------
+
+static void flashErase(uint8_t n)
+{
+#ifdef HOST_BUILD
+    uint16_t i;
+
+    for (i = 0; i < FLASH_LOG_SEGMENT_SIZE; i++)
+        SEGMENT(n)[i] = ERASED;
+#else
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+
+    FCTL3 = FWKEY;                      // unlock
+    FCTL1 = FWKEY | ERASE;
+    *(volatile uint8_t *)SEGMENT(n) = 0;    // dummy write starts the erase
+    while (FCTL3 & BUSY)
+        ;
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY | LOCK;
+
+    __set_interrupt_state(intState);
+#endif
+}
+
+static void flashWrite(uint8_t *dst, const uint8_t *src, uint16_t len)
+{
+#ifdef HOST_BUILD
+    while (len--)
+        *dst++ &= *src++;               // programming only clears bits
+#else
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+
+    FCTL3 = FWKEY;
+    FCTL1 = FWKEY | WRT;
+    while (len--) {
+        *(volatile uint8_t *)dst++ = *src++;
+        while (FCTL3 & BUSY)
+            ;
+    }
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY | LOCK;
+
+    __set_interrupt_state(intState);
+#endif
+}
+
+static uint8_t isErased(uint8_t n)
+{
+    const uint8_t *p = SEGMENT(n);
+    uint16_t i;
+
+    for (i = 0; i < FLASH_LOG_SEGMENT_SIZE; i++)
+        if (p[i] != ERASED)
+            return 0;
+    return 1;
+}
+
+static void eraseIfUsed(uint8_t n)
+{
+    if (!isErased(n))
+        flashErase(n);
+}
+
+
+//------------------------------------------------------------------------------
+// Encoding
+//------------------------------------------------------------------------------
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | ((uint16_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+// Zigzag maps small deltas of either sign to small numbers, then seven
+// bits per byte, low first, with the top bit set on all but the last
+static uint8_t putDelta(uint8_t *p, int32_t delta)
+{
+    uint32_t z = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    uint8_t n = 0;
+
+    while (z >= 0x80) {
+        p[n++] = (z & 0x7F) | 0x80;
+        z >>= 7;
+    }
+    p[n++] = z;
+    return n;
+}
+
+// Decodes one record at p, at most end - p bytes. Returns its length, or
+// 0 at erased flash or a record that runs past the end (a write cut short)
+static uint8_t getRecord(const uint8_t *p, const uint8_t *end, uint8_t *dt, int16_t *values)
+{
+    const uint8_t *start = p;
+    uint8_t v, shift;
+    uint32_t z;
+
+    if ((p >= end) || (*p == ERASED))
+        return 0;
+    *dt = *p++;
+
+    for (v = 0; v < numValues; v++) {
+        z = 0;
+        shift = 0;
+        do {
+            if ((p >= end) || (shift > 14))
+                return 0;
+            z |= (uint32_t)(*p & 0x7F) << shift;
+            shift += 7;
+        } while (*p++ & 0x80);
+
+        values[v] += (int16_t)((z >> 1) ^ (0 - (z & 1)));
+    }
+    return p - start;
+}
+
+
+//------------------------------------------------------------------------------
+// Blocks
+//------------------------------------------------------------------------------
+
+// Reads a segment's header and works out how many record bytes it holds.
+// Returns 0 if the segment is not a valid block of this log.
+static uint8_t readBlock(uint8_t n, Block *b)
+{
+    const uint8_t *p = SEGMENT(n);
+    uint16_t used, crc;
+
+    if ((p[0] != MAGIC1) || (p[1] != MAGIC2) || (p[2] != numValues))
+        return 0;
+
+    b->segment = n;
+    b->seq = get32(&p[4]);
+    b->startTime = get32(&p[8]);
+
+    used = p[RECORDS_END] | (p[RECORDS_END + 1] << 8);
+    if (used != 0xFFFF) {
+        // Sealed: the CRC covers header and records
+        crc = (p[RECORDS_END + 2] << 8) | p[RECORDS_END + 3];
+        if ((used > RECORDS_END - HEADER_LEN) || (CRC16_compute(p, HEADER_LEN + used) != crc))
+            return 0;
+        b->used = used;
+    } else {
+        // Still open, or left open by a reset: records run up to erased flash
+        int16_t values[FLASH_LOG_MAX_VALUES] = {0};
+        const uint8_t *r = p + HEADER_LEN;
+        uint8_t dt, len;
+
+        while ((len = getRecord(r, p + RECORDS_END, &dt, values)) != 0)
+            r += len;
+        b->used = r - (p + HEADER_LEN);
+    }
+    return 1;
+}
+
+// Writes the trailer of the block in segment n
+static void sealBlock(uint8_t n, uint16_t used)
+{
+    uint8_t trailer[TRAILER_LEN];
+    uint16_t crc = CRC16_compute(SEGMENT(n), HEADER_LEN + used);
+
+    trailer[0] = used & 0xFF;
+    trailer[1] = used >> 8;
+    trailer[2] = crc >> 8;
+    trailer[3] = crc & 0xFF;
+    flashWrite(SEGMENT(n) + RECORDS_END, trailer, TRAILER_LEN);
+}
+
+static void closeBlock(void)
+{
+    if (!blockOpen)
+        return;
+
+    sealBlock(segment, writePos - HEADER_LEN);
+    blockOpen = 0;
+    segment = (segment + 1) % FLASH_LOG_SEGMENTS;
+}
+
+// Starts a block in the current segment and erases the one after it
+static void openBlock(uint32_t time)
+{
+    uint8_t header[HEADER_LEN];
+    uint8_t v;
+
+    eraseIfUsed(segment);               // normally erased ahead already
+
+    header[0] = MAGIC1;
+    header[1] = MAGIC2;
+    header[2] = numValues;
+    header[3] = ERASED;
+    put32(&header[4], nextSeq++);
+    put32(&header[8], time);
+    flashWrite(SEGMENT(segment), header, HEADER_LEN);
+
+    eraseIfUsed((segment + 1) % FLASH_LOG_SEGMENTS);
+
+    blockOpen = 1;
+    writePos = HEADER_LEN;
+    lastTime = time;
+    for (v = 0; v < numValues; v++)
+        lastValues[v] = 0;
+}
+
+static void writeRecord(uint8_t dt, const int16_t *values)
+{
+    uint8_t record[MAX_RECORD_LEN];
+    uint8_t len = 0, v;
+
+    record[len++] = dt;
+    for (v = 0; v < numValues; v++)
+        len += putDelta(&record[len], (int32_t)values[v] - lastValues[v]);
+
+    flashWrite(SEGMENT(segment) + writePos, record, len);
+    writePos += len;
+
+    lastTime += dt;
+    for (v = 0; v < numValues; v++)
+        lastValues[v] = values[v];
+}
+
+
+// Finds the newest block and seals it if a reset left it open. The next
+// sample starts a new block after it. A log written with a different
+// number of values is erased.
+void FlashLog_init(uint8_t values)
+{
+    Block b, newest;
+    uint8_t n, found = 0, foreign = 0;
+
+    numValues = (values > FLASH_LOG_MAX_VALUES) ? FLASH_LOG_MAX_VALUES : values;
+    blockOpen = 0;
+    segment = 0;
+    nextSeq = 0;
+
+    for (n = 0; n < FLASH_LOG_SEGMENTS; n++) {
+        const uint8_t *p = SEGMENT(n);
+
+        if (readBlock(n, &b)) {
+            if (!found || (b.seq > newest.seq))
+                newest = b;
+            found = 1;
+        } else if ((p[0] == MAGIC1) && (p[1] == MAGIC2) && (p[2] != numValues)) {
+            foreign = 1;
+        }
+    }
+
+    if (foreign) {
+        FlashLog_erase();
+        return;
+    }
+
+    if (found) {
+        const uint8_t *p = SEGMENT(newest.segment);
+
+        if ((p[RECORDS_END] == ERASED) && (p[RECORDS_END + 1] == ERASED))
+            sealBlock(newest.segment, newest.used);
+        segment = (newest.segment + 1) % FLASH_LOG_SEGMENTS;
+        nextSeq = newest.seq + 1;
+    }
+}
+
+// Adds a sample. Writes nothing while the values stay the same, up to
+// FLASH_LOG_MAX_DT seconds. A time going backwards, a long gap or a full
+// block starts a new block.
+void FlashLog_append(uint32_t time, const int16_t *values)
+{
+    uint32_t dt;
+    uint8_t v, changed = 0;
+
+    if (numValues == 0)
+        return;
+
+    if (blockOpen && ((time < lastTime) || (time - lastTime > MAX_FILL_DT)))
+        closeBlock();
+
+    if (!blockOpen) {
+        openBlock(time);
+        writeRecord(0, values);
+        return;
+    }
+
+    for (v = 0; v < numValues; v++)
+        if (values[v] != lastValues[v])
+            changed = 1;
+
+    dt = time - lastTime;
+    if (!changed && (dt < FLASH_LOG_MAX_DT))
+        return;
+
+    // Bridge a long steady stretch with records that change nothing
+    while (dt > FLASH_LOG_MAX_DT) {
+        if (writePos + MAX_RECORD_LEN > RECORDS_END)
+            break;
+        writeRecord(FLASH_LOG_MAX_DT, lastValues);
+        dt -= FLASH_LOG_MAX_DT;
+    }
+
+    if ((dt > FLASH_LOG_MAX_DT) || (writePos + MAX_RECORD_LEN > RECORDS_END)) {
+        closeBlock();
+        openBlock(time);
+        dt = 0;
+    }
+    writeRecord(dt, values);
+}
+
+// Passes every logged sample with from <= time <= to to reader, oldest
+// block first, and returns how many there were. Blocks are picked by their
+// headers alone, so only the blocks that cover the range are decoded.
+// Only the order and lengths are kept, not whole Blocks, to keep the
+// stack small for readers that print.
+uint16_t FlashLog_read(uint32_t from, uint32_t to, FlashLog_Reader reader)
+{
+    uint8_t order[FLASH_LOG_SEGMENTS];  // valid blocks' segments by sequence number
+    uint16_t used[FLASH_LOG_SEGMENTS];  // their record bytes, by segment
+    int16_t values[FLASH_LOG_MAX_VALUES];
+    uint8_t count = 0, i, j;
+    uint16_t samples = 0;
+
+    for (i = 0; i < FLASH_LOG_SEGMENTS; i++) {
+        Block b;
+
+        if (!readBlock(i, &b))
+            continue;
+        used[i] = b.used;
+
+        // Insertion sort by sequence number
+        for (j = count; (j > 0) && (get32(SEGMENT(order[j - 1]) + 4) > b.seq); j--)
+            order[j] = order[j - 1];
+        order[j] = i;
+        count++;
+    }
+
+    for (i = 0; i < count; i++) {
+        const uint8_t *start = SEGMENT(order[i]);
+        const uint8_t *r = start + HEADER_LEN;
+        const uint8_t *end = r + used[order[i]];
+        uint32_t time = get32(start + 8);
+        uint32_t nextStart;
+        uint8_t dt, len, v;
+
+        if (time > to)
+            continue;
+
+        // The next block takes over before the range starts
+        if (i + 1 < count) {
+            nextStart = get32(SEGMENT(order[i + 1]) + 8);
+            if ((nextStart >= time) && (nextStart <= from))
+                continue;
+        }
+
+        for (v = 0; v < numValues; v++)
+            values[v] = 0;
+
+        while ((len = getRecord(r, end, &dt, values)) != 0) {
+            r += len;
+            time += dt;
+            if (time > to)
+                break;
+            if (time >= from) {
+                reader(time, values, numValues);
+                samples++;
+            }
+        }
+    }
+    return samples;
+}
+
+// Erases the whole log
+void FlashLog_erase(void)
+{
+    uint8_t n;
+
+    for (n = 0; n < FLASH_LOG_SEGMENTS; n++)
+        eraseIfUsed(n);
+
+    blockOpen = 0;
+    segment = 0;
+    nextSeq = 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * flash_log.h
+ *
+ *  Sample history kept in a ring of main flash segments (the DATALOG
+ *  region of lnk_msp430f5529.cmd, taken out of FLASH), so it survives
+ *  resets and power cycles. Each sample is a time in seconds and up to
+ *  FLASH_LOG_MAX_VALUES signed 16-bit values.
+ *
+ *  Every 512-byte segment is one block:
+ *
+ *      header   'L' 'G' | numValues | 0xFF | seq (4) | startTime (4)
+ *      records  dt | numValues zigzag varint deltas, ...
+ *      trailer  used (2) | CRC high | CRC low      (last 4 bytes)
+ *
+ *  dt is the seconds since the previous record (0-254, 0xFF marks erased
+ *  flash), the deltas are from the previous record's values. The first
+ *  record of a block starts from startTime and zero, so every block
+ *  decodes on its own. A sample whose values equal the last record's is
+ *  not written; its time is folded into the next record, so a steady
+ *  reading costs nothing until it changes or 254 seconds pass. A slowly
+ *  moving one-second reading takes about two bytes per change.
+ *
+ *  The trailer is written when the block is sealed, full or at the next
+ *  FlashLog_init(): used is the record bytes, the CRC is CRC-16/CCITT
+ *  (crc16.h) over header and records. seq orders the blocks, so times may
+ *  start over after a reset. The segment after the one being written is
+ *  kept erased, which costs one block of history but keeps the 25 ms
+ *  segment erase out of the path of a full block's next sample.
+ *
+ *  Writes and erases hold the CPU and interrupts while the flash
+ *  controller works: about 64 us a byte and 25 ms a segment.
+ *
+ *  HOST_BUILD keeps the ring in a RAM array with the same erase and write
+ *  rules, for trying the encoding on a PC.
+ */
+
+#ifndef FLASH_LOG_H_
+#define FLASH_LOG_H_
+
+#include <stdint.h>
+
+#define FLASH_LOG_START         0x4400  // DATALOG in lnk_msp430f5529.cmd
+#define FLASH_LOG_SEGMENTS      16
+#define FLASH_LOG_SEGMENT_SIZE  512
+
+#define FLASH_LOG_MAX_VALUES    4
+
+// Largest gap between records inside a block, in seconds
+#define FLASH_LOG_MAX_DT        254
+
+// Called by FlashLog_read for each sample in the range, oldest first
+typedef void (*FlashLog_Reader)(uint32_t time, const int16_t *values, uint8_t numValues);
+
+void FlashLog_init(uint8_t numValues);
+void FlashLog_append(uint32_t time, const int16_t *values);
+uint16_t FlashLog_read(uint32_t from, uint32_t to, FlashLog_Reader reader);
+void FlashLog_erase(void);
+
+#endif /* FLASH_LOG_H_ */
@@ -0,0 +1,122 @@
+/*
+ * hsm.h
+ *
+ *  Small hierarchical state machine framework. An application is a tree of
+ *  states, each with optional entry and exit actions and an event handler.
+ *  Events are queued by HSM_post() (from the main loop or from interrupts)
+ *  and dispatched one at a time with HSM_dispatchAll(): the innermost
+ *  active state sees the event first and passes what it does not handle to
+ *  its parent. Work therefore only happens when an event arrives, and code
+ *  shared by several states lives once in their common parent.
+ *
+ *  A handler changes state with HSM_transition(). After the handler
+ *  returns, the states being left run their exit actions innermost first,
+ *  the states being entered run their entry actions outermost first, and
+ *  the target's initial children are entered. Transitioning to the current
+ *  state (or one of its parents) leaves and re-enters it.
+ *
+ *  A handler can return HSM_DEFERRED to set an event aside until the app
+ *  calls HSM_recall(), typically from the entry action of a state that can
+ *  handle it. Timer events come from HSM_Timer, a software timer (swtimer.h)
+ *  that posts a signal when it expires.
+ *
+ *  Every event is stamped with the time base when posted, so the machine
+ *  keeps the worst and total delay from post to dispatch, and the longest
+ *  time spent handling one event (HSM_getStats()).
+ */
+
+#ifndef HSM_H_
+#define HSM_H_
+
+#include <msp430.h>
+#include <stdint.h>
+#include "swtimer.h"
+
+#define HSM_QUEUE_LEN       8           // events waiting for dispatch
+#define HSM_DEFER_LEN       4           // events set aside by HSM_DEFERRED
+#define HSM_MAX_DEPTH       4           // deepest nesting of states
+
+// Handler results
+#define HSM_HANDLED         0           // consumed
+#define HSM_SUPER           1           // not handled here, pass to the parent
+#define HSM_DEFERRED        2           // keep until HSM_recall()
+
+// First signal number free for the application
+#define HSM_SIG_USER        1
+
+typedef struct HSM HSM;
+typedef struct HSM_State HSM_State;
+
+typedef struct HSM_Event
+{
+    uint8_t sig;                // application signal, HSM_SIG_USER or above
+    uint8_t param;              // e.g. the key that was pressed
+    uint32_t stamp;             // Timebase_ticks() when posted
+} HSM_Event;
+
+typedef void (*HSM_Action)(HSM *me);
+typedef uint8_t (*HSM_Handler)(HSM *me, const HSM_Event *e);
+
+// Called from HSM_post() with interrupts disabled, e.g. to tell a run loop
+// that the queue is no longer empty
+typedef void (*HSM_Notify)(void);
+
+struct HSM_State
+{
+    const HSM_State *parent;    // 0 for a top-level state
+    const HSM_State *initial;   // child entered along with this state, or 0
+    HSM_Action entry;           // optional
+    HSM_Action exit;            // optional
+    HSM_Handler handler;        // optional, 0 passes every event to the parent
+};
+
+typedef struct HSM_Stats
+{
+    uint32_t dispatched;
+    uint32_t totalLatencyTicks; // sum of post-to-dispatch delays
+    uint32_t maxLatencyTicks;
+    uint32_t maxRunTicks;       // longest handler plus transition
+    uint16_t dropped;           // posts lost to a full queue
+} HSM_Stats;
+
+struct HSM
+{
+    const HSM_State *current;   // innermost active state
+    const HSM_State *target;    // transition requested by the running handler
+    HSM_Notify notify;
+
+    HSM_Event queue[HSM_QUEUE_LEN];
+    volatile uint8_t head;
+    volatile uint8_t count;
+
+    HSM_Event deferred[HSM_DEFER_LEN];
+    uint8_t deferredCount;
+
+    HSM_Stats stats;
+};
+
+// Posts a signal when a software timer expires
+typedef struct HSM_Timer
+{
+    SWTimer timer;
+    HSM *owner;
+    uint8_t sig;
+} HSM_Timer;
+
+void HSM_init(HSM *me, const HSM_State *initial, HSM_Notify notify);
+uint8_t HSM_post(HSM *me, uint8_t sig, uint8_t param);
+uint8_t HSM_dispatchAll(HSM *me);
+void HSM_sleep(HSM *me);
+
+void HSM_transition(HSM *me, const HSM_State *target);
+uint8_t HSM_isIn(const HSM *me, const HSM_State *state);
+void HSM_recall(HSM *me);
+
+void HSM_armTimer(HSM_Timer *t, HSM *me, uint8_t sig, uint32_t delayMs, uint32_t periodMs);
+void HSM_armTimerTicks(HSM_Timer *t, HSM *me, uint8_t sig, uint32_t delayTicks, uint32_t periodTicks);
+void HSM_disarmTimer(HSM_Timer *t);
+
+const HSM_Stats *HSM_getStats(const HSM *me);
+void HSM_resetStats(HSM *me);
+
+#endif /* HSM_H_ */
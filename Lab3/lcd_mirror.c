@@ -0,0 +1,129 @@
+/*
+ * lcd_mirror.c
+ *
+ *  Changed display lines sent over the telemetry stream. See lcd_mirror.h.
+ */
+
+#include "lcd_mirror.h"
+#include "telemetry.h"
+#include "crc16.h"
+#include "grlib.h"
+#include "LcdDriver/Sharp96x96.h"
+
+#define CRC_LEN         2
+
+static uint8_t packet[LCD_MIRROR_PACKET_SIZE];
+static uint8_t seq;
+
+static uint16_t lineCrc[LCD_MIRROR_LINES];         // CRC of each line as last sent
+static uint8_t lineSent[LCD_MIRROR_LINES / 8];     // lineCrc holds for the line
+static uint8_t nextLine;                // first line the next flush looks at
+static uint8_t refreshLine;             // next lines resent regardless
+
+
+// Run-length encodes one line into out. Runs of three or more equal bytes
+// become a repeat, everything else goes as literals. Returns the bytes
+// written, at most LCD_MIRROR_MAX_LINE - 1.
+static uint8_t encodeLine(uint8_t *out, const uint8_t *line)
+{
+    uint8_t *start = out;
+    uint8_t i = 0, n, first;
+
+    while (i < LCD_MIRROR_LINE_BYTES) {
+        for (n = 1; (i + n < LCD_MIRROR_LINE_BYTES) && (line[i + n] == line[i]); n++)
+            ;
+
+        if (n >= 3) {
+            *out++ = 0x80 | (n - 1);
+            *out++ = line[i];
+            i += n;
+            continue;
+        }
+
+        // Literals up to the next run of three or the end of the line
+        first = i;
+        do {
+            i += n;
+            if (i >= LCD_MIRROR_LINE_BYTES)
+                break;
+            for (n = 1; (i + n < LCD_MIRROR_LINE_BYTES) && (line[i + n] == line[i]); n++)
+                ;
+        } while (n < 3);
+
+        *out++ = i - first - 1;
+        while (first < i)
+            *out++ = line[first++];
+    }
+
+    return out - start;
+}
+
+
+// Sends the lines of displayBuffer that changed since they were last
+// sent, starting where the last flush stopped. Does nothing while the
+// previous packet is still going out; the changes wait for a later flush.
+void LcdMirror_flush(const uint8_t *displayBuffer)
+{
+    const uint8_t *line;
+    uint16_t pos = LCD_MIRROR_HEADER_LEN, crc;
+    uint8_t l = nextLine, lines = 0, i;
+
+    if (!Telemetry_sendIdle())
+        return;
+
+    for (i = 0; i < LCD_MIRROR_REFRESH_LINES; i++) {
+        lineSent[refreshLine >> 3] &= ~(1 << (refreshLine & 7));
+        refreshLine = (refreshLine + 1) % LCD_MIRROR_LINES;
+    }
+
+    for (i = 0; i < LCD_MIRROR_LINES; i++) {
+        line = displayBuffer + l * LCD_MIRROR_LINE_BYTES;
+        crc = CRC16_compute(line, LCD_MIRROR_LINE_BYTES);
+
+        if (!(lineSent[l >> 3] & (1 << (l & 7))) || (crc != lineCrc[l])) {
+            if (pos + LCD_MIRROR_MAX_LINE + CRC_LEN > LCD_MIRROR_PACKET_SIZE)
+                break;                  // this one starts the next packet
+
+            packet[pos++] = l;
+            pos += encodeLine(&packet[pos], line);
+            lineCrc[l] = crc;
+            lineSent[l >> 3] |= 1 << (l & 7);
+            lines++;
+        }
+
+        l = (l + 1) % LCD_MIRROR_LINES;
+    }
+    nextLine = l;
+
+    if (!lines)
+        return;
+
+    packet[0] = LCD_MIRROR_SYNC1;
+    packet[1] = LCD_MIRROR_SYNC2;
+    packet[2] = seq++;
+#ifdef ROTATE_90
+    packet[3] = LCD_MIRROR_ROTATE_90;
+#else
+    packet[3] = 0;
+#endif
+    packet[4] = lines;
+    packet[5] = (pos - LCD_MIRROR_HEADER_LEN) & 0xFF;
+    packet[6] = (pos - LCD_MIRROR_HEADER_LEN) >> 8;
+
+    crc = CRC16_compute(&packet[2], pos - 2);
+    packet[pos++] = crc >> 8;
+    packet[pos++] = crc & 0xFF;
+
+    if (!Telemetry_send(packet, pos))
+        LcdMirror_resend();
+}
+
+// Marks every line as changed, so the following flushes send the whole
+// screen
+void LcdMirror_resend(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < sizeof(lineSent); i++)
+        lineSent[i] = 0;
+}
@@ -3,50 +3,137 @@
 #include <stdlib.h>
 #include "peripherals.h"
 #include "string.h"
+#include "adc_stream.h"
+#include "sensor_conv.h"
+#include "filters.h"
+#include "calendar.h"
+#include "rtc_clock.h"
+#include "swtimer.h"
+#include "event_loop.h"
+#include "hsm.h"
+#include "debug_uart.h"
+#include "telemetry.h"
+#include "flash_log.h"
+#include "settings.h"
 
 
 /**
  * main.c
  */
 
-#define CALADC12_15V_30C *((unsigned int *)0x1A1A)
-#define CALADC12_15V_85C *((unsigned int *)0x1A1C)
+// Keep time with the RTC_A hardware calendar instead of counting TimerA2 interrupts
+//#define CLOCK_USE_RTC
 
 // Function Prototypes
 void configButtons(void);
+unsigned char buttonSettled(void);
 
 void configUCS(void);
-void configTimerA2(void);
-__interrupt void Timer_A2_ISR(void);
-void stopTimerA2(void);
-void enableTimerA2(void);
 
-void displayTime(long unsigned int inTime);
-char * monthNumToASCII(int monthNum);
+void displayTime(const CalendarTime *inTime);
 void displayTimeFormat(unsigned int month, unsigned int day, unsigned int hours, unsigned int minutes, unsigned int seconds);
+void displayEdit(void);
+void updateClock(void);
 
 void configTempSensor(void);
-void displayTemp(float inAvgTempC);
+void displayTemp(int inAvgTempDeciC);
 void sampleTemp(void);
-float avgTempC();
-void resetAvgTempC(void);
 
 
-long unsigned int timer;                        // timer count for TimerA2, increased by TimerA2 ISR
-long unsigned int initTime;                     // initial time, used for populating the tempC array
-                                                // during the first 10 seconds
+long unsigned int timer;                        // seconds on the shared time base, read on every clock tick
+long unsigned int clockTime;                    // value of timer that the date and time in now match
 
-// Array storing days in each month (assuming non leap year)
-const unsigned int monthDays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30 ,31 , 30, 31};
+// Year shown by the clock, the buttons only edit month, day and time
+#define CLOCK_YEAR  2021
+
+// Date and time on the display, advanced once per timer count
+CalendarTime now = {CLOCK_YEAR, 1, 1, 0, 0, 0};
+
+// Settings kept in info memory (settings.h)
+#define SETTING_CLOCK_TIME  0                   // date and time last set, a CalendarTime
 
 unsigned int in_temp;       // holds the result from the conversion, the ADC counts from MEM0
 
-// temperatureDegC stores the temp in degree C from the conversion from ADC counts (in_temp)
-// degC_per_bit stores the value of resolution in degC/bit
-volatile float temperatureDegC, degC_per_bit;
+// temperatureDeciC stores the temp in tenths of a degree C from the conversion from ADC counts (in_temp)
+volatile int temperatureDeciC;
+
+// Running average of the last 10 temp. readings, in tenths of a degree C
+MovingAvg tempAvg;
+
+// Telemetry channels on the debug UART (tools/telemetry/telemrx.c), once a
+// second: ADC counts of the sensor, temperature and its average in tenths
+// of a degree C
+#define TELEM_CH_TEMP_ADC   1
+#define TELEM_CH_TEMP       2
+#define TELEM_CH_TEMP_AVG   3
+
+// Button edges closer than this to the previous one are contact bounce
+#define BUTTON_BOUNCE_TICKS TIMEBASE_MS_TO_TICKS(20)
+uint32_t lastButtonEdge;
+
+// Posts SIG_TICK on every second of the time base
+SWTimer secondTick;
+void secondTickExpired(SWTimer *t);
+
+// Temperature stream: A10 against the 1.5 V reference, 16 readings a second
+// in the background. 384 cycle sample time for the sensor's settling.
+const uint8_t tempChannels[1] = {ADC_CH_TEMP};
+const ADCStream_Config tempStream = {tempChannels, 1, 16, ADC_STREAM_REF_1_5V, ADC12SHT0_9, 16, 0};
+
+
+//*****************************************************************************
+//
+// Clock state machine
+//
+//  display     samples temperature and shows temp, date and time every
+//              second, RIGHT BUTTON -> edit
+//  edit        LEFT BUTTON steps the underlined field, RIGHT BUTTON moves
+//              to the next one and after SECONDS sets the clock -> display
+//
+//*****************************************************************************
+
+// Signals
+#define SIG_TICK        (HSM_SIG_USER + 0)      // a second has passed
+#define SIG_RIGHT       (HSM_SIG_USER + 1)      // RIGHT BUTTON (P1.1) pressed
+#define SIG_LEFT        (HSM_SIG_USER + 2)      // LEFT BUTTON (P2.1) pressed
+
+// Event loop bit that says the clock has events queued
+#define EVENT_CLOCK     EVENT_USER
 
-// Array with 10 indices holds the value of the last 10 temp. readings
-float tempC[10];
+// Event loop states, CPU time is counted separately for each
+#define LOOP_STATE_DISPLAY  0
+#define LOOP_STATE_EDIT     1
+
+HSM clockApp;
+
+void clockNotify(void);
+void displayEntry(HSM *me);
+uint8_t displayHandler(HSM *me, const HSM_Event *e);
+void editEntry(HSM *me);
+uint8_t editHandler(HSM *me, const HSM_Event *e);
+
+//                                  parent  initial entry           exit    handler
+const HSM_State displayState    = { 0,      0,      displayEntry,   0,      displayHandler };
+const HSM_State editState       = { 0,      0,      editEntry,      0,      editHandler };
+
+// Edit mode fields, in the order the RIGHT BUTTON steps through them
+#define EDIT_MONTH      0
+#define EDIT_DAY        1
+#define EDIT_HOURS      2
+#define EDIT_MINUTES    3
+#define EDIT_SECONDS    4
+#define EDIT_FIELDS     5
+
+unsigned char editField;                        // field underlined and changed by the LEFT BUTTON
+unsigned char edited[EDIT_FIELDS];              // edited month, day, hours, minutes and seconds
+
+// Lowest value of each field, the highest is editMax()
+const unsigned char editMin[EDIT_FIELDS] = {1, 1, 0, 0, 0};
+
+// Underline under each field: x start, x end, y
+const unsigned char editLine[EDIT_FIELDS][3] = {
+    {44, 64, 85}, {64, 84, 85}, {40, 50, 95}, {58, 68, 95}, {76, 86, 95}
+};
 
 
 int main(void)
@@ -54,297 +141,203 @@ int main(void)
     WDTCTL = WDTPW | WDTHOLD;   // stop watchdog timer
 
     // Useful code starts here
-    // Initialization and configuration of LEDs, Display, Keypad, UCS, TimerA2, Push Buttons and Temp Sensor
+    // Initialization and configuration of LEDs, Display (which also starts the time base), Keypad, UCS,
+    // Push Buttons and Temp Sensor
     initLeds();
     configDisplay();
     configKeypad();
 
     configButtons();
     configUCS();
-    configTimerA2();
+    EventLoop_init();       // also starts the software timers
+
+    // After a reset the clock carries on from the last date and time set
+    Settings_init();
+    Settings_get(SETTING_CLOCK_TIME, &now, sizeof(now));
+#ifdef CLOCK_USE_RTC
+    RTCClock_init(&now);
+#endif
     configTempSensor();
 
-    _BIS_SR(GIE);           // enables interrupts
-
+    DebugUart_init();
+    Telemetry_init();
+    FlashLog_init(1);       // average temperature, tenths of a degree C
 
-    initTime = 0;                               // initial time set to 0 seconds
-    timer = initTime;                           // timer set to initial time
-    long unsigned int prevTime = timer - 1;     // prevTime declared and set to timer - 1
+    _BIS_SR(GIE);           // enables interrupts
 
-    unsigned char state = 0;                    // state of main state machine set to 0
-    unsigned char editState = 0;                // state of edit state machine set to 0
 
-    long unsigned int editedTimer = 0;          // editTimer stores the value in seconds of edit time
-    long unsigned int editedMonth = 1;          // stores value of edited month
-    long unsigned int editedDay = 1;            // stores value of edited day
-    long unsigned int editedHour = 0;           // stores value of edited hour
-    long unsigned int editedMin = 0;            // stores value of edited minutes
-    long unsigned int editedSec = 0;            // stores value of edited seconds
+    timer = Timebase_seconds();                 // timer set to initial time
+    clockTime = timer;
 
     // Clears display from anything
     Graphics_clearDisplay(&g_sContext);
     Graphics_flushBuffer(&g_sContext);
 
+    HSM_init(&clockApp, &displayState, clockNotify);
+
+#ifndef CLOCK_USE_RTC
+    // Tick on the second boundaries of the time base, so timer has just
+    // changed every time SIG_TICK arrives. With the RTC its second event
+    // posts the tick instead.
+    secondTick.callback = secondTickExpired;
+    SWTimer_start(&secondTick, TIMEBASE_TICKS_PER_SEC - (Timebase_ticks() & (TIMEBASE_TICKS_PER_SEC - 1)),
+                  TIMEBASE_TICKS_PER_SEC);
+#endif
 
-    // Forever loop
+
+    // Forever loop: sleeps until a tick, a button press or another interrupt,
+    // then handles each event once
     while (1) {
 
-        // MAIN State Machine to switch between two states
-        // Case 0 is sampling temperature readings, and displaying temperature, date and time
-        // Case 1 is edit mode, to edit date and time
-        switch (state) {
-
-        case 0:
-
-            // If a second has passed, then sample temperature, and display temp, date and time
-            if (timer >= (prevTime + 1)) {
-                sampleTemp();
-                displayTemp(avgTempC());
-                displayTime(timer);
-                prevTime = timer;           // sets prevTime to current time
-            }
-
-            // If RIGHT BUTTON is pressed, it enters into edit mode
-            // Before entering edit mode, it stops timer and
-            // sets all the edited.... variables to corresponding values
-            if ((P1IN & BIT1) == 0) {
-                stopTimerA2();
-                editedTimer = 0;
-                editedMonth = 1;
-                editedDay = 1;
-                editedHour = 0;
-                editedMin = 0;
-                editedSec = 0;
-                editState = 0;
-                Graphics_clearDisplay(&g_sContext);                 // Clears display
-                displayTimeFormat(editedMonth, editedDay,
-                                  editedHour, editedMin, editedSec); // Display formatted edit time
-                Graphics_drawLineH(&g_sContext, 44, 64, 85);        // Underlines the MONTH
-                Graphics_flushBuffer(&g_sContext);                  // Refreshes display
-                state++;        // state is incremented to enter edit mode
-            }
-
-            break;
-
-        case 1:
-
-            // EDIT State Machine to switch between six states
-            // Case 0 to edit MONTH, Case 1 to edit DAYS, Case 2 to edit HOURS
-            // Case 3 to edit MINUTES, Case 4 to edit SECONDS,
-            // Case 5 to set global timer to new value of editedTimer, enable timer and transition back to State 0
-            switch (editState) {
-
-            // Configure MONTH
-            case 0:
-
-                // If RIGHT BUTTON is pressed, save MONTH and corresponding seconds
-                // in editTimer and then increment editState to edit next element
-                if ((P1IN & BIT1) == 0) {
-                    long unsigned int totalDays = 0;
-                    int i;
-                    for (i = 1; i < editedMonth; i++) {
-                        totalDays += monthDays[i - 1];          // Calculates total days based on chosen MONTH
-                    }
-                    editedTimer = editedTimer + (totalDays * 24 * 60 * 60); // Calculates seconds based on total days
-                                                                            // Stores calculated seconds in editTimer
-
-                    // Clears displays, updates edit time display, underlines DAY element, updates display
-                    Graphics_clearDisplay(&g_sContext);
-                    displayTimeFormat(editedMonth, editedDay, editedHour, editedMin, editedSec);
-                    Graphics_drawLineH(&g_sContext, 64, 84, 85);
-                    Graphics_flushBuffer(&g_sContext);
-
-                    __delay_cycles(500000);     // very brief delay which serves as right button debounce delay
-                    editState++;                // go to next edit state, to edit DAYS
-                }
-
-                // If LEFT BUTTON is pressed, increments MONTH value and editedMonth variable
-                // and circles back to first value after max month (i.e. after DEC goes to JAN)
-                if ((P2IN & BIT1) == 0) {
-
-                    if (editedMonth < 12) {
-                        editedMonth++;
-                    } else {
-                        editedMonth = 1;
-                    }
-
-                    // Clears displays, updates edit time display, underlines MONTH element, updates display
-                    Graphics_clearDisplay(&g_sContext);
-                    displayTimeFormat(editedMonth, editedDay, editedHour, editedMin, editedSec);
-                    Graphics_drawLineH(&g_sContext, 44, 64, 85);
-                    Graphics_flushBuffer(&g_sContext);
-                }
-
-                break;
-
-
-            // Configure DAYS
-            case 1:
-
-                // If RIGHT BUTTON is pressed, save DAYS and corresponding seconds
-                // in editTimer and then increment editState to edit next element
-                if ((P1IN & BIT1) == 0) {
-
-                    editedTimer = editedTimer + ((editedDay - 1) * 24 * 60 * 60);
-
-                    // Clears displays, updates edit time display, underlines HOURS element, updates display
-                    Graphics_clearDisplay(&g_sContext);
-                    displayTimeFormat(editedMonth, editedDay, editedHour, editedMin, editedSec);
-                    Graphics_drawLineH(&g_sContext, 40, 50, 95);
-                    Graphics_flushBuffer(&g_sContext);
-
-                    __delay_cycles(500000);     // very brief delay which serves as right button debounce delay
-                    editState++;
-                    break;
-                }
-
-                // If LEFT BUTTON is pressed, increments DAYS value and editedDay variable
-                // and circles back to first value after max day depending on chosen MONTH
-                if ((P2IN & BIT1) == 0) {
-
-                    if (editedDay < monthDays[editedMonth - 1]) {
-                        editedDay++;
-                    } else {
-                        editedDay = 1;
-                    }
-
-                    // Clears displays, updates edit time display, underlines DAY element, updates display
-                    Graphics_clearDisplay(&g_sContext);
-                    displayTimeFormat(editedMonth, editedDay, editedHour, editedMin, editedSec);
-                    Graphics_drawLineH(&g_sContext, 64, 84, 85);
-                    Graphics_flushBuffer(&g_sContext);
-                }
-
-                break;
-
-
-            // Configure HOURS
-            case 2:
-
-                // If RIGHT BUTTON is pressed, save HOURS and corresponding seconds
-                // in editTimer and then increment editState to edit next element
-                if ((P1IN & BIT1) == 0) {
-
-                    editedTimer = editedTimer + (editedHour * 60 * 60);
-
-                    // Clears displays, updates edit time display, underlines MINUTES element, updates display
-                    Graphics_clearDisplay(&g_sContext);
-                    displayTimeFormat(editedMonth, editedDay, editedHour, editedMin, editedSec);
-                    Graphics_drawLineH(&g_sContext, 58, 68, 95);
-                    Graphics_flushBuffer(&g_sContext);
-
-                    __delay_cycles(500000);     // very brief delay which serves as right button debounce delay
-                    editState++;
-                    break;
-                }
-
-                // If LEFT BUTTON is pressed, increments HOURS value and editedHour variable
-                // and circles back to first value after max hour (i.e. after 23 goes to 0)
-                if ((P2IN & BIT1) == 0) {
-
-                    if (editedHour < 23) {
-                        editedHour++;
-                    } else {
-                        editedHour = 0;
-                    }
+        EventLoop_wait();
 
-                    // Clears displays, updates edit time display, underlines HOURS element, updates display
-                    Graphics_clearDisplay(&g_sContext);
-                    displayTimeFormat(editedMonth, editedDay, editedHour, editedMin, editedSec);
-                    Graphics_drawLineH(&g_sContext, 40, 50, 95);
-                    Graphics_flushBuffer(&g_sContext);
-                }
-
-                break;
+#ifdef CLOCK_USE_RTC
+        // The RTC interrupt wakes the loop without posting anything
+        if (RTCClock_takeEvents() & RTC_EVENT_SECOND)
+            HSM_post(&clockApp, SIG_TICK, 0);
+#endif
 
+        HSM_dispatchAll(&clockApp);
+    }
+}
 
-            // Configure MINUTES
-            case 3:
+// Called for every event queued on the clock, keeps the event loop awake until it is dispatched
+void clockNotify() {
+    EventLoop_post(EVENT_CLOCK);
+}
 
-                // If RIGHT BUTTON is pressed, save MINUTES and corresponding seconds
-                // in editTimer and then increment editState to edit next element
-                if ((P1IN & BIT1) == 0) {
 
-                    editedTimer += editedMin * 60;
+// Brings now up to the current date and time
+void updateClock() {
+#ifdef CLOCK_USE_RTC
+    RTCClock_read(&now);        // Date and time straight from the RTC_A calendar
+#else
+    timer = Timebase_seconds();
 
-                    // Clears displays, updates edit time display, underlines SECONDS element, updates display
-                    Graphics_clearDisplay(&g_sContext);
-                    displayTimeFormat(editedMonth, editedDay, editedHour, editedMin, editedSec);
-                    Graphics_drawLineH(&g_sContext, 76, 86, 95);
-                    Graphics_flushBuffer(&g_sContext);
+    // Step the date and time forward by the seconds counted since the last update
+    while (clockTime < timer) {
+        Calendar_advance(&now);
+        clockTime++;
+    }
+#endif
+}
 
-                    __delay_cycles(500000);     // very brief delay which serves as right button debounce delay
-                    editState++;
-                    break;
-                }
+// DISPLAY state, samples temperature and displays temperature, date and time once a second
+void displayEntry(HSM *me) {
+    EventLoop_setState(LOOP_STATE_DISPLAY);
 
-                // If LEFT BUTTON is pressed, increments MINUTES value and editedMin variable
-                // and circles back to first value after max minute (i.e. after 59 goes to 0)
-                if ((P2IN & BIT1) == 0) {
-
-                    if (editedMin < 59) {
-                        editedMin++;
-                    } else {
-                        editedMin = 0;
-                    }
-
-                    // Clears displays, updates edit time display, underlines MINUTES element, updates display
-                    Graphics_clearDisplay(&g_sContext);
-                    displayTimeFormat(editedMonth, editedDay, editedHour, editedMin, editedSec);
-                    Graphics_drawLineH(&g_sContext, 58, 68, 95);
-                    Graphics_flushBuffer(&g_sContext);
-                }
-
-                break;
+    // Show the clock without waiting for the next second. Sampling stays
+    // with SIG_TICK, so the average and the log keep one sample a second.
+    updateClock();
+    if (tempAvg.count)
+        displayTemp(tempAvg.value);
+    displayTime(&now);
+}
 
+uint8_t displayHandler(HSM *me, const HSM_Event *e) {
 
-            // Configure SECONDS
-            case 4:
+    switch (e->sig) {
 
-                // If RIGHT BUTTON is pressed, save SECONDS and corresponding seconds
-                // in editTimer and then increment editState to edit next element
-                if ((P1IN & BIT1) == 0) {
+    case SIG_TICK:
+        updateClock();
+        sampleTemp();
+        displayTemp(tempAvg.value);
+        displayTime(&now);
+        return HSM_HANDLED;
 
-                    editedTimer += editedSec;
-                    editState++;
-                    break;
-                }
+    // If RIGHT BUTTON is pressed, it enters into edit mode
+    // (the clock keeps running until the new time is set)
+    case SIG_RIGHT:
+        HSM_transition(me, &editState);
+        return HSM_HANDLED;
+    }
 
-                // If LEFT BUTTON is pressed, increments SECONDS value and editedSec variable
-                // and circles back to first value after max second (i.e. after 59 goes to 0)
-                if ((P2IN & BIT1) == 0) {
+    return HSM_SUPER;
+}
 
-                    if (editedSec < 59) {
-                        editedSec++;
-                    } else {
-                        editedSec = 0;
-                    }
 
-                    // Clears displays, updates edit time display, underlines SECONDS element, updates display
-                    Graphics_clearDisplay(&g_sContext);
-                    displayTimeFormat(editedMonth, editedDay, editedHour, editedMin, editedSec);
-                    Graphics_drawLineH(&g_sContext, 76, 86, 95);
-                    Graphics_flushBuffer(&g_sContext);
-                }
-
-                break;
-
-
-            // Updates global timer, re-enables timer and goes back to State 0
-            case 5:
+// EDIT state, starts from JAN 01 00:00:00 with the MONTH underlined
+void editEntry(HSM *me) {
+    EventLoop_setState(LOOP_STATE_EDIT);
 
-                initTime = editedTimer;     // set initTime (ie. initial time variable) to editedTimer
-                timer = initTime;           // set timer to initTime, new timer based on recent edited settings
-                prevTime = timer - 1;
-                resetAvgTempC();            // resets (i.e. zeroes) all elements in tempC array
-                enableTimerA2();            // re-enables timer interrupts
-                state = 0;                  // exit EDIT state and go back to State 0
-                break;
-            }
+    edited[EDIT_MONTH] = 1;
+    edited[EDIT_DAY] = 1;
+    edited[EDIT_HOURS] = 0;
+    edited[EDIT_MINUTES] = 0;
+    edited[EDIT_SECONDS] = 0;
+    editField = EDIT_MONTH;
+
+    displayEdit();
+}
 
+// Highest value of an edit field, the DAYS depend on the chosen MONTH
+unsigned char editMax(unsigned char field) {
+
+    switch (field) {
+    case EDIT_MONTH:
+        return 12;
+    case EDIT_DAY:
+        return Calendar_daysInMonth(edited[EDIT_MONTH], now.year);
+    case EDIT_HOURS:
+        return 23;
+    default:
+        return 59;
+    }
+}
+
+uint8_t editHandler(HSM *me, const HSM_Event *e) {
+
+    switch (e->sig) {
+
+    // If LEFT BUTTON is pressed, increments the underlined field and circles
+    // back to its first value after its max (e.g. after DEC goes to JAN)
+    case SIG_LEFT:
+        if (edited[editField] < editMax(editField))
+            edited[editField]++;
+        else
+            edited[editField] = editMin[editField];
+
+        displayEdit();
+        return HSM_HANDLED;
+
+    // If RIGHT BUTTON is pressed, keeps the field and moves to the next one.
+    // After SECONDS, sets the date and time to the edited values and goes back to DISPLAY
+    case SIG_RIGHT:
+        editField++;
+
+        if (editField < EDIT_FIELDS) {
+            displayEdit();
+            return HSM_HANDLED;
         }
 
+        now.month = edited[EDIT_MONTH];
+        now.day = edited[EDIT_DAY];
+        now.hours = edited[EDIT_HOURS];
+        now.minutes = edited[EDIT_MINUTES];
+        now.seconds = edited[EDIT_SECONDS];
+        MovingAvg_reset(&tempAvg);  // restarts the temperature average
+        Settings_set(SETTING_CLOCK_TIME, &now, sizeof(now));
+#ifdef CLOCK_USE_RTC
+        RTCClock_set(&now);         // loads the RTC calendar in one step
+#else
+        timer = Timebase_seconds();
+        clockTime = timer;          // count from the new date and time
+#endif
+        HSM_transition(me, &displayState);
+        return HSM_HANDLED;
     }
+
+    return HSM_SUPER;
+}
+
+// Clears display, shows the edited date and time and underlines the field being edited
+void displayEdit() {
+
+    Graphics_clearDisplay(&g_sContext);
+    displayTimeFormat(edited[EDIT_MONTH], edited[EDIT_DAY], edited[EDIT_HOURS],
+                      edited[EDIT_MINUTES], edited[EDIT_SECONDS]);
+    Graphics_drawLineH(&g_sContext, editLine[editField][0], editLine[editField][1], editLine[editField][2]);
+    Graphics_flushBuffer(&g_sContext);
 }
 
 // Configure LaunchPad buttons for edit settings
@@ -362,68 +355,66 @@ void configButtons() {
     P1OUT |= (BIT1);            // P1.1, pull-up resistor configured
     P2OUT |= (BIT1);            // P2.1, pull-up resistor configured
 
-}
+    P1IES |= (BIT1);            // P1.1, interrupt on the falling edge (press)
+    P2IES |= (BIT1);            // P2.1, interrupt on the falling edge (press)
 
-// configures UCS
-void configUCS() {
-    P5SEL |= (BIT5 | BIT4 | BIT3 |BIT2);    // enables XT1CLK and XT2CLK, both crystal clocks
-}
+    P1IFG &= ~(BIT1);           // clear edges latched while configuring
+    P2IFG &= ~(BIT1);
+
+    P1IE |= (BIT1);             // P1.1, interrupt enabled
+    P2IE |= (BIT1);             // P2.1, interrupt enabled
 
-// configures TimerA2 with one second resolution
-// including source clk, divider, up mode; also sets Max count to 32767; enables TimerA2 interrupt
-void configTimerA2 () {
-    TA2CTL = TASSEL_1 + ID_0 + MC_1;        // sets ACLK as TimerA2 source, divider is 1, up mode
-    TA2CCR0 = 32767;                          // TA2CCR0 = Max_count = ACLK_ticks - 1 = 32768 - 1 = 32767
-    TA2CCTL0 = CCIE;                        // TA2CCR0 interrupt enabled
 }
 
-// TimerA2 ISR configuration
-// No leap counting needed for timer
-#pragma vector=TIMER2_A0_VECTOR
-__interrupt void Timer_A2_ISR(void) {
-    timer++;
+// Once-a-second software timer, runs from the Timer A1 ISR which wakes the main loop
+void secondTickExpired(SWTimer *t) {
+    HSM_post(&clockApp, SIG_TICK, 0);
 }
 
+// Returns 1 for the first edge after BUTTON_BOUNCE_TICKS of quiet, 0 for bounce
+unsigned char buttonSettled() {
 
-// stops timer A2
-void stopTimerA2() {
-    TA2CTL |= MC_0;         // stop timer, enable stop mode
-}
+    uint32_t now = Timebase_ticks();
+    unsigned char settled = ((now - lastButtonEdge) >= BUTTON_BOUNCE_TICKS);
 
-// enables TimerA2 after being stopped
-void enableTimerA2() {
-    TA2CTL |= MC_1;        // up mode
+    lastButtonEdge = now;
+    return settled;
 }
 
-// Function which takes a copy of global time count as its input argument
-// Convert the time in seconds that was passed in to Month, Day, Hour, Minutes and Seconds
-// Takes above variables and passes them to displayTimeFormat() method that creates ASCII arrays that are displayed
-void displayTime(long unsigned int inTime) {
-
-    unsigned int dayNum = 0;
-    dayNum = (int)((inTime) / (24.0 * 60.0 * 60.0));
-    bool done = 0;
-    unsigned int month, day, hours, minutes, seconds;
+//------------------------------------------------------------------------------
+// Port 1 Interrupt Service Routine (RIGHT BUTTON, P1.1)
+//------------------------------------------------------------------------------
+#pragma vector=PORT1_VECTOR
+__interrupt void PORT1_ISR(void)
+{
+    if ((P1IV == P1IV_P1IFG1) && buttonSettled()) {
+        HSM_post(&clockApp, SIG_RIGHT, 0);
+        EVENT_LOOP_POST_FROM_ISR(EVENT_BUTTON);
+    }
+}
 
-    // Determines month and day number
-    int i;
-    for (i = 1; i <= 12 && !done; i++) {
-
-        if (dayNum < monthDays[i - 1]) {
-            day = dayNum + 1;
-            month = i;
-            done = 1;
-        } else {
-            dayNum = dayNum - monthDays[i - 1];
-        }
+//------------------------------------------------------------------------------
+// Port 2 Interrupt Service Routine (LEFT BUTTON, P2.1)
+//------------------------------------------------------------------------------
+#pragma vector=PORT2_VECTOR
+__interrupt void PORT2_ISR(void)
+{
+    if ((P2IV == P2IV_P2IFG1) && buttonSettled()) {
+        HSM_post(&clockApp, SIG_LEFT, 0);
+        EVENT_LOOP_POST_FROM_ISR(EVENT_BUTTON);
     }
+}
 
-    // Determines hours, minutes, seconds as an integer
-    hours = ((long int)(inTime / (60 * 60))) % 24;
-    minutes = ((long int)(inTime / 60)) % 60;
-    seconds = inTime % 60;
+// configures UCS
+void configUCS() {
+    P5SEL |= (BIT5 | BIT4 | BIT3 |BIT2);    // enables XT1CLK and XT2CLK, both crystal clocks
+}
+
+// Function which takes the current date and time as its input argument
+// Passes its Month, Day, Hour, Minutes and Seconds to displayTimeFormat() method that creates ASCII arrays that are displayed
+void displayTime(const CalendarTime *inTime) {
 
-    displayTimeFormat(month, day, hours, minutes, seconds);
+    displayTimeFormat(inTime->month, inTime->day, inTime->hours, inTime->minutes, inTime->seconds);
 
 }
 
@@ -434,7 +425,7 @@ void displayTimeFormat(unsigned int month, unsigned int day, unsigned int hours,
     // Format array for DATE
     unsigned char dateASCII[7];
     dateASCII[3] = ' ';
-    char *monthName = monthNumToASCII(month);
+    const char *monthName = Calendar_monthName(month);
 
     int i;
     for (i = 0; i < 3; i++) {
@@ -464,90 +455,29 @@ void displayTimeFormat(unsigned int month, unsigned int day, unsigned int hours,
     Graphics_flushBuffer(&g_sContext);
 }
 
-// Function which takes Month as an integer number as its input argument
-// Based on input number, copies the corresponding Month name as a string (char array)
-// Returns string as a char pointer
-char * monthNumToASCII(int monthNum) {
-
-    static char monthStr[3];
-
-    switch (monthNum) {
-
-        case 1:
-            strcpy(monthStr, "JAN");
-            break;
-        case 2:
-            strcpy(monthStr, "FEB");
-            break;
-        case 3:
-            strcpy(monthStr, "MAR");
-            break;
-        case 4:
-            strcpy(monthStr, "APR");
-            break;
-        case 5:
-            strcpy(monthStr, "MAY");
-            break;
-        case 6:
-            strcpy(monthStr, "JUN");
-            break;
-        case 7:
-            strcpy(monthStr, "JUL");
-            break;
-        case 8:
-            strcpy(monthStr, "AUG");
-            break;
-        case 9:
-            strcpy(monthStr, "SEP");
-            break;
-        case 10:
-            strcpy(monthStr, "OCT");
-            break;
-        case 11:
-            strcpy(monthStr, "NOV");
-            break;
-        case 12:
-            strcpy(monthStr, "DEC");
-            break;
-        }
-
-    return monthStr;
-}
-
 // Function to configure temperature sensor
 void configTempSensor() {
 
-    // Temperature sensor calibration
-    degC_per_bit = ((float)(85.0 - 30.0)) / ((float)(CALADC12_15V_85C - CALADC12_15V_30C));
+    // Temperature sensor calibration, precomputed as a fixed-point slope
+    SensorConv_initTemp();
 
-    REFCTL0 &= ~REFMSTR;
+    // Average of the last 10 readings, one reading per second
+    MovingAvg_init(&tempAvg, 10);
 
-    // ADC12 Sample and Hold clock cycle is set to 384 cycles
-    // ADC12 internal reference voltage is enabled
-    // ADC12 ADC12 is turned on
-    // Vref = 1.5 V internal
-    ADC12CTL0 = ADC12SHT0_9 | ADC12REFON | ADC12ON;
-
-    // ADC12SHP = 1 = SAMPCON signal sourced from sampling timer
-    // Enable sample timer
-    ADC12CTL1 = ADC12SHP;
-
-    // Memory location 0 is used for input channel A10 (i.e. temp sensor)
-    // Reference voltage is set to VREF+
-    ADC12MCTL0 = ADC12SREF_1 + ADC12INCH_10;
-
-    __delay_cycles(100);                        // delay to allow Ref to settle
-    ADC12CTL0 |= ADC12ENC;                      // Enable conversion
+    // Start background conversions of the temperature sensor.
+    // Timer A0 triggers them and the ADC12 ISR stores the results, so
+    // sampleTemp() never waits on the ADC.
+    ADCStream_start(&tempStream);
 
 }
 
-// Function which takes (average) temperature in degree C as its input argument
-// Calculates (average) temperature in in degree F
+// Function which takes (average) temperature in tenths of a degree C as its input argument
+// Calculates (average) temperature in tenths of a degree F
 // Creates ascii arrays and displays temperature in degree C and F to the LCD in the format specified
-void displayTemp(float inAvgTempC) {
+void displayTemp(int inAvgTempDeciC) {
 
     // Temperature in Fahrenheit = (9/5)*Tc + 32
-    float inAvgTempF = inAvgTempC * (9.0 / 5.0) + 32.0;
+    int inAvgTempDeciF = SensorConv_deciCtoDeciF(inAvgTempDeciC);
 
     // Formatting of temperature display array in Celsius
     unsigned char tempC_ASC[8];
@@ -556,10 +486,10 @@ void displayTemp(float inAvgTempC) {
     tempC_ASC[6] = 'C';
     tempC_ASC[7] = '\0';
 
-    tempC_ASC[0] = ((int)inAvgTempC / 100.0) + '0';
-    tempC_ASC[1] = ((int)(inAvgTempC / 10.0) % 10) + '0';
-    tempC_ASC[2] = ((int)inAvgTempC % 10) + '0';
-    tempC_ASC[4] = ((int)(inAvgTempC * 10) % 10) + '0';
+    tempC_ASC[0] = (inAvgTempDeciC / 1000) + '0';
+    tempC_ASC[1] = ((inAvgTempDeciC / 100) % 10) + '0';
+    tempC_ASC[2] = ((inAvgTempDeciC / 10) % 10) + '0';
+    tempC_ASC[4] = (inAvgTempDeciC % 10) + '0';
 
     // Formatting of temperature display array in Fahrenheit
     unsigned char tempF_ASC[8];
@@ -568,10 +498,10 @@ void displayTemp(float inAvgTempC) {
     tempF_ASC[6] = 'F';
     tempF_ASC[7] = '\0';
 
-    tempF_ASC[0] = ((int)inAvgTempF / 100.0) + '0';
-    tempF_ASC[1] = ((int)(inAvgTempF / 10.0) % 10) + '0';
-    tempF_ASC[2] = ((int)inAvgTempF % 10) + '0';
-    tempF_ASC[4] = ((int)(inAvgTempF * 10) % 10) + '0';
+    tempF_ASC[0] = (inAvgTempDeciF / 1000) + '0';
+    tempF_ASC[1] = ((inAvgTempDeciF / 100) % 10) + '0';
+    tempF_ASC[2] = ((inAvgTempDeciF / 10) % 10) + '0';
+    tempF_ASC[4] = (inAvgTempDeciF % 10) + '0';
 
     Graphics_clearDisplay(&g_sContext);
     Graphics_drawStringCentered(&g_sContext, tempC_ASC, AUTO_STRING_LENGTH, 64, 50, TRANSPARENT_TEXT);
@@ -579,55 +509,28 @@ void displayTemp(float inAvgTempC) {
 
 }
 
-// Function to sample temperature, and convert and store ADC value to temp in degree C
+// Function to sample temperature, and convert and store ADC value to temp in tenths of a degree C
 void sampleTemp() {
 
-    ADC12CTL0 &= ~ADC12SC;  // clear the start bit
-    ADC12CTL0 |= ADC12SC;   // Sampling and conversion start
-                            // Single conversion (single channel)
+    int16_t logged;
 
-    // Poll busy bit waiting for conversion to complete
-    while (ADC12CTL1 & ADC12BUSY)
-        __no_operation();
+    in_temp = ADCStream_latest(0);  // Most recent background conversion of A10
 
-    in_temp = ADC12MEM0; // Read results from conversion
+    // Convert ADC code to temperature in tenths of a degree C
+    temperatureDeciC = SensorConv_tempDeciC(in_temp);
 
-    // Convert ADC code to temperature in degree C
-    temperatureDegC = (float)(((long)in_temp - CALADC12_15V_30C) * degC_per_bit + 30.0);
+    MovingAvg_update(&tempAvg, temperatureDeciC);   // add reading to the average of the last 10
 
-    tempC[(timer % 10)] = temperatureDegC;      // store temp in degree C into tempC[] array
-                                                // uses circular indexing to store values in the
-                                                // index equivalent to timer % 10
+    // History in flash, stamped with the clock's seconds since January 1st
+    logged = tempAvg.value;
+    FlashLog_append(Calendar_toSeconds(&now, CLOCK_YEAR), &logged);
 
-    __no_operation(); // SET BREAKPOINT HERE
-}
-
-// Function that returns the average temperature in degree C as a float
-float avgTempC() {
-
-    float outTempC = 0;
-
-    int i;
-    for (i = 0; i < 10; i++)        // Add all values stored in tempC[] array
-        outTempC += tempC[i];
-
-    // If not first 10 readings, divide outTempC by 10 (i.e. tempC[] array is full)
-    // Else, tempC[] array is not fully populated, so divide by number of elements in it
-    if ((timer - initTime) >= 10)
-        outTempC /= 10;
-    else
-        outTempC /= (timer - initTime + 1);
-
-
-    return outTempC;
+    Telemetry_record(TELEM_CH_TEMP_ADC, in_temp);
+    Telemetry_record(TELEM_CH_TEMP, temperatureDeciC);
+    Telemetry_record(TELEM_CH_TEMP_AVG, tempAvg.value);
 
+    __no_operation(); // SET BREAKPOINT HERE
 }
 
-// Function that resets the tempC[] array, sets all array elements to 0
-void resetAvgTempC() {
-    int i;
-    for (i = 0; i < 10; i++)
-        tempC[i] = 0;
-}
 
 
@@ -218,9 +218,16 @@ void configDisplay(void)
     // Enable use of external clock crystals
      P5SEL |= (BIT5|BIT4|BIT3|BIT2);
 
+    ISR_PROBE_INIT();
+
 	// Initialize the display peripheral
 	Sharp96x96_Init();
 
+	// Toggle VCOM once a second from Timer A1 CCR0 on the shared time base
+	Timebase_init();
+	TA1CCR0 = TA1R + VCOM_TOGGLE_TICKS;
+	TA1CCTL0 = CCIE;
+
     // Configure the graphics library to use this display.
 	// The global g_sContext is a data structure containing information the library uses
 	// to send commands for our particular display.
@@ -237,25 +244,74 @@ void configDisplay(void)
 }
 
 /*
-void setupSPI_DAC(void)
+ * DAC (MCP4921) on the shared UCB0 SPI bus
+ */
+static uint8_t dacSpiDevice = SPI_BUS_NO_DEVICE;
+static uint8_t dacFrame[2];
+static SPIBus_Xfer dacXfer;
+
+// Completion callback for a DAC write, runs from the SPI bus interrupt
+static void dacLatch(SPIBus_Xfer *xfer)
 {
-// ** Set UCSI A0 Reset=1 to configure control registers **
-     UCB0CTL1 |= UCSWRST;
-     // 3-pin (SCLK, SIMO, SOMI), 8-bit, this MSP430 is SPI master,
-     // Clock polarity high, send data MSB first
-     UCB0CTL0 = UCMST + UCSYNC + UCCKPH + UCMSB;
-     // Use SMCLK as clock source, keep RESET = 1
-     UCB0CTL1 = UCSWRST + UCSSEL_2;
+    // Pulse LDAC low to move the new code to the DAC output
+    DAC_PORT_LDAC_OUT &= ~DAC_PIN_LDAC;
+    DAC_PORT_LDAC_OUT |= DAC_PIN_LDAC;
+}
+
+void DACInit(void)
+{
+    // LDAC and CS are GPIO outputs, both idle high
+    DAC_PORT_LDAC_SEL &= ~DAC_PIN_LDAC;
+    DAC_PORT_LDAC_DIR |= DAC_PIN_LDAC;
+    DAC_PORT_LDAC_OUT |= DAC_PIN_LDAC;
+
+    DAC_PORT_CS_SEL &= ~DAC_PIN_CS;
+    DAC_PORT_CS_DIR |= DAC_PIN_CS;
+    DAC_PORT_CS_OUT |= DAC_PIN_CS;
+
+    // MOSI and SCLK are shared with the LCD and set up by the bus.
+    // SMCLK, MSB first, capture on first edge, inactive low polarity.
+    SPIBus_Device dev;
+    dev.csOut = &DAC_PORT_CS_OUT;
+    dev.csPin = DAC_PIN_CS;
+    dev.csActiveHigh = 0;
+    dev.ctl0 = UCMSB | UCCKPH;
+    dev.clkTicks = DAC_SPI_CLK_TICKS;
+
+    SPIBus_init();
+    dacSpiDevice = SPIBus_registerDevice(&dev);
+
+    dacXfer.tx = dacFrame;
+    dacXfer.rx = 0;
+    dacXfer.len = 2;
+    dacXfer.device = dacSpiDevice;
+    dacXfer.priority = SPI_BUS_PRIO_HIGH;   // may cut in between LCD lines
+    dacXfer.state = SPI_XFER_IDLE;
+    dacXfer.done = dacLatch;
+}
+
+void DACSetValue(unsigned int dac_code)
+{
+    // Queues a 12 bit code for the DAC and returns without waiting.
+    // A sample still waiting in the queue is replaced by the newer one;
+    // if the previous sample is already being shifted out this one is
+    // dropped rather than stalling the caller.
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
 
-     UCB0BR0 = 2;   // SCLK = SMCLK/2 = 524288Hz
-     UCB0BR1 = 0;
+    if (dacXfer.state != SPI_XFER_ACTIVE) {
+        // Write to DAC A, unbuffered, 1x gain, output enabled
+        dac_code = (dac_code & 0x0FFF) | 0x3000;
+        dacFrame[0] = (uint8_t)(dac_code >> 8);
+        dacFrame[1] = (uint8_t)(dac_code & 0xFF);
 
-     //UCB0MCTL = 0;   // write MCTL as 0
+        if (dacXfer.state != SPI_XFER_QUEUED)
+            SPIBus_submit(&dacXfer);
+    }
 
-     // Enable UCSI A0
-     UCB0CTL1 &= ~UCSWRST;
+    __set_interrupt_state(intState);
 }
-*/
 
 //------------------------------------------------------------------------------
 // Timer1 A0 Interrupt Service Routine
@@ -263,9 +319,12 @@ void setupSPI_DAC(void)
 #pragma vector=TIMER1_A0_VECTOR
 __interrupt void TIMER1_A0_ISR (void)
 {
-	// Display is using Timer A1
-	// Not sure where Timer A1 is configured?
+	// Timer A1 runs continuously as the time base, so schedule the next toggle
+	ISR_PROBE_ENTER();
+	TA1CCR0 += VCOM_TOGGLE_TICKS;
 	Sharp96x96_SendToggleVCOMCommand();  // display needs this toggle < 1 per sec
+	                                     // only queues SPI work, never waits on the bus
+	ISR_PROBE_EXIT();
 }
 
 
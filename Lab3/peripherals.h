@@ -16,6 +16,8 @@
 
 #include "LcdDriver/Sharp96x96.h"
 #include "LcdDriver/HAL_MSP_EXP430FR5529_Sharp96x96.h"
+#include "spi_bus.h"
+#include "timebase.h"
 
 
 /*
@@ -55,18 +57,51 @@
  * The actual clock frequency is given in number of
  * ticks of the specified clock source.
  *
- * For our configuration, we use SMCLK */
+ * For our configuration, we use SMCLK.
+ * UCB0 is shared with the LCD, so these are handed to the SPI bus
+ * (spi_bus.h) as the DAC's device settings. */
 #define DAC_SPI_CLK_SRC		(UCSSEL__SMCLK)
 #define DAC_SPI_CLK_TICKS	0
 
+/*
+ * LCD VCOM toggle
+ * Timer A1 CCR0 fires every VCOM_TOGGLE_TICKS of the shared time base
+ * (timebase.h), i.e. once a second.
+ */
+#define VCOM_TOGGLE_TICKS		32768
+
+/*
+ * ISR timing probe
+ * With ISR_PROBE defined, P7.4 is driven high for as long as an
+ * instrumented ISR runs, so its duration and the latency it adds to
+ * other interrupts can be read off a scope or logic analyzer.
+ */
+//#define ISR_PROBE
+
+#define ISR_PROBE_PORT_SEL		P7SEL
+#define ISR_PROBE_PORT_DIR		P7DIR
+#define ISR_PROBE_PORT_OUT		P7OUT
+#define ISR_PROBE_PIN			BIT4
+
+#ifdef ISR_PROBE
+#define ISR_PROBE_INIT()		do { ISR_PROBE_PORT_SEL &= ~ISR_PROBE_PIN;	\
+									 ISR_PROBE_PORT_DIR |= ISR_PROBE_PIN;	\
+									 ISR_PROBE_PORT_OUT &= ~ISR_PROBE_PIN; } while (0)
+#define ISR_PROBE_ENTER()		(ISR_PROBE_PORT_OUT |= ISR_PROBE_PIN)
+#define ISR_PROBE_EXIT()		(ISR_PROBE_PORT_OUT &= ~ISR_PROBE_PIN)
+#else
+#define ISR_PROBE_INIT()
+#define ISR_PROBE_ENTER()
+#define ISR_PROBE_EXIT()
+#endif
+
 // Globals
 extern tContext g_sContext;	// user defined type used by graphics library
 
 // Prototypes for functions defined implemented in peripherals.c
 
-//void DACInit(void);
-//void DACSetValue(unsigned int dac_code);
-//void setupSPI_DAC(void);
+void DACInit(void);
+void DACSetValue(unsigned int dac_code);
 void initLeds(void);
 void setLeds(unsigned char state);
 
@@ -0,0 +1,195 @@
+/*
+ * rtc_clock.c
+ *
+ *  RTC_A calendar mode timekeeping. See rtc_clock.h.
+ */
+
+#include "rtc_clock.h"
+
+#ifdef HOST_BUILD
+// A PC has no interrupts to mask or low power mode to leave
+typedef unsigned int __istate_t;
+#define __get_interrupt_state()         0
+#define __disable_interrupt()
+#define __set_interrupt_state(s)        ((void)(s))
+#define __bic_SR_register_on_exit(x)
+
+RTCClock_Regs rtcSimRegs;
+#endif
+
+static volatile uint8_t events;
+
+
+#ifndef HOST_BUILD
+// Starts the 32768 Hz crystal on P5.4/P5.5 and waits for it to stabilise
+static void startXT1(void)
+{
+    P5SEL |= (BIT5 | BIT4);
+    UCSCTL6 &= ~XT1OFF;
+    UCSCTL6 |= XCAP_3;                  // internal load capacitance
+
+    do {
+        UCSCTL7 &= ~(XT2OFFG | XT1LFOFFG | DCOFFG);
+        SFRIFG1 &= ~OFIFG;
+    } while (SFRIFG1 & OFIFG);
+
+    UCSCTL6 &= ~XT1DRIVE_3;             // running, so drop to the lowest drive
+}
+#endif
+
+// Starts RTC_A in binary calendar mode at the given date and time and
+// enables the once-per-second and minute-changed interrupts
+void RTCClock_init(const CalendarTime *start)
+{
+#ifndef HOST_BUILD
+    startXT1();
+#endif
+
+    RTC_REG_CTL01 = RTCHOLD | RTCMODE | RTCSSEL_0 | RTCTEV_0;
+    events = 0;
+    RTCClock_set(start);
+    RTC_REG_CTL01 |= RTCRDYIE | RTCTEVIE;
+
+    // Report the starting time straight away
+    events = RTC_EVENT_SECOND | RTC_EVENT_MINUTE;
+}
+
+// Loads a new date and time. The calendar is held for the writes, so the
+// counters never carry between two fields.
+void RTCClock_set(const CalendarTime *t)
+{
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+
+    RTC_REG_CTL01 |= RTCHOLD;
+    RTC_REG_YEAR = t->year;
+    RTC_REG_MON = t->month;
+    RTC_REG_DAY = t->day;
+    RTC_REG_DOW = 0;
+    RTC_REG_HOUR = t->hours;
+    RTC_REG_MIN = t->minutes;
+    RTC_REG_SEC = t->seconds;
+    RTC_REG_CTL01 &= ~RTCHOLD;
+
+    __set_interrupt_state(intState);
+}
+
+// Reads a consistent snapshot of the calendar. If the seconds register
+// changes during the read, an update happened part way through, so the
+// registers are read again.
+void RTCClock_read(CalendarTime *t)
+{
+    uint8_t sec;
+
+    do {
+        sec = RTC_REG_SEC;
+        t->year = RTC_REG_YEAR;
+        t->month = RTC_REG_MON;
+        t->day = RTC_REG_DAY;
+        t->hours = RTC_REG_HOUR;
+        t->minutes = RTC_REG_MIN;
+        t->seconds = sec;
+    } while (RTC_REG_SEC != sec);
+}
+
+// Returns the RTC_EVENT_* bits posted since the last call and clears them
+uint8_t RTCClock_takeEvents(void)
+{
+    uint8_t taken;
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+    taken = events;
+    events = 0;
+    __set_interrupt_state(intState);
+
+    return taken;
+}
+
+#ifdef HOST_BUILD
+// RTCIV: the highest priority pending source, cleared by the read
+uint16_t RTCClock_simReadIV(void)
+{
+    if (rtcSimRegs.pendingIV & RTCRDYIFG) {
+        rtcSimRegs.pendingIV &= ~RTCRDYIFG;
+        return RTC_IV_RDY;
+    }
+    if (rtcSimRegs.pendingIV & RTCTEVIFG) {
+        rtcSimRegs.pendingIV &= ~RTCTEVIFG;
+        return RTC_IV_TEV;
+    }
+    return 0;
+}
+#endif
+
+//------------------------------------------------------------------------------
+// RTC_A Interrupt Service Routine
+//------------------------------------------------------------------------------
+#ifdef HOST_BUILD
+void RTC_ISR(void)
+#else
+#pragma vector=RTC_VECTOR
+__interrupt void RTC_ISR(void)
+#endif
+{
+    switch (RTC_REG_IV) {
+    case RTC_IV_RDY:                    // calendar registers updated, once per second
+        events |= RTC_EVENT_SECOND;
+        __bic_SR_register_on_exit(LPM3_bits);
+        break;
+    case RTC_IV_TEV:                    // minute changed
+        events |= RTC_EVENT_MINUTE;
+        __bic_SR_register_on_exit(LPM3_bits);
+        break;
+    default:
+        break;
+    }
+}
+
+#ifdef HOST_BUILD
+// One second of RTC_A: advance the counters unless held, raise the
+// interrupt flags and run the ISR for each enabled one
+void RTCClock_simTick(void)
+{
+    CalendarTime t;
+    uint8_t changed;
+
+    if (rtcSimRegs.ctl01 & RTCHOLD)
+        return;
+
+    t.year = rtcSimRegs.year;
+    t.month = rtcSimRegs.mon;
+    t.day = rtcSimRegs.day;
+    t.hours = rtcSimRegs.hour;
+    t.minutes = rtcSimRegs.min;
+    t.seconds = rtcSimRegs.sec;
+
+    changed = Calendar_advance(&t);
+
+    rtcSimRegs.year = t.year;
+    rtcSimRegs.mon = t.month;
+    rtcSimRegs.day = t.day;
+    rtcSimRegs.hour = t.hours;
+    rtcSimRegs.min = t.minutes;
+    rtcSimRegs.sec = t.seconds;
+    if (changed & CAL_CHANGED_DAY)
+        rtcSimRegs.dow = (rtcSimRegs.dow + 1) % 7;
+
+    rtcSimRegs.ctl01 |= RTCRDYIFG;
+    if (changed & CAL_CHANGED_MINUTE)
+        rtcSimRegs.ctl01 |= RTCTEVIFG;
+
+    if ((rtcSimRegs.ctl01 & RTCRDYIE) && (rtcSimRegs.ctl01 & RTCRDYIFG)) {
+        rtcSimRegs.ctl01 &= ~RTCRDYIFG;
+        rtcSimRegs.pendingIV |= RTCRDYIFG;
+    }
+    if ((rtcSimRegs.ctl01 & RTCTEVIE) && (rtcSimRegs.ctl01 & RTCTEVIFG)) {
+        rtcSimRegs.ctl01 &= ~RTCTEVIFG;
+        rtcSimRegs.pendingIV |= RTCTEVIFG;
+    }
+
+    while (rtcSimRegs.pendingIV)
+        RTC_ISR();
+}
+#endif
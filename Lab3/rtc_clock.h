@@ -0,0 +1,100 @@
+/*
+ * rtc_clock.h
+ *
+ *  Timekeeping on the RTC_A hardware calendar, as an alternative to
+ *  counting Timer A2 interrupts. RTC_A runs in calendar mode from the
+ *  32768 Hz XT1 crystal, so it keeps counting through LPM3 and while the
+ *  time is being edited. Its interrupt posts a once-per-second and a
+ *  minute-changed event and wakes the CPU from LPM3 for each of them.
+ *
+ *  Define HOST_BUILD to compile this module on a PC: the registers are
+ *  then fields of rtcSimRegs, and RTCClock_simTick() plays the part of
+ *  one second of the RTC_A hardware.
+ */
+
+#ifndef RTC_CLOCK_H_
+#define RTC_CLOCK_H_
+
+#include <stdint.h>
+#include "calendar.h"
+
+//*****************************************************************************
+//
+// Register layer
+//
+//*****************************************************************************
+
+#ifdef HOST_BUILD
+
+typedef struct RTCClock_Regs
+{
+    uint16_t ctl01;
+    uint8_t sec, min, hour, dow, day, mon;
+    uint16_t year;
+    uint16_t pendingIV;     // RTCIV sources still to be reported
+} RTCClock_Regs;
+
+extern RTCClock_Regs rtcSimRegs;
+
+uint16_t RTCClock_simReadIV(void);
+void RTCClock_simTick(void);
+
+#define RTC_REG_CTL01   rtcSimRegs.ctl01
+#define RTC_REG_SEC     rtcSimRegs.sec
+#define RTC_REG_MIN     rtcSimRegs.min
+#define RTC_REG_HOUR    rtcSimRegs.hour
+#define RTC_REG_DOW     rtcSimRegs.dow
+#define RTC_REG_DAY     rtcSimRegs.day
+#define RTC_REG_MON     rtcSimRegs.mon
+#define RTC_REG_YEAR    rtcSimRegs.year
+#define RTC_REG_IV      RTCClock_simReadIV()
+
+// RTCCTL01 bits, as in msp430f5529.h
+#define RTCBCD          (0x8000)
+#define RTCHOLD         (0x4000)
+#define RTCMODE         (0x2000)
+#define RTCRDY          (0x1000)
+#define RTCSSEL_0       (0x0000)
+#define RTCTEV_0        (0x0000)
+#define RTCTEVIE        (0x0040)
+#define RTCAIE          (0x0020)
+#define RTCRDYIE        (0x0010)
+#define RTCTEVIFG       (0x0004)
+#define RTCAIFG         (0x0002)
+#define RTCRDYIFG       (0x0001)
+
+#else
+
+#include <msp430.h>
+
+#define RTC_REG_CTL01   RTCCTL01
+#define RTC_REG_SEC     RTCSEC
+#define RTC_REG_MIN     RTCMIN
+#define RTC_REG_HOUR    RTCHOUR
+#define RTC_REG_DOW     RTCDOW
+#define RTC_REG_DAY     RTCDAY
+#define RTC_REG_MON     RTCMON
+#define RTC_REG_YEAR    RTCYEAR
+#define RTC_REG_IV      RTCIV
+
+#endif
+
+// RTCIV values
+#define RTC_IV_RDY      2
+#define RTC_IV_TEV      4
+
+//*****************************************************************************
+//
+// Events
+//
+//*****************************************************************************
+
+#define RTC_EVENT_SECOND    0x01    // the calendar registers advanced by one second
+#define RTC_EVENT_MINUTE    0x02    // ...and the minute changed
+
+void RTCClock_init(const CalendarTime *start);
+void RTCClock_set(const CalendarTime *t);
+void RTCClock_read(CalendarTime *t);
+uint8_t RTCClock_takeEvents(void);
+
+#endif /* RTC_CLOCK_H_ */
@@ -0,0 +1,66 @@
+/*
+ * sensor_conv.c
+ *
+ *  Fixed-point ADC conversions. See sensor_conv.h.
+ */
+
+#include "sensor_conv.h"
+
+// Datasheet values used when the TLV calibration words are blank
+#define NOMINAL_CAL_30C         2146    // 786 mV at 30 C against 1.5 V
+#define NOMINAL_SLOPE_Q16       67600L  // 1.03 tenths of a degree per count
+
+// 0.8 in Q16: F = C + 0.8 * C + 32 keeps the product inside 32 bits
+#define NINE_FIFTHS_FRAC_Q16    52429L
+
+static int32_t tempSlopeQ16 = NOMINAL_SLOPE_Q16;   // tenths of a degree C per count
+static int16_t tempCal30 = NOMINAL_CAL_30C;        // ADC count at 30 C
+
+
+// Rounds a Q16 value to the nearest integer, symmetrically about zero
+static int32_t roundQ16(int32_t x)
+{
+    if (x < 0)
+        return -((-x + 0x8000L) >> 16);
+    return (x + 0x8000L) >> 16;
+}
+
+// Precomputes the temperature slope from the factory calibration.
+// The one division here replaces the per-sample float math.
+void SensorConv_initTemp(void)
+{
+    uint16_t cal30 = CALADC12_15V_30C;
+    uint16_t cal85 = CALADC12_15V_85C;
+
+    if ((cal85 > cal30) && (cal85 != 0xFFFF)) {
+        tempSlopeQ16 = ((int32_t)(85 - 30) * 10 << 16) / (int32_t)(cal85 - cal30);
+        tempCal30 = cal30;
+    } else {
+        tempSlopeQ16 = NOMINAL_SLOPE_Q16;
+        tempCal30 = NOMINAL_CAL_30C;
+    }
+}
+
+// Temperature sensor count (1.5 V reference) to tenths of a degree C
+int16_t SensorConv_tempDeciC(uint16_t adc)
+{
+    int32_t delta = (int32_t)adc - tempCal30;
+
+    return (int16_t)(300 + roundQ16(delta * tempSlopeQ16));
+}
+
+// Tenths of a degree C to tenths of a degree F
+int16_t SensorConv_deciCtoDeciF(int16_t deciC)
+{
+    return (int16_t)(deciC + roundQ16((int32_t)deciC * NINE_FIFTHS_FRAC_Q16) + 320);
+}
+
+// ADC count to millivolts for the given VREF+.
+// x / 4095 is computed as (x + x / 4096) / 4096, which needs only shifts
+// and is within half a millivolt of the exact result across the range.
+uint16_t SensorConv_milliVolts(uint16_t adc, uint16_t vrefMilliVolts)
+{
+    uint32_t x = (uint32_t)adc * vrefMilliVolts;
+
+    return (uint16_t)((x + (x >> 12) + 2048) >> 12);
+}
@@ -0,0 +1,35 @@
+/*
+ * sensor_conv.h
+ *
+ *  Integer conversions from ADC12 counts to engineering units. The MSP430
+ *  has no FPU, so temperatures are kept in tenths of a degree and voltages
+ *  in millivolts, and every scale factor is precomputed as a Q16 constant
+ *  so a conversion is one hardware multiply and a shift.
+ */
+
+#ifndef SENSOR_CONV_H_
+#define SENSOR_CONV_H_
+
+#include <msp430.h>
+#include <stdint.h>
+
+// Temperature sensor calibration words in TLV, measured with the 1.5 V reference
+#ifndef CALADC12_15V_30C
+#define CALADC12_15V_30C *((unsigned int *)0x1A1A)
+#endif
+#ifndef CALADC12_15V_85C
+#define CALADC12_15V_85C *((unsigned int *)0x1A1C)
+#endif
+
+// Full scale of the 12 bit conversion
+#define SENSOR_ADC_FULL_SCALE   4095
+
+// AVCC on the launchpad, used as VREF+ for the voltmeter
+#define SENSOR_AVCC_MV          3300
+
+void SensorConv_initTemp(void);
+int16_t SensorConv_tempDeciC(uint16_t adc);
+int16_t SensorConv_deciCtoDeciF(int16_t deciC);
+uint16_t SensorConv_milliVolts(uint16_t adc, uint16_t vrefMilliVolts);
+
+#endif /* SENSOR_CONV_H_ */
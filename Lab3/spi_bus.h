@@ -0,0 +1,128 @@
+/*
+ * spi_bus.h
+ *
+ *  Arbiter for the USCI_B0 SPI port. The Sharp LCD, the DAC and the Lab 4
+ *  loopback master all share P3.0 (MOSI) and P3.2 (SCLK), so every access
+ *  to UCB0 goes through a transaction queue here instead of touching the
+ *  USCI registers directly.
+ *
+ *  Each device registers its chip select, clock phase/polarity and bit
+ *  rate divider once. Transactions are queued and shifted out back-to-back
+ *  from the USCI_B0 interrupt (or by DMA when SPI_BUS_USE_DMA is defined).
+ *  CS stays asserted for the whole transaction, so a multi-byte frame
+ *  costs one CS cycle, not one per byte.
+ *  A transaction is never split, so long streams such as an LCD flush are
+ *  queued one line per transaction: anything submitted at
+ *  SPI_BUS_PRIO_HIGH (e.g. DAC samples) is started at the next line
+ *  boundary ahead of the remaining lines.
+ */
+
+#ifndef SPI_BUS_H_
+#define SPI_BUS_H_
+
+#include <msp430.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Configuration
+//
+//*****************************************************************************
+
+// Move transactions with DMA instead of the USCI ISR: one channel from the
+// DMA manager (dma.h) feeds TXBUF and, for transactions that also receive,
+// another empties RXBUF
+//#define SPI_BUS_USE_DMA
+
+// Shortest transaction that is worth programming a DMA transfer for
+#define SPI_BUS_DMA_MIN_LEN     8
+
+#define SPI_BUS_MAX_DEVICES     4
+
+// Delay between the last clock edge and releasing CS. 16 cycles is 2us at
+// 8 MHz, which covers the Sharp LCD's thSCS.
+#define SPI_BUS_CS_HOLD_CYCLES  16
+
+#define SPI_BUS_REG_CTL0        UCB0CTL0
+#define SPI_BUS_REG_CTL1        UCB0CTL1
+#define SPI_BUS_REG_BRL         UCB0BR0
+#define SPI_BUS_REG_BRH         UCB0BR1
+#define SPI_BUS_REG_IE          UCB0IE
+#define SPI_BUS_REG_IFG         UCB0IFG
+#define SPI_BUS_REG_STAT        UCB0STAT
+#define SPI_BUS_REG_TXBUF       UCB0TXBUF
+#define SPI_BUS_REG_RXBUF       UCB0RXBUF
+
+#define SPI_BUS_PORT_SEL        P3SEL
+#define SPI_BUS_PIN_MOSI        BIT0
+#define SPI_BUS_PIN_SCLK        BIT2
+
+// DMA trigger numbers of UCB0TXIFG and UCB0RXIFG on the F5529
+#define SPI_BUS_DMA_TRIGGER     19
+#define SPI_BUS_DMA_RX_TRIGGER  18
+
+//*****************************************************************************
+//
+// Types
+//
+//*****************************************************************************
+
+// Transaction priorities. Higher priorities are started first at the next
+// transaction boundary; equal priorities run in submission order.
+#define SPI_BUS_PRIO_NORMAL     0
+#define SPI_BUS_PRIO_HIGH       1
+
+// Transaction states
+#define SPI_XFER_IDLE           0
+#define SPI_XFER_QUEUED         1
+#define SPI_XFER_ACTIVE         2
+#define SPI_XFER_DONE           3
+
+// Returned by SPIBus_registerDevice when the device table is full
+#define SPI_BUS_NO_DEVICE       0xFF
+
+typedef struct SPIBus_Device
+{
+    volatile uint8_t *csOut;    // PxOUT register holding the chip select
+    uint8_t csPin;              // chip select bit in csOut
+    uint8_t csActiveHigh;       // 1 for the Sharp LCD's SCS, 0 for the DAC
+    uint8_t ctl0;               // UCCKPH, UCCKPL and UCMSB bits for this device
+    uint16_t clkTicks;          // SMCLK divider loaded into UCB0BRW
+} SPIBus_Device;
+
+typedef struct SPIBus_Xfer SPIBus_Xfer;
+
+// Completion callback. Runs in interrupt context once CS has been released;
+// it may resubmit the same transaction (e.g. to send the next LCD line).
+typedef void (*SPIBus_Callback)(SPIBus_Xfer *xfer);
+
+struct SPIBus_Xfer
+{
+    SPIBus_Xfer *next;          // queue link, owned by the bus
+    const uint8_t *tx;          // bytes to send, or NULL to send zeros
+    uint8_t *rx;                // buffer for received bytes, or NULL
+    uint16_t len;               // number of bytes in the frame
+    uint8_t device;             // handle from SPIBus_registerDevice
+    uint8_t priority;           // SPI_BUS_PRIO_*
+    volatile uint8_t state;     // SPI_XFER_*
+    SPIBus_Callback done;       // optional completion callback
+    void *arg;                  // free for the submitter's use
+};
+
+//*****************************************************************************
+//
+// Prototypes
+//
+//*****************************************************************************
+
+void SPIBus_init(void);
+uint8_t SPIBus_registerDevice(const SPIBus_Device *device);
+void SPIBus_setClock(uint8_t device, uint16_t clkTicks);
+
+void SPIBus_submit(SPIBus_Xfer *xfer);
+void SPIBus_wait(SPIBus_Xfer *xfer);
+void SPIBus_transfer(SPIBus_Xfer *xfer);
+uint8_t SPIBus_isBusy(const SPIBus_Xfer *xfer);
+uint8_t SPIBus_isIdle(void);
+
+#endif /* SPI_BUS_H_ */
@@ -0,0 +1,173 @@
+/*
+ * swtimer.c
+ *
+ *  Deadline-sorted software timers on Timer A1 CCR1. See swtimer.h.
+ */
+
+#include "swtimer.h"
+
+static SWTimer *head = 0;              // nearest deadline first
+static uint8_t initialized = 0;
+
+
+// Ticks from now until deadline, negative once it has passed. Valid while
+// every deadline is within 2^31 ticks of the present.
+static int32_t ticksUntil(uint32_t deadline, uint32_t now)
+{
+    return (int32_t)(deadline - now);
+}
+
+// Links a timer in behind every timer due at or before it. Called with
+// interrupts disabled.
+static void insert(SWTimer *timer)
+{
+    SWTimer **link = &head;
+
+    while (*link && ((int32_t)((*link)->deadline - timer->deadline) <= 0))
+        link = &(*link)->next;
+
+    timer->next = *link;
+    *link = timer;
+}
+
+// Unlinks a timer if it is in the list. Called with interrupts disabled.
+static void unlink(SWTimer *timer)
+{
+    SWTimer **link = &head;
+
+    while (*link) {
+        if (*link == timer) {
+            *link = timer->next;
+            break;
+        }
+        link = &(*link)->next;
+    }
+    timer->next = 0;
+}
+
+// Points CCR1 at the nearest deadline. CCR1 only holds the low 16 bits,
+// so a deadline more than one timer period away matches early; service()
+// then finds nothing due and leaves the compare armed for the next match.
+// Called with interrupts disabled.
+static void arm(void)
+{
+    if (head == 0) {
+        TA1CCTL1 = 0;
+        return;
+    }
+
+    TA1CCR1 = (uint16_t)head->deadline;
+    TA1CCTL1 = CCIE;
+
+    // Too close to trust the compare: raise the interrupt by hand
+    if (ticksUntil(head->deadline, Timebase_ticks()) < SWTIMER_MIN_TICKS)
+        TA1CCTL1 |= CCIFG;
+}
+
+// CCR1 handler: expires everything that is due and rearms for the rest
+static uint8_t service(void)
+{
+    uint32_t now = Timebase_ticks();
+    uint8_t fired = 0;
+    SWTimer *timer;
+
+    while (head && (ticksUntil(head->deadline, now) <= 0)) {
+        timer = head;
+        head = timer->next;
+        timer->next = 0;
+
+        timer->expired = 1;
+        fired = 1;
+
+        // Requeue before the callback so it can stop or restart the timer
+        if (timer->period) {
+            timer->deadline += timer->period;
+            insert(timer);
+        } else {
+            timer->running = 0;
+        }
+
+        if (timer->callback)
+            timer->callback(timer);
+    }
+
+    arm();
+    return fired;
+}
+
+// Starts the time base and takes over Timer A1 CCR1. Only the first call
+// does anything.
+void SWTimer_init(void)
+{
+    if (initialized)
+        return;
+
+    Timebase_init();
+    head = 0;
+    TA1CCTL1 = 0;
+    Timebase_setCompareHandler(service);
+    initialized = 1;
+}
+
+// (Re)starts a timer: it first expires delayTicks from now, then every
+// periodTicks, or only once if periodTicks is 0. Callable from interrupts.
+void SWTimer_start(SWTimer *timer, uint32_t delayTicks, uint32_t periodTicks)
+{
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+
+    if (timer->running)
+        unlink(timer);
+
+    timer->deadline = Timebase_ticks() + delayTicks;
+    timer->period = periodTicks;
+    timer->expired = 0;
+    timer->running = 1;
+    insert(timer);
+
+    if (head == timer)
+        arm();
+
+    __set_interrupt_state(intState);
+}
+
+void SWTimer_startMs(SWTimer *timer, uint32_t delayMs, uint32_t periodMs)
+{
+    SWTimer_start(timer, TIMEBASE_MS_TO_TICKS(delayMs), TIMEBASE_MS_TO_TICKS(periodMs));
+}
+
+// Cancels a timer. Its expired flag is left as it was.
+void SWTimer_stop(SWTimer *timer)
+{
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+
+    if (timer->running) {
+        uint8_t wasHead = (head == timer);
+
+        unlink(timer);
+        timer->running = 0;
+        if (wasHead)
+            arm();
+    }
+
+    __set_interrupt_state(intState);
+}
+
+uint8_t SWTimer_isRunning(const SWTimer *timer)
+{
+    return timer->running;
+}
+
+// Returns 1 once for every time the timer has expired since the last call
+// (expiries in between are merged)
+uint8_t SWTimer_expired(SWTimer *timer)
+{
+    if (!timer->expired)
+        return 0;
+
+    timer->expired = 0;
+    return 1;
+}
@@ -0,0 +1,206 @@
+/*
+ * telemetry.c
+ *
+ *  Double-buffered telemetry packets sent by DMA. See telemetry.h.
+ */
+
+#include "telemetry.h"
+#include "dma.h"
+#include "crc16.h"
+#include "timebase.h"
+
+#define MAX_PACKET      TELEMETRY_PACKET_LEN(TELEMETRY_MAX_RECORDS)
+
+static uint8_t buffers[2][MAX_PACKET];
+static uint8_t counts[2];               // records in each half
+static uint8_t filling;                 // half that records go into
+static volatile uint8_t sending;        // the DMA owns the other half
+static uint8_t seq;
+static uint16_t dropped;
+static uint8_t paused;
+static uint8_t txChannel = DMA_NO_CHANNEL;
+
+static const uint8_t *queued;           // packet from Telemetry_send waiting for the DMA
+static uint16_t queuedLen;
+static uint8_t sendingQueued;           // the DMA is sending it
+static volatile uint8_t queuedBusy;     // queued or on the wire
+
+
+// Hands a packet to the DMA. Called with interrupts disabled, not sending.
+static void startDma(const uint8_t *packet, uint16_t len)
+{
+    // The trigger is the rising edge of UCTXIFG. Once TXBUF is empty (at
+    // most one byte time after the last packet or debug print) toggle the
+    // flag to give the first byte its edge.
+    while (!(TELEMETRY_REG_IFG & UCTXIFG))
+        ;
+    sending = 1;
+    DMA_start(txChannel, packet, &TELEMETRY_REG_TXBUF, len,
+              DMADT_0 | DMASRCINCR_3 | DMADSTINCR_0 | DMASRCBYTE | DMADSTBYTE | DMAIE);
+    TELEMETRY_REG_IFG &= ~UCTXIFG;
+    TELEMETRY_REG_IFG |= UCTXIFG;
+}
+
+// Seals the half being filled and sends it, then starts filling the
+// other one. Called with interrupts disabled, not sending.
+static void startSend(void)
+{
+    uint8_t *packet = buffers[filling];
+    uint8_t n = counts[filling];
+    uint16_t len = TELEMETRY_PACKET_LEN(n);
+    uint16_t crc;
+
+    packet[0] = TELEMETRY_SYNC1;
+    packet[1] = TELEMETRY_SYNC2;
+    packet[2] = seq++;
+    packet[3] = n;
+
+    crc = CRC16_compute(&packet[2], len - 4);
+    packet[len - 2] = crc >> 8;
+    packet[len - 1] = crc & 0xFF;
+
+    startDma(packet, len);
+
+    filling ^= 1;
+    counts[filling] = 0;
+}
+
+// Sends the packet queued by Telemetry_send. Called with interrupts
+// disabled, not sending.
+static void startQueued(void)
+{
+    sendingQueued = 1;
+    startDma(queued, queuedLen);
+    queued = 0;
+}
+
+// DMA completion: the last byte of the packet is in TXBUF. A queued
+// packet goes next, then anything that was recorded meanwhile.
+static uint8_t sendDone(uint8_t channel)
+{
+    sending = 0;
+    if (sendingQueued) {
+        sendingQueued = 0;
+        queuedBusy = 0;
+    }
+
+    if (queued)
+        startQueued();
+    else if (counts[filling])
+        startSend();
+
+    return 0;
+}
+
+
+// Takes a DMA channel on the UCA1 transmit trigger. The UART must already
+// be set up by DebugUart_init. Returns 0 if no channel is free.
+uint8_t Telemetry_init(void)
+{
+    counts[0] = 0;
+    counts[1] = 0;
+    filling = 0;
+    sending = 0;
+    seq = 0;
+    dropped = 0;
+    paused = 0;
+    queued = 0;
+    sendingQueued = 0;
+    queuedBusy = 0;
+
+    if (txChannel == DMA_NO_CHANNEL)
+        txChannel = DMA_alloc(DMA_TRIGGER_UCA1TX, DMA_PRIO_LOW, sendDone);
+
+    return (txChannel != DMA_NO_CHANNEL);
+}
+
+// Adds a record stamped with the time base, and starts a packet if the
+// DMA is idle. Never waits. Callable from interrupts.
+void Telemetry_record(uint8_t channel, int32_t value)
+{
+    uint32_t ticks = Timebase_ticks();
+    __istate_t intState;
+    uint8_t *r;
+
+    if ((txChannel == DMA_NO_CHANNEL) || paused)
+        return;
+
+    intState = __get_interrupt_state();
+    __disable_interrupt();
+
+    if (counts[filling] >= TELEMETRY_MAX_RECORDS) {
+        dropped++;
+    } else {
+        r = &buffers[filling][TELEMETRY_HEADER_LEN + counts[filling] * TELEMETRY_RECORD_LEN];
+        r[0] = ticks & 0xFF;
+        r[1] = (ticks >> 8) & 0xFF;
+        r[2] = (ticks >> 16) & 0xFF;
+        r[3] = ticks >> 24;
+        r[4] = channel;
+        r[5] = value & 0xFF;
+        r[6] = (value >> 8) & 0xFF;
+        r[7] = (value >> 16) & 0xFF;
+        r[8] = (value >> 24) & 0xFF;
+        counts[filling]++;
+
+        if (!sending)
+            startSend();
+    }
+
+    __set_interrupt_state(intState);
+}
+
+// Stops taking records and waits until the queued ones have left the
+// UART, so text can be written with DebugUart_print without landing
+// inside a packet
+void Telemetry_pause(void)
+{
+    paused = 1;
+
+    while (sending || counts[filling] || queuedBusy) {
+        if (!(__get_SR_register() & GIE))
+            DMA_service();
+    }
+
+    while (TELEMETRY_REG_STAT & UCBUSY)
+        ;
+}
+
+void Telemetry_resume(void)
+{
+    paused = 0;
+}
+
+uint16_t Telemetry_dropped(void)
+{
+    return dropped;
+}
+
+// Queues a complete packet, which must stay untouched until
+// Telemetry_sendIdle() returns 1. Never waits. Returns 0, sending
+// nothing, if the previous one has not gone yet or telemetry is paused.
+uint8_t Telemetry_send(const uint8_t *packet, uint16_t len)
+{
+    __istate_t intState;
+
+    if (!Telemetry_sendIdle())
+        return 0;
+
+    intState = __get_interrupt_state();
+    __disable_interrupt();
+
+    queuedBusy = 1;
+    queued = packet;
+    queuedLen = len;
+    if (!sending)
+        startQueued();
+
+    __set_interrupt_state(intState);
+    return 1;
+}
+
+// Returns 1 when Telemetry_send would take a packet
+uint8_t Telemetry_sendIdle(void)
+{
+    return (txChannel != DMA_NO_CHANNEL) && !paused && !queuedBusy;
+}
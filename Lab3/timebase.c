@@ -0,0 +1,120 @@
+/*
+ * timebase.c
+ *
+ *  Timer A1 free-running ACLK counter with overflow extension. See timebase.h.
+ */
+
+#include "timebase.h"
+
+static volatile uint32_t overflows = 0;     // upper bits of the tick count
+static uint8_t initialized = 0;
+static Timebase_CompareHandler compareHandler = 0;
+
+
+// Takes a consistent snapshot of the extended count. ACLK is asynchronous
+// to MCLK, so TA1R is read until two reads agree. An overflow that has
+// happened but whose interrupt has not run yet is folded in here.
+static void snapshot(uint32_t *high, uint16_t *low)
+{
+    uint16_t count;
+    uint32_t ovf;
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+
+    do {
+        count = TA1R;
+    } while (count != TA1R);
+
+    ovf = overflows;
+    if ((TA1CTL & TAIFG) && (count < 0x8000))
+        ovf++;
+
+    __set_interrupt_state(intState);
+
+    *high = ovf;
+    *low = count;
+}
+
+// Starts Timer A1 counting ACLK in continuous mode. Only the first call
+// does anything, so every driver that needs time can call it.
+void Timebase_init(void)
+{
+    if (initialized)
+        return;
+
+    overflows = 0;
+    TA1CTL = TASSEL__ACLK | ID_0 | MC__CONTINUOUS | TACLR | TAIE;
+    initialized = 1;
+}
+
+// Installs the CCR1 handler. The owner programs TA1CCR1 and TA1CCTL1 itself.
+void Timebase_setCompareHandler(Timebase_CompareHandler handler)
+{
+    compareHandler = handler;
+}
+
+uint32_t Timebase_ticks(void)
+{
+    uint32_t high;
+    uint16_t low;
+
+    snapshot(&high, &low);
+    return (high << 16) | low;
+}
+
+uint64_t Timebase_ticks64(void)
+{
+    uint32_t high;
+    uint16_t low;
+
+    snapshot(&high, &low);
+    return ((uint64_t)high << 16) | low;
+}
+
+// Whole seconds: the tick count divided by 32768, done with shifts
+uint32_t Timebase_seconds(void)
+{
+    uint32_t high;
+    uint16_t low;
+
+    snapshot(&high, &low);
+    return (high << 1) | (low >> 15);
+}
+
+uint32_t now_ms(void)
+{
+    uint32_t high;
+    uint16_t low;
+
+    snapshot(&high, &low);
+    return high * 2000UL + (((uint32_t)low * 125UL) >> 12);
+}
+
+uint32_t now_us(void)
+{
+    uint32_t high;
+    uint16_t low;
+
+    snapshot(&high, &low);
+    return high * 2000000UL + (((uint32_t)low * 15625UL) >> 9);
+}
+
+//------------------------------------------------------------------------------
+// Timer1 A1 Interrupt Service Routine (CCR1, CCR2 and overflow)
+//------------------------------------------------------------------------------
+#pragma vector=TIMER1_A1_VECTOR
+__interrupt void TIMER1_A1_ISR(void)
+{
+    switch (TA1IV) {
+    case TA1IV_TACCR1:
+        if (compareHandler && compareHandler())
+            __bic_SR_register_on_exit(LPM3_bits);
+        break;
+    case TA1IV_TAIFG:
+        overflows++;
+        break;
+    default:
+        break;
+    }
+}
@@ -60,6 +60,11 @@
 #include "grlib.h"
 #include "Sharp96x96.h"
 #include "HAL_MSP_EXP430FR5529_Sharp96x96.h"
+#include "spi_bus.h"
+#include "dma.h"
+#ifdef LCD_MIRROR
+#include "lcd_mirror.h"
+#endif
 
 static void Sharp96x96_InitializeDisplayBuffer(void *pvDisplayData, uint8_t ucValue);
 
@@ -92,6 +97,19 @@ uint8_t DisplayBuffer[LCD_VERTICAL_MAX +32][LCD_HORIZONTAL_MAX/8];
 uint8_t VCOMbit= 0x40;
 uint8_t flagSendToggleVCOMCommand = 0;
 
+// Command byte, line address, one line of pixels and two trailer bytes
+#define SHARP_LINE_FRAME_SIZE	((LCD_HORIZONTAL_MAX>>3) + 4)
+
+static uint8_t lineBuffer[SHARP_LINE_FRAME_SIZE];
+static volatile uint8_t flushLine;
+static SPIBus_Xfer lcdLineXfer;
+
+static uint8_t lcdCmdBuffer[2];
+static SPIBus_Xfer lcdCmdXfer;
+
+static uint8_t vcomBuffer[2];
+static SPIBus_Xfer vcomXfer;
+
 //*******************************************************************************
 //
 //! Reverses the bit order.- Since the bit reversal function is called
@@ -516,6 +534,68 @@ static uint32_t Sharp96x96_ColorTranslate(void *pvDisplayData,
 }
 
 
+//*****************************************************************************
+//
+//! Copies one line of DisplayBuffer into the line frame.
+//!
+//! \param ucLine is the zero-based line to load.
+//!
+//! The frame holds the write-line command (with the current VCOM bit), the
+//! line address, the line's pixels and the two trailer bytes, so a single
+//! line can be sent as one complete SPI transaction.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void Sharp96x96_LoadLine(uint8_t ucLine)
+{
+	uint8_t *pucFrame = lineBuffer;
+	const uint8_t *pucData;
+	uint8_t xi;
+
+	//image update mode(1X000000b) with the COM inversion bit
+	*pucFrame++ = SHARP_LCD_CMD_WRITE_LINE ^ VCOMbit;
+	*pucFrame++ = reverse(ucLine + 1);
+
+#ifdef LANDSCAPE_FLIP
+	pucData = &DisplayBuffer[LCD_VERTICAL_MAX-1-ucLine][(LCD_HORIZONTAL_MAX>>3)-1];
+	for(xi=0; xi<(LCD_HORIZONTAL_MAX>>3); xi++)
+	{
+		*pucFrame++ = reverse(*pucData--);
+	}
+#else
+	pucData = &DisplayBuffer[ucLine][0];
+	for(xi=0; xi<(LCD_HORIZONTAL_MAX>>3); xi++)
+	{
+		*pucFrame++ = *pucData++;
+	}
+#endif
+
+	*pucFrame++ = SHARP_LCD_TRAILER_BYTE;
+	*pucFrame = SHARP_LCD_TRAILER_BYTE;
+}
+
+//*****************************************************************************
+//
+//! Completion callback for a flushed line.
+//!
+//! \param xfer is the line transaction that just finished.
+//!
+//! Runs from the SPI bus interrupt. Reloads the frame with the next line and
+//! queues it again, until the whole buffer has been sent.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void Sharp96x96_LineDone(SPIBus_Xfer *xfer)
+{
+	if(++flushLine < LCD_VERTICAL_MAX)
+	{
+		Sharp96x96_LoadLine(flushLine);
+		SPIBus_submit(xfer);
+	}
+}
+
 //*****************************************************************************
 //
 //! Flushes any cached drawing operations.
@@ -533,57 +613,28 @@ static uint32_t Sharp96x96_ColorTranslate(void *pvDisplayData,
 //*****************************************************************************
 void Sharp96x96_Flush (void *pvDisplayData)
 {
-	uint8_t *pucData = &DisplayBuffer[0][0];
-	int32_t xi =0;
-	int32_t xj = 0;
-	//image update mode(1X000000b)
-	uint8_t command = SHARP_LCD_CMD_WRITE_LINE;
+	// Lines go out as separate bus transactions so that higher priority
+	// SPI traffic (DAC samples) can run between them
+	SPIBus_wait(&lcdLineXfer);
 
-	//COM inversion bit
-	command = command^VCOMbit;
+	flushLine = 0;
+	Sharp96x96_LoadLine(flushLine);
 
-	AssertCS();
+	lcdLineXfer.tx = lineBuffer;
+	lcdLineXfer.rx = 0;
+	lcdLineXfer.len = SHARP_LINE_FRAME_SIZE;
+	lcdLineXfer.device = lcdSpiDevice;
+	lcdLineXfer.priority = SPI_BUS_PRIO_NORMAL;
+	lcdLineXfer.done = Sharp96x96_LineDone;
 
-	WriteCmdData(command);
 	flagSendToggleVCOMCommand = SHARP_SKIP_TOGGLE_VCOM_COMMAND;
-#ifdef LANDSCAPE
-	for(xj=0; xj<LCD_VERTICAL_MAX; xj++)
-		{
-		  WriteCmdData(reverse(xj + 1));
-
-		  for(xi=0; xi<(LCD_HORIZONTAL_MAX>>3); xi++)
-		  {
-			WriteCmdData(*(pucData++));
-		  }
-		  WriteCmdData(SHARP_LCD_TRAILER_BYTE);
-		}
-
+	SPIBus_transfer(&lcdLineXfer);
 
+#ifdef LCD_MIRROR
+	// SPIBus_transfer has waited for the last line, so the mirror's
+	// encoding adds to the time of every flush
+	LcdMirror_flush(&DisplayBuffer[0][0]);
 #endif
-#ifdef LANDSCAPE_FLIP
-	pucData = &DisplayBuffer[LCD_VERTICAL_MAX-1][(LCD_HORIZONTAL_MAX>>3)-1];
-
-	for(xj=1; xj<=LCD_VERTICAL_MAX; xj++)
-	{
-		WriteCmdData(reverse(xj));
-
-	  for(xi=0; xi < (LCD_HORIZONTAL_MAX>>3); xi++)
-	  {
-		WriteCmdData(reverse(*pucData--));
-	  }
-	  WriteCmdData(SHARP_LCD_TRAILER_BYTE);
-	}
-#endif
-
-	WriteCmdData(SHARP_LCD_TRAILER_BYTE);
-
-	// Wait for last byte to be sent, then drop SCS
-	WaitUntilLcdWriteFinished();
-
-    // Ensure a 2us min delay to meet the LCD's thSCS
-    __delay_cycles(SYSTEM_CLOCK_SPEED * 0.000002);
-
-	DeassertCS();
 }
 
 //*****************************************************************************
@@ -602,23 +653,19 @@ void Sharp96x96_Flush (void *pvDisplayData)
 void Sharp96x96_ClearScreen (void *pvDisplayData, uint16_t ulValue)
 {
 	//clear screen mode(0X100000b)
-	uint8_t command = SHARP_LCD_CMD_CLEAR_SCREEN;
-	//COM inversion bit
-	command = command^VCOMbit;
+	lcdCmdBuffer[0] = SHARP_LCD_CMD_CLEAR_SCREEN ^ VCOMbit;
+	lcdCmdBuffer[1] = SHARP_LCD_TRAILER_BYTE;
 
-	AssertCS();
+	lcdCmdXfer.tx = lcdCmdBuffer;
+	lcdCmdXfer.rx = 0;
+	lcdCmdXfer.len = 2;
+	lcdCmdXfer.device = lcdSpiDevice;
+	lcdCmdXfer.priority = SPI_BUS_PRIO_NORMAL;
+	lcdCmdXfer.done = 0;
 
-	WriteCmdData(command);
 	flagSendToggleVCOMCommand = SHARP_SKIP_TOGGLE_VCOM_COMMAND;
-	WriteCmdData(SHARP_LCD_TRAILER_BYTE);
-
-	// Wait for last byte to be sent, then drop SCS
-	WaitUntilLcdWriteFinished();
+	SPIBus_transfer(&lcdCmdXfer);
 
-	// Ensure a 2us min delay to meet the LCD's thSCS
-	__delay_cycles(SYSTEM_CLOCK_SPEED * 0.000002);
-
-	DeassertCS();
 	if(ClrBlack == ulValue)
 	Sharp96x96_InitializeDisplayBuffer(pvDisplayData, SHARP_BLACK);
 	else
@@ -640,25 +687,31 @@ void Sharp96x96_SendToggleVCOMCommand()
 {
 	VCOMbit ^= SHARP_VCOM_TOGGLE_BIT;
 
-	if(SHARP_SEND_TOGGLE_VCOM_COMMAND == flagSendToggleVCOMCommand)
+	// This is called from the Timer1 A0 ISR, so it never waits on the SPI
+	// bus. A flush in progress folds the new VCOM bit into the next line
+	// it loads. Otherwise a 2 byte VCOM frame is queued and sent once the
+	// bus is free.
+	if((SHARP_SEND_TOGGLE_VCOM_COMMAND == flagSendToggleVCOMCommand) &&
+	   !SPIBus_isBusy(&lcdLineXfer))
 	{
-		//clear screen mode(0X100000b)
-		uint8_t command = SHARP_LCD_CMD_CHANGE_VCOM;
-		//COM inversion bit
-		command = command^VCOMbit;
-
-	    AssertCS();
-
-		WriteCmdData(command);
-		WriteCmdData(SHARP_LCD_TRAILER_BYTE);
-
-		// Wait for last byte to be sent, then drop SCS
-		WaitUntilLcdWriteFinished();
-
-		// Ensure a 2us min delay to meet the LCD's thSCS
-		__delay_cycles(SYSTEM_CLOCK_SPEED * 0.000002);
+		if(vcomXfer.state != SPI_XFER_ACTIVE)
+		{
+			//change VCOM mode(0X000000b)
+			vcomBuffer[0] = SHARP_LCD_CMD_CHANGE_VCOM ^ VCOMbit;
+			vcomBuffer[1] = SHARP_LCD_TRAILER_BYTE;
+		}
 
-		DeassertCS();
+		if(!SPIBus_isBusy(&vcomXfer))
+		{
+			vcomXfer.tx = vcomBuffer;
+			vcomXfer.rx = 0;
+			vcomXfer.len = 2;
+			vcomXfer.device = lcdSpiDevice;
+			vcomXfer.priority = SPI_BUS_PRIO_NORMAL;
+			vcomXfer.done = 0;
+
+			SPIBus_submit(&vcomXfer);
+		}
 	}
 
 	flagSendToggleVCOMCommand = SHARP_SEND_TOGGLE_VCOM_COMMAND;
@@ -681,7 +734,6 @@ void Sharp96x96_SendToggleVCOMCommand()
 //*****************************************************************************
 static void Sharp96x96_InitializeDisplayBuffer(void *pvDisplayData, uint8_t ucValue)
 {
-	uint16_t i=0,j=0;
 	uint8_t *pucData = pvDisplayData;
 
 
@@ -691,9 +743,8 @@ static void Sharp96x96_InitializeDisplayBuffer(void *pvDisplayData, uint8_t ucVa
 	InitializeDisplayBuffer(pvDisplayData, ucValue);
 
 #else
-	for(i =0; i< LCD_VERTICAL_MAX; i++)
-	for(j =0; j< (LCD_HORIZONTAL_MAX>>3); j++)
-		*pucData++ = ucValue;
+	// One DMA block fill of the whole buffer
+	DMA_memset(pucData, ucValue, LCD_VERTICAL_MAX * (LCD_HORIZONTAL_MAX>>3));
 
 #endif //USE_FLASH_BUFFER
 }
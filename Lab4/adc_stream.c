@@ -0,0 +1,174 @@
+/*
+ * adc_stream.c
+ *
+ *  Timer-triggered, interrupt-driven ADC12_A sampling. See adc_stream.h.
+ */
+
+#include "adc_stream.h"
+
+static uint16_t blocks[2][ADC_STREAM_BLOCK_SAMPLES];
+static uint16_t *fillBlock = blocks[0];         // half the ISR is writing
+static const uint16_t * volatile readyBlock;    // last completed half
+static volatile uint8_t blockPending;           // readyBlock not yet fetched
+static uint16_t fillIndex;
+static uint16_t blockSamples;
+
+static volatile uint16_t latest[ADC_STREAM_MAX_CHANNELS];
+static uint8_t numChannels;
+static uint8_t blockLen;
+static ADCStream_ReadyCallback readyCallback;
+static volatile unsigned long overruns;
+
+
+// Starts sampling with the given sequence. Returns 0 if the configuration
+// does not fit the buffers, 1 once the stream is running.
+uint8_t ADCStream_start(const ADCStream_Config *config)
+{
+    volatile uint8_t *mctl = &ADC12MCTL0;
+    unsigned long conversionsPerSec;
+    unsigned long ticks;
+    uint16_t timerClock;
+    uint8_t i;
+
+    if ((config->numChannels == 0) || (config->numChannels > ADC_STREAM_MAX_CHANNELS) ||
+        (config->blockLen == 0) || (config->rateHz == 0) ||
+        ((uint16_t)config->numChannels * config->blockLen > ADC_STREAM_BLOCK_SAMPLES))
+        return 0;
+
+    ADCStream_stop();
+
+    numChannels = config->numChannels;
+    blockLen = config->blockLen;
+    blockSamples = (uint16_t)numChannels * blockLen;
+    readyCallback = config->ready;
+    fillBlock = blocks[0];
+    readyBlock = 0;
+    blockPending = 0;
+    fillIndex = 0;
+    overruns = 0;
+
+    // Reference: the ADC12 controls it when REFMSTR is cleared
+    REFCTL0 &= ~REFMSTR;
+    // Same sample-and-hold time for MEM0-7 (SHT0) and MEM8-15 (SHT1)
+    ADC12CTL0 = config->sampleTime | (config->sampleTime << 4) | ADC12ON | ADC12OVIE | ADC12TOVIE;
+    if (config->reference == ADC_STREAM_REF_1_5V)
+        ADC12CTL0 |= ADC12REFON;
+    else if (config->reference == ADC_STREAM_REF_2_5V)
+        ADC12CTL0 |= ADC12REFON | ADC12REF2_5V;
+
+    // Sample timer (SHP), triggered by TA0.1, repeat-sequence from MEM0.
+    // MSC is left clear so every trigger edge converts exactly one channel.
+    ADC12CTL1 = ADC12CSTARTADD_0 | ADC12SHS_1 | ADC12SHP | ADC12SSEL_0 | ADC12CONSEQ_3;
+    ADC12CTL2 = ADC12RES_2;
+
+    for (i = 0; i < numChannels; i++)
+        mctl[i] = config->channels[i];
+    mctl[numChannels - 1] |= ADC12EOS;
+
+    // Only the end of the sequence interrupts; MEM0..n-1 are read together
+    ADC12IFG = 0;
+    ADC12IE = 1 << (numChannels - 1);
+
+    // Trigger period: ACLK is exact, SMCLK is used above 2 kHz conversions
+    conversionsPerSec = (unsigned long)config->rateHz * numChannels;
+    if (conversionsPerSec <= ADC_STREAM_ACLK_HZ / 16) {
+        timerClock = TASSEL__ACLK;
+        ticks = ADC_STREAM_ACLK_HZ / conversionsPerSec;
+    } else {
+        timerClock = TASSEL__SMCLK;
+        ticks = ADC_STREAM_SMCLK_HZ / conversionsPerSec;
+    }
+    if (ticks < 2)
+        ticks = 2;
+    if (ticks > 65536UL)
+        ticks = 65536UL;
+
+    TA0CCR0 = (uint16_t)(ticks - 1);
+    TA0CCR1 = (uint16_t)(ticks / 2);
+    TA0CCTL1 = OUTMOD_3;                // set at CCR1, reset at CCR0: one rising edge per period
+
+    __delay_cycles(100);                // delay to allow Ref to settle
+    ADC12CTL0 |= ADC12ENC;              // Enable conversion
+
+    TA0CTL = timerClock | ID_0 | MC_1 | TACLR;
+
+    return 1;
+}
+
+// Stops the trigger timer and the ADC after the conversion in progress
+void ADCStream_stop(void)
+{
+    TA0CTL = MC_0;
+    TA0CCTL1 = 0;
+
+    // Repeat modes only stop at once when CONSEQ is cleared along with ENC
+    ADC12CTL1 &= ~ADC12CONSEQ_3;
+    ADC12CTL0 &= ~ADC12ENC;
+    ADC12IE = 0;
+    ADC12IFG = 0;
+}
+
+// Most recent conversion of the given channel (index into the sequence)
+uint16_t ADCStream_latest(uint8_t channel)
+{
+    return latest[channel];
+}
+
+// Polled alternative to the ready callback. Returns the newest completed
+// block once, or 0 if nothing has completed since the last call.
+const uint16_t *ADCStream_getBlock(uint8_t *numSequences)
+{
+    const uint16_t *block = 0;
+    __istate_t intState = __get_interrupt_state();
+
+    __disable_interrupt();
+    if (blockPending) {
+        block = readyBlock;
+        blockPending = 0;
+        *numSequences = blockLen;
+    }
+    __set_interrupt_state(intState);
+
+    return block;
+}
+
+// Conversions the ADC overwrote before the ISR could read them
+unsigned long ADCStream_overruns(void)
+{
+    return overruns;
+}
+
+//------------------------------------------------------------------------------
+// ADC12 Interrupt Service Routine
+//------------------------------------------------------------------------------
+#pragma vector=ADC12_VECTOR
+__interrupt void ADC12_ISR(void)
+{
+    volatile uint16_t *mem = &ADC12MEM0;
+    uint16_t iv = ADC12IV;
+    uint8_t i;
+
+    if ((iv == 2) || (iv == 4)) {        // ADC12OVIFG, ADC12TOVIFG
+        overruns++;
+        return;
+    }
+
+    // End of sequence: reading MEMx clears the per-channel flags
+    for (i = 0; i < numChannels; i++) {
+        uint16_t sample = mem[i];
+        latest[i] = sample;
+        fillBlock[fillIndex++] = sample;
+    }
+
+    if (fillIndex >= blockSamples) {
+        readyBlock = fillBlock;
+        blockPending = 1;
+        fillBlock = (fillBlock == blocks[0]) ? blocks[1] : blocks[0];
+        fillIndex = 0;
+
+        if (readyCallback)
+            readyCallback(readyBlock, blockLen);
+
+        __bic_SR_register_on_exit(LPM3_bits);   // a block is ready: wake the main loop
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * adc_stream.h
+ *
+ *  Background ADC12_A acquisition. Timer A0 output 1 triggers one
+ *  conversion per period, ADC12_A walks a repeat-sequence of up to
+ *  ADC_STREAM_MAX_CHANNELS channels and the ADC12 ISR moves each
+ *  completed sequence into one half of a double buffer. When a half
+ *  fills, the halves swap and the full block is handed to the ready
+ *  callback while the next one is being filled.
+ *
+ *  Timer A0 is reserved for this module while a stream is running.
+ */
+
+#ifndef ADC_STREAM_H_
+#define ADC_STREAM_H_
+
+#include <msp430.h>
+#include <stdint.h>
+
+#define ADC_STREAM_MAX_CHANNELS     4
+
+// Samples (not sequences) held by one half of the double buffer
+#define ADC_STREAM_BLOCK_SAMPLES    64
+
+// Clock frequencies assumed when computing the trigger period
+#define ADC_STREAM_ACLK_HZ          32768UL
+#define ADC_STREAM_SMCLK_HZ         1048576UL
+
+/*
+ * Channel definitions, written as-is into ADC12MCTLx.
+ * The internal reference is shared by every channel that selects it, so a
+ * stream mixing ADC_CH_TEMP and ADC_CH_AVCC_HALF has to use the 2.5 V
+ * reference (AVCC/2 is above 1.5 V on a 3.3 V board).
+ */
+#define ADC_CH_TEMP         (ADC12SREF_1 | ADC12INCH_10)    // internal temperature sensor vs. VREF+
+#define ADC_CH_A0           (ADC12SREF_0 | ADC12INCH_0)     // P6.0 voltmeter input vs. AVCC
+#define ADC_CH_AVCC_HALF    (ADC12SREF_1 | ADC12INCH_11)    // (AVCC - AVSS) / 2 vs. VREF+
+
+// Internal reference selection
+#define ADC_STREAM_REF_OFF      0
+#define ADC_STREAM_REF_1_5V     1
+#define ADC_STREAM_REF_2_5V     2
+
+// Called from the ADC12 ISR with a full block of numSequences * numChannels
+// samples, interleaved in channel order. The block stays valid until the
+// other half fills, i.e. for blockLen sequence periods.
+typedef void (*ADCStream_ReadyCallback)(const uint16_t *block, uint8_t numSequences);
+
+typedef struct ADCStream_Config
+{
+    const uint8_t *channels;    // ADC_CH_* values in conversion order
+    uint8_t numChannels;
+    uint8_t blockLen;           // sequences per block
+    uint8_t reference;          // ADC_STREAM_REF_*
+    uint16_t sampleTime;        // ADC12SHT0_x, applied to every channel
+    uint16_t rateHz;            // complete sequences per second
+    ADCStream_ReadyCallback ready;  // optional
+} ADCStream_Config;
+
+uint8_t ADCStream_start(const ADCStream_Config *config);
+void ADCStream_stop(void);
+
+uint16_t ADCStream_latest(uint8_t channel);
+const uint16_t *ADCStream_getBlock(uint8_t *numSequences);
+unsigned long ADCStream_overruns(void);
+
+#endif /* ADC_STREAM_H_ */
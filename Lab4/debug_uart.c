@@ -0,0 +1,58 @@
+/*
+ * debug_uart.c
+ *
+ *  Polled USCI_A1 UART transmitter. See debug_uart.h.
+ */
+
+#include "debug_uart.h"
+
+void DebugUart_init(void)
+{
+    DEBUG_UART_PORT_SEL |= DEBUG_UART_PIN_TXD;
+
+    UCA1CTL1 = UCSWRST | UCSSEL__SMCLK;
+    UCA1CTL0 = 0;                       // 8 data bits, no parity, 1 stop bit, LSB first
+    UCA1BR0 = DEBUG_UART_BR & 0xFF;
+    UCA1BR1 = DEBUG_UART_BR >> 8;
+    UCA1MCTL = DEBUG_UART_BRS;
+    UCA1CTL1 &= ~UCSWRST;
+}
+
+void DebugUart_putc(char c)
+{
+    while (!(UCA1IFG & UCTXIFG))
+        ;
+    UCA1TXBUF = c;
+}
+
+void DebugUart_write(const uint8_t *data, uint16_t len)
+{
+    while (len--)
+        DebugUart_putc(*data++);
+}
+
+// Sends a string, turning "\n" into "\r\n" for terminal programs
+void DebugUart_print(const char *s)
+{
+    while (*s) {
+        if (*s == '\n')
+            DebugUart_putc('\r');
+        DebugUart_putc(*s++);
+    }
+}
+
+// Sends n in decimal. The projects build with minimal printf support,
+// which has no %u or %lu.
+void DebugUart_printNum(uint32_t n)
+{
+    char digits[10];
+    uint8_t i = 0;
+
+    do {
+        digits[i++] = '0' + n % 10;
+        n /= 10;
+    } while (n);
+
+    while (i)
+        DebugUart_putc(digits[--i]);
+}
@@ -0,0 +1,29 @@
+/*
+ * debug_uart.h
+ *
+ *  Minimal transmit-only debug UART on USCI_A1 (P4.4 TXD), which the
+ *  LaunchPad's eZ-FET passes on to the PC as its application COM port.
+ *  115200 baud, 8N1, from the default 1.048576 MHz SMCLK. Writes wait
+ *  for TXBUF, so this is for reports and diagnostics, not the hot path.
+ */
+
+#ifndef DEBUG_UART_H_
+#define DEBUG_UART_H_
+
+#include <msp430.h>
+#include <stdint.h>
+
+// 1048576 / 115200 = 9.10: UCBR = 9, UCBRS = 1 (family guide table)
+#define DEBUG_UART_BR           9
+#define DEBUG_UART_BRS          UCBRS_1
+
+#define DEBUG_UART_PORT_SEL     P4SEL
+#define DEBUG_UART_PIN_TXD      BIT4
+
+void DebugUart_init(void);
+void DebugUart_putc(char c);
+void DebugUart_write(const uint8_t *data, uint16_t len);
+void DebugUart_print(const char *s);
+void DebugUart_printNum(uint32_t n);
+
+#endif /* DEBUG_UART_H_ */
@@ -0,0 +1,66 @@
+/*
+ * filters.h
+ *
+ *  Streaming filters for integer sensor samples. Every update costs the
+ *  same handful of operations however long the filter has been running:
+ *
+ *  MovingAvg   running-sum average over the last N samples. A power of
+ *              two N divides with a shift; any other N (up to
+ *              FILTER_MAX_WINDOW) falls back to one division per update.
+ *  EMAFilter   exponential moving average with alpha = 1 / 2^shift.
+ *  MedianFilter median of the last 5 or 7 samples, for rejecting spikes
+ *              ahead of one of the averaging filters.
+ *
+ *  The latest output is kept in a 16-bit field, so an ISR can run the
+ *  update while the main loop reads the output without a critical section.
+ */
+
+#ifndef FILTERS_H_
+#define FILTERS_H_
+
+#include <stdint.h>
+
+#define FILTER_MAX_WINDOW   16
+
+// MovingAvg.shift for windows that are not a power of two
+#define FILTER_NO_SHIFT     0xFF
+
+typedef struct MovingAvg
+{
+    int16_t samples[FILTER_MAX_WINDOW];
+    int32_t sum;                // sum of the samples held
+    uint8_t window;             // N
+    uint8_t shift;              // log2(N), or FILTER_NO_SHIFT
+    uint8_t index;              // slot the next sample replaces
+    uint8_t count;              // samples held, saturates at N
+    volatile int16_t value;     // latest average
+} MovingAvg;
+
+typedef struct EMAFilter
+{
+    int32_t state;              // average scaled by 2^shift
+    uint8_t shift;
+    uint8_t primed;             // 0 until the first sample seeds the state
+    volatile int16_t value;     // latest average
+} EMAFilter;
+
+typedef struct MedianFilter
+{
+    int16_t samples[7];
+    uint8_t size;               // 5 or 7
+    uint8_t index;
+    uint8_t primed;
+    volatile int16_t value;     // latest median
+} MedianFilter;
+
+void MovingAvg_init(MovingAvg *f, uint8_t window);
+void MovingAvg_reset(MovingAvg *f);
+int16_t MovingAvg_update(MovingAvg *f, int16_t sample);
+
+void EMA_init(EMAFilter *f, uint8_t shift);
+int16_t EMA_update(EMAFilter *f, int16_t sample);
+
+void Median_init(MedianFilter *f, uint8_t size);
+int16_t Median_update(MedianFilter *f, int16_t sample);
+
+#endif /* FILTERS_H_ */
@@ -0,0 +1,56 @@
+/*
+ * lcd_mirror.h
+ *
+ *  Copy of the display sent to a PC over the telemetry stream
+ *  (telemetry.h), for seeing the screen of a board that is out of sight.
+ *  Sharp96x96_Flush() calls LcdMirror_flush() when LCD_MIRROR is defined
+ *  in Sharp96x96.h. Each flush sends only the lines of DisplayBuffer
+ *  that changed since they were last sent, run-length encoded, so an
+ *  unchanged screen costs nothing and a new digit a few dozen bytes.
+ *
+ *  Packets on the wire, the length LSB first:
+ *
+ *      0xA5 0xC3 | seq | flags | lines | len (2) | len bytes of lines | CRC high | CRC low
+ *      line:     line number | encoded pixels
+ *      encoded:  0x00-0x7F, then that + 1 bytes as they are
+ *                0x80-0xFF, then one byte repeated (that & 0x7F) + 1 times
+ *
+ *  Every line decodes to LCD_MIRROR_LINE_BYTES bytes, as DisplayBuffer
+ *  holds them: MSB first, 1 is white. Flag LCD_MIRROR_ROTATE_90 says the
+ *  driver stores the picture turned (ROTATE_90 in Sharp96x96.h). The CRC
+ *  is CRC-16/CCITT (crc16.h) over everything from seq to the last line.
+ *
+ *  A line counts as changed when its CRC-16 differs from the one it had
+ *  when last sent. Lines that do not fit in the packet, or change while
+ *  the previous packet is still on the wire, go with a later flush. A few
+ *  lines are resent every flush whether they changed or not, so a viewer
+ *  started late, or one that lost a packet, has the whole screen after
+ *  LCD_MIRROR_LINES / LCD_MIRROR_REFRESH_LINES flushes.
+ *
+ *  The PC side is tools/lcdmirror/lcdview.c.
+ */
+
+#ifndef LCD_MIRROR_H_
+#define LCD_MIRROR_H_
+
+#include <stdint.h>
+
+#define LCD_MIRROR_SYNC1        0xA5
+#define LCD_MIRROR_SYNC2        0xC3
+#define LCD_MIRROR_HEADER_LEN   7
+
+#define LCD_MIRROR_ROTATE_90    0x01
+
+#define LCD_MIRROR_LINES        128     // DisplayBuffer, LCD_VERTICAL_MAX
+#define LCD_MIRROR_LINE_BYTES   16      // LCD_HORIZONTAL_MAX / 8
+
+// Longest line in a packet: line number, one control byte, all bytes literal
+#define LCD_MIRROR_MAX_LINE     (1 + 1 + LCD_MIRROR_LINE_BYTES)
+
+#define LCD_MIRROR_PACKET_SIZE  512     // about 45 ms at 115200 baud
+#define LCD_MIRROR_REFRESH_LINES 2
+
+void LcdMirror_flush(const uint8_t *displayBuffer);
+void LcdMirror_resend(void);
+
+#endif /* LCD_MIRROR_H_ */
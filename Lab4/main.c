@@ -3,45 +3,67 @@
 #include <stdlib.h>
 #include "peripherals.h"
 #include "string.h"
+#include "adc_stream.h"
+#include "sensor_conv.h"
+#include "filters.h"
+#include "spi_link.h"
+#include "spi_slave.h"
+#include "spi_bench.h"
+#include "debug_uart.h"
+#include "crc16.h"
+#include "dma.h"
+#include "telemetry.h"
+#include "flash_log.h"
 
 
 /**
  * main.c
  */
 
-//This is to use for slave configurations
-#define SLAVE_PORT_SPI_SEL  P4SEL
-#define SLAVE_PORT_SPI_DIR  P4DIR
-#define SLAVE_PORT_SPI_OUT  P4OUT
-
-#define SLAVE_PORT_CS_SEL   P4SEL
-#define SLAVE_PORT_CS_DIR   P4DIR
-#define SLAVE_PORT_CS_OUT   P4OUT
-#define SLAVE_PORT_CS_REN   P4REN
-
-#define SLAVE_PIN_SPI_MOSI  BIT1
-#define SLAVE_PIN_SPI_MISO  BIT2
-#define SLAVE_PIN_SPI_SCLK  BIT3
-#define SLAVE_PIN_SPI_CS    BIT0
-
-#define SLAVE_SPI_REG_CTL0      UCB1CTL0
-#define SLAVE_SPI_REG_CTL1      UCB1CTL1
-#define SLAVE_SPI_REG_BRL       UCB1BR0
-#define SLAVE_SPI_REG_BRH       UCB1BR1
-#define SLAVE_SPI_REG_IFG       UCB1IFG
-#define SLAVE_SPI_REG_STAT      UCB1STAT
-#define SLAVE_SPI_REG_TXBUF     UCB1TXBUF
-#define SLAVE_SPI_REG_RXBUF     UCB1RXBUF
-
 //This is needed to configure P8.2 to use it as CS by MSP430
 #define MSP_PORT_CS_SEL     P8SEL
 #define MSP_PORT_CS_DIR     P8DIR
 #define MSP_PORT_CS_OUT     P8OUT
 #define MSP_PIN_CS          BIT2
 
-#define MSP_SPI_REG_TXBUF   UCB0TXBUF
-#define MSP_SPI_REG_RXBUF   UCB0RXBUF
-#define MSP_SPI_REG_IFG     UCB0IFG
+// Bit rate divider of the loopback master. Each byte takes 8 * 16 SMCLK
+// cycles. At /8 and faster the UCB1 receive interrupt is starved by the
+// SPI bus interrupts and whole frames overrun (tools/spibench), so /16 is
+// the fastest setting the link runs clean at.
+#define LINK_SPI_CLK_TICKS  16
+
+// Loopback message: seconds (4 bytes) then millivolts (2 bytes), LSB first
+#define LINK_MSG_LEN        6
+
+// CRC benchmark ('#' on the keypad): 1 KB of program flash, 16 times over
+#define CRC_BENCH_DATA      ((const void *)0x6400)
+#define CRC_BENCH_LEN       1024
+#define CRC_BENCH_BLOCKS    16
+
+// Telemetry channels on the debug UART (tools/telemetry/telemrx.c):
+// every A0 reading, then once a second the millivolts sent over the
+// loopback, the millivolts received and the bad frame count
+#define TELEM_CH_VOLT_ADC   1
+#define TELEM_CH_SENT_MV    2
+#define TELEM_CH_RECV_MV    3
+#define TELEM_CH_BAD_FRAMES 4
+
+// Voltage history ('8' on the keypad dumps the last hour of it)
+#define LOG_DUMP_SECONDS    3600
+
+// DMA benchmark ('0' on the keypad): block lengths timed, each 512 times,
+// copying from the same flash into RAM
+const uint16_t dmaBenchLens[] = {2, 4, 8, 16, 32, 64, 128, 256};
+#define DMA_BENCH_SIZES     (sizeof(dmaBenchLens) / sizeof(dmaBenchLens[0]))
+#define DMA_BENCH_BLOCKS    512
+
+// Time base ticks for all blocks to nanoseconds per block, by way of
+// microseconds (1000000 / 32768 being 15625 / 512) so nothing overflows
+#define DMA_BENCH_NS(ticks) ((ticks) * 15625UL / 512 * 1000 / DMA_BENCH_BLOCKS)
+
+// Bit rate dividers swept by the benchmark ('*' on the keypad), slowest first
+const uint16_t benchDividers[] = {64, 32, 16, 8, 4, 2, 1};
+#define BENCH_SETTINGS      (sizeof(benchDividers) / sizeof(benchDividers[0]))
 
 //This is to configure the voltmeter to P6.0 to use in function mode for ADC
 #define VOLT_PORT_SEL       P6SEL
@@ -51,40 +73,54 @@
 // Function Prototypes
 
 void InitSlaveSPI(void);
-unsigned char SlaveSPIRead();
-void MasterSPIWrite(unsigned int data);
+uint8_t SendOverLink(long unsigned int sendTimer, unsigned int sendVolt,
+                     long unsigned int *rTimer, unsigned int *rVoltage);
+void RunLinkBenchmark(void);
+void RunCrcBenchmark(void);
+void RunDmaBenchmark(void);
+void DumpVoltageLog(void);
+void printLogSample(uint32_t time, const int16_t *values, uint8_t numValues);
+void WaitForKey(void);
 
 void configUCS(void);
-void configTimerA2(void);
-__interrupt void Timer_A2_ISR(void);
-void stopTimerA2(void);
-void enableTimerA2(void);
 
 void configVoltmeter(void);
 
 void sampleVoltage(void);
-float readVoltage(unsigned int adc_out);
-
-long unsigned int TimerSetValue(long unsigned int tempTimer);
-float VoltageSetValue(float in_voltage);
-long unsigned int Send_4_Bytes(long unsigned int data_4_bytes);
+void voltBlockReady(const uint16_t *block, uint8_t numSequences);
+unsigned int readVoltage(unsigned int adc_out);
 
 void displayTime(long unsigned int inTime);
 void displayVoltage(unsigned int inVolt);
+char *appendNum(char *out, unsigned long n, uint8_t width);
+char *appendStr(char *out, const char *s);
 
 
-const float vref_pos = 3.3;
+const unsigned int vref_pos_mV = SENSOR_AVCC_MV;  // VREF+ of the voltmeter, in millivolts
 
-long unsigned int timer;                        // timer count for TimerA2, increased by TimerA2 ISR
+long unsigned int timer;                        // seconds shown, counted on the shared time base
 unsigned int in_volt;                           // ADC value from A0 channel, voltmeter
 
+// Voltmeter stream: A0 against AVCC, 64 readings a second in the background,
+// handed to voltBlockReady() 16 at a time
+const uint8_t voltChannels[1] = {ADC_CH_A0};
+const ADCStream_Config voltStream = {voltChannels, 1, 16, ADC_STREAM_REF_OFF, ADC12SHT0_9, 64, voltBlockReady};
+
+MedianFilter voltMedian;                        // rejects single-sample spikes on A0
+EMAFilter voltEma;                              // smooths the median output
+
+uint8_t masterSpiDevice;                        // SPI bus handle for the UCB0 master side of the loopback
+uint16_t badFrames = 0;                         // frames that arrived with a wrong length or CRC
+uint8_t dmaBenchBuffer[256];                    // destination of the DMA benchmark
+
 
 int main(void)
 {
     WDTCTL = WDTPW | WDTHOLD;   // stop watchdog timer
 
     // Useful code starts here
-    // Initialization and configuration of LEDs, Display, Keypad, UCS, TimerA2, Push Buttons and Temp Sensor
+    // Initialization and configuration of LEDs, Display (which also starts the time base), Keypad, SPI, UCS
+    // and Voltmeter
     initLeds();
     configDisplay();
     configKeypad();
@@ -92,14 +128,18 @@ int main(void)
     InitSlaveSPI();
 
     configUCS();
-    configTimerA2();
 
     configVoltmeter();
 
+    DebugUart_init();
+    Telemetry_init();
+    FlashLog_init(1);       // millivolts
+
     _BIS_SR(GIE);           // enables interrupts
 
 
-    timer = 2;                           // timer set to initial time
+    long unsigned int timeOffset = 2 - Timebase_seconds();     // timer starts at 2 seconds
+    timer = Timebase_seconds() + timeOffset;    // timer set to initial time
     long unsigned int prevTime = timer - 1;     // prevTime declared and set to timer - 1
 
     // Clears display from anything
@@ -107,31 +147,29 @@ int main(void)
     Graphics_flushBuffer(&g_sContext);
 
 
+    long unsigned int rTimer = 0;               // time and voltage as received over the loopback
+    unsigned int rVoltage = 0;
+    int16_t sentMv;                             // voltage sent, as logged to flash
+
     // Forever loop
     while (1) {
 
+        timer = Timebase_seconds() + timeOffset;
+
         if (timer >= (prevTime + 1)) {
             sampleVoltage();
-            long unsigned int tempTimer = timer;
-
-            // Send timer data, receives timer data and reconstructs bytes,
-            // then returns reconstructed data and stores in rTimer variable which is displayed
-            long unsigned int rTimer = TimerSetValue(tempTimer);
 
-            unsigned char w, r;
-            unsigned int sendVolt = (int)(readVoltage(in_volt) * 10);
-            unsigned int rVoltage = 0;
+            // Sends timer and voltage in one frame and displays what the slave
+            // received. A damaged frame leaves the last good values on screen.
+            if (!SendOverLink(timer, readVoltage(in_volt), &rTimer, &rVoltage))
+                badFrames++;
 
-            w = (unsigned char) (sendVolt & 0xFF);
-            MasterSPIWrite(w);
-            r = SlaveSPIRead();
-            rVoltage |= (int)r;
+            sentMv = readVoltage(in_volt);
+            FlashLog_append(timer, &sentMv);
 
-            sendVolt >>= 8;
-            w = (unsigned char) (sendVolt & 0xFF);
-            MasterSPIWrite(w);
-            r = SlaveSPIRead();
-            rVoltage |= ((int)r << 8);
+            Telemetry_record(TELEM_CH_SENT_MV, sentMv);
+            Telemetry_record(TELEM_CH_RECV_MV, rVoltage);
+            Telemetry_record(TELEM_CH_BAD_FRAMES, badFrames);
 
             Graphics_clearDisplay(&g_sContext);
             displayTime(rTimer);
@@ -141,229 +179,326 @@ int main(void)
             prevTime = timer;
         }
 
+        // '*' runs the SPI link benchmark, the clock picks up afterwards.
+        // '#' times the hardware CRC against the software one, '0' DMA
+        // block copies and fills against CPU ones. '8' dumps the voltage log.
+        switch (getKey()) {
+        case '*':
+            RunLinkBenchmark();
+            prevTime = timer - 1;
+            break;
+        case '#':
+            RunCrcBenchmark();
+            prevTime = timer - 1;
+            break;
+        case '0':
+            RunDmaBenchmark();
+            prevTime = timer - 1;
+            break;
+        case '8':
+            DumpVoltageLog();
+            break;
+        }
+
     }
 }
 
 
 void InitSlaveSPI() {
 
-    // Configure SCLK, MISO and MOSI for peripheral mode
-    SLAVE_PORT_SPI_SEL |=
-            (SLAVE_PIN_SPI_MOSI|SLAVE_PIN_SPI_MISO|SLAVE_PIN_SPI_SCLK);
-
-    // Configure the Slave CS as an Input P4.0
-    SLAVE_PORT_CS_SEL &= ~SLAVE_PIN_SPI_CS;
-    SLAVE_PORT_CS_DIR &= ~SLAVE_PIN_SPI_CS;
-    SLAVE_PORT_CS_REN |= SLAVE_PIN_SPI_CS;
-    SLAVE_PORT_CS_OUT |= SLAVE_PIN_SPI_CS;
+    // UCB1 receives in its interrupt, frames delimited by CS on P4.0
+    SPISlave_init();
 
     // Configure the CS output of MSP430 P8.2. It will set P4.0 high or low.
     MSP_PORT_CS_SEL &= ~MSP_PIN_CS;
     MSP_PORT_CS_DIR |= MSP_PIN_CS;
     MSP_PORT_CS_OUT |= MSP_PIN_CS;
 
-    // Disable the module so we can configure it
-    SLAVE_SPI_REG_CTL1 |= UCSWRST;
-    SLAVE_SPI_REG_CTL0 &= ~(0xFF); // Reset the controller config parameters
-    SLAVE_SPI_REG_CTL1 &= ~UCSSEL_3; // Reset the clock configuration
-
-    // Set SPI clock frequency (which is the same frequency as SMCLK so
-    // this can apparently be 0)
-    SPI_REG_BRL = ((uint16_t)SPI_CLK_TICKS) & 0xFF; // Load the low byte
-    SPI_REG_BRH = (((uint16_t)SPI_CLK_TICKS) >> 8) & 0xFF; // Load the high byte
-
-    //capture data on first edge
-    //inactive low polarity
-    //MSB first
-    //8 bit
-    //Slave Mode//
-    //4 wire - SPI active low
-    //Synchronous mode
-    SLAVE_SPI_REG_CTL0 |= (UCCKPH | UCMSB | UCMODE_2 | UCSYNC);
-    SLAVE_SPI_REG_CTL0 &= ~(UCCKPL | UC7BIT | UCMST);
-
-    // Reenable the module
-    SLAVE_SPI_REG_CTL1 &= ~UCSWRST;
-    SLAVE_SPI_REG_IFG &= ~UCRXIFG;
+    // UCB0 is shared with the LCD, so the master side is registered as a
+    // device on the SPI bus: CS active low, MSB first, capture on first edge
+    SPIBus_Device masterDevice;
+    masterDevice.csOut = &MSP_PORT_CS_OUT;
+    masterDevice.csPin = MSP_PIN_CS;
+    masterDevice.csActiveHigh = 0;
+    masterDevice.ctl0 = UCCKPH | UCMSB;
+    masterDevice.clkTicks = LINK_SPI_CLK_TICKS;
+    masterSpiDevice = SPIBus_registerDevice(&masterDevice);
+    SPILink_init(masterSpiDevice);
 }
 
-unsigned char SlaveSPIRead() {
-    unsigned char c;
-    while (!(SLAVE_SPI_REG_IFG & UCRXIFG)){
-        c = SLAVE_SPI_REG_RXBUF;
-    }
-
-    return (c & 0xFF);
+// Sends timer and voltage to the slave as one frame, with CS held low for
+// all of it, and unpacks what the slave received.
+// Returns 0 if the received frame was damaged.
+uint8_t SendOverLink(long unsigned int sendTimer, unsigned int sendVolt,
+                     long unsigned int *rTimer, unsigned int *rVoltage) {
+    uint8_t msg[LINK_MSG_LEN];
+    uint8_t frame[SPI_LINK_FRAME_LEN(LINK_MSG_LEN)];
+    uint16_t frameLen;
+
+    msg[0] = sendTimer & 0xFF;
+    msg[1] = (sendTimer >> 8) & 0xFF;
+    msg[2] = (sendTimer >> 16) & 0xFF;
+    msg[3] = (sendTimer >> 24) & 0xFF;
+    msg[4] = sendVolt & 0xFF;
+    msg[5] = (sendVolt >> 8) & 0xFF;
+
+    // The frame is queued by the CS rising edge interrupt, which runs as
+    // soon as the bus releases CS. Older frames left over are skipped.
+    SPILink_send(msg, LINK_MSG_LEN);
+    SPILink_wait();
+
+    frameLen = 0;
+    while (SPISlave_framesWaiting())
+        frameLen = SPISlave_read(frame, sizeof(frame));
+
+    if (SPILink_decode(frame, frameLen, msg) != LINK_MSG_LEN)
+        return 0;
+
+    *rTimer = ((uint32_t)msg[0]) | ((uint32_t)msg[1] << 8) |
+              ((uint32_t)msg[2] << 16) | ((uint32_t)msg[3] << 24);
+    *rVoltage = msg[4] | ((unsigned int)msg[5] << 8);
+    return 1;
 }
 
-void MasterSPIWrite (unsigned int data) {
-    // Start SPI transmission by de-asserting CS
-    MSP_PORT_CS_OUT &= ~MSP_PIN_CS;
 
-    // Write data/ 1-byte at a time
-    uint8_t byte = (unsigned char) ((data)&0xFF);
+// Sweeps the loopback bit rate divider with PRBS frames and reports each
+// setting on the LCD and the debug UART, then waits for a key
+void RunLinkBenchmark() {
+    SPIBench_Result result;
+    char line[32], *p;
+    uint8_t i;
 
-    // Send byte
-    MSP_SPI_REG_TXBUF = byte;
+    Telemetry_pause();              // the report is text on the same UART
 
-    // Wait for SPI peripheral to finish transmitting
-    while (!(MSP_SPI_REG_IFG & UCTXIFG)) {
-        _no_operation();
+    Graphics_clearDisplay(&g_sContext);
+    Graphics_drawStringCentered(&g_sContext, (uint8_t *)"SPI BENCH", AUTO_STRING_LENGTH, 48, 5, OPAQUE_TEXT);
+    Graphics_flushBuffer(&g_sContext);
+    DebugUart_print("SPI loopback benchmark\n");
+
+    for (i = 0; i < BENCH_SETTINGS; i++) {
+        SPIBench_run(masterSpiDevice, benchDividers[i], &result);
+
+        SPIBench_print(&result);
+
+        // "/8 10240B/s e0": divider, throughput, wrong plus lost bytes
+        p = appendStr(line, "/");
+        p = appendNum(p, result.clkTicks, 0);
+        p = appendStr(p, " ");
+        p = appendNum(p, result.bytesPerSec, 0);
+        p = appendStr(p, "B/s e");
+        appendNum(p, (unsigned long)result.byteErrors + result.lostBytes, 0);
+        Graphics_drawString(&g_sContext, (uint8_t *)line, AUTO_STRING_LENGTH, 2, 18 + 10 * i, OPAQUE_TEXT);
+        Graphics_flushBuffer(&g_sContext);
     }
 
-    // Assert CS
-    MSP_PORT_CS_OUT |= MSP_PIN_CS;
-}
+    SPIBus_setClock(masterSpiDevice, LINK_SPI_CLK_TICKS);
 
+    Graphics_drawStringCentered(&g_sContext, (uint8_t *)"ANY KEY", AUTO_STRING_LENGTH, 48, 90, OPAQUE_TEXT);
+    Graphics_flushBuffer(&g_sContext);
 
-// configures UCS
-void configUCS() {
-    P5SEL |= (BIT5 | BIT4 | BIT3 |BIT2);    // enables XT1CLK and XT2CLK, both crystal clocks
+    WaitForKey();
+    Telemetry_resume();
 }
 
-// configures TimerA2 with one second resolution
-// including source clk, divider, up mode; also sets Max count to 32767; enables TimerA2 interrupt
-void configTimerA2 () {
-    TA2CTL = TASSEL_1 + ID_0 + MC_1;        // sets ACLK as TimerA2 source, divider is 1, up mode
-    TA2CCR0 = 32767;                          // TA2CCR0 = Max_count = ACLK_ticks - 1 = 32768 - 1 = 32767
-    TA2CCTL0 = CCIE;                        // TA2CCR0 interrupt enabled
-}
+// Times CRC-16 over 1 KB blocks on the CRC16 module and with the lookup
+// table, and reports both on the LCD and the debug UART
+void RunCrcBenchmark() {
+    CRC16_Bench bench;
+    char line[24], *p;
+    unsigned long hwUs, swUs;
 
-// TimerA2 ISR configuration
-// No leap counting needed for timer
-#pragma vector=TIMER2_A0_VECTOR
-__interrupt void Timer_A2_ISR(void) {
-    timer++;
-}
+    Telemetry_pause();              // the report is text on the same UART
 
+    CRC16_benchmark(CRC_BENCH_DATA, CRC_BENCH_LEN, CRC_BENCH_BLOCKS, &bench);
 
-// stops timer A2
-void stopTimerA2() {
-    TA2CTL |= MC_0;         // stop timer, enable stop mode
-}
+    // microseconds per block, 1000000 / 32768 being 15625 / 512
+    hwUs = bench.hardwareTicks * 15625UL / 512 / bench.blocks;
+    swUs = bench.softwareTicks * 15625UL / 512 / bench.blocks;
 
-// enables TimerA2 after being stopped
-void enableTimerA2() {
-    TA2CTL |= MC_1;        // up mode
-}
+    DebugUart_print("CRC16 ");
+    DebugUart_printNum(bench.len);
+    DebugUart_print(" B: hardware ");
+    DebugUart_printNum(hwUs);
+    DebugUart_print(" us, software ");
+    DebugUart_printNum(swUs);
+    DebugUart_print(" us\n");
 
+    Graphics_clearDisplay(&g_sContext);
+    Graphics_drawStringCentered(&g_sContext, (uint8_t *)"CRC16 1KB", AUTO_STRING_LENGTH, 48, 5, OPAQUE_TEXT);
+    p = appendStr(line, "HW ");
+    appendStr(appendNum(p, hwUs, 0), " us");
+    Graphics_drawString(&g_sContext, (uint8_t *)line, AUTO_STRING_LENGTH, 2, 30, OPAQUE_TEXT);
+    p = appendStr(line, "SW ");
+    appendStr(appendNum(p, swUs, 0), " us");
+    Graphics_drawString(&g_sContext, (uint8_t *)line, AUTO_STRING_LENGTH, 2, 40, OPAQUE_TEXT);
+    if (hwUs) {
+        p = appendStr(line, "x");
+        p = appendStr(appendNum(p, swUs / hwUs, 0), ".");
+        appendStr(appendNum(p, (swUs * 10 / hwUs) % 10, 0), " faster");
+        Graphics_drawString(&g_sContext, (uint8_t *)line, AUTO_STRING_LENGTH, 2, 50, OPAQUE_TEXT);
+    }
+    Graphics_drawStringCentered(&g_sContext, (uint8_t *)"ANY KEY", AUTO_STRING_LENGTH, 48, 90, OPAQUE_TEXT);
+    Graphics_flushBuffer(&g_sContext);
 
-// Function to configure voltage meter
-void configVoltmeter() {
+    WaitForKey();
+    Telemetry_resume();
+}
 
-    // Set Port 6 Pin 0 to FUNCTION mode for ADC
-    VOLT_PORT_SEL |= VOLT_PIN_FUNC;
+// Times memcpy/memset against DMA block transfers for each length and
+// reports the first length where DMA wins on the LCD and the debug UART
+void RunDmaBenchmark() {
+    DMA_Bench bench;
+    char line[32], *p;
+    uint16_t copyCrossover = 0, fillCrossover = 0;
+    unsigned long cpuNs, dmaNs;
+    uint8_t i;
 
-    REFCTL0 &= ~REFMSTR;
+    Telemetry_pause();              // the report is text on the same UART
 
-    // ADC12 Sample and Hold clock cycle is set to 384 cycles
-    // ADC12 ADC12 is turned on
-    ADC12CTL0 = ADC12SHT0_9 | ADC12ON;
+    Graphics_clearDisplay(&g_sContext);
+    Graphics_drawStringCentered(&g_sContext, (uint8_t *)"DMA COPY ns", AUTO_STRING_LENGTH, 48, 5, OPAQUE_TEXT);
+    Graphics_flushBuffer(&g_sContext);
+    DebugUart_print("DMA benchmark, ns per block\n");
+
+    for (i = 0; i < DMA_BENCH_SIZES; i++) {
+        if (!DMA_benchmark(dmaBenchBuffer, CRC_BENCH_DATA, dmaBenchLens[i], DMA_BENCH_BLOCKS, &bench)) {
+            DebugUart_printNum(dmaBenchLens[i]);
+            DebugUart_print(" B: no DMA channel free\n");
+            appendStr(appendNum(line, dmaBenchLens[i], 3), "  NO CHANNEL");
+            Graphics_drawString(&g_sContext, (uint8_t *)line, AUTO_STRING_LENGTH, 2, 16 + 9 * i, OPAQUE_TEXT);
+            Graphics_flushBuffer(&g_sContext);
+            continue;
+        }
 
-    // ADC12SHP = 1 = SAMPCON signal sourced from sampling timer
-    // Enable sample timer
-    ADC12CTL1 = ADC12SHP;
+        if (!copyCrossover && (bench.dmaCopyTicks < bench.cpuCopyTicks))
+            copyCrossover = bench.len;
+        if (!fillCrossover && (bench.dmaFillTicks < bench.cpuFillTicks))
+            fillCrossover = bench.len;
+
+        cpuNs = DMA_BENCH_NS(bench.cpuCopyTicks);
+        dmaNs = DMA_BENCH_NS(bench.dmaCopyTicks);
+        DebugUart_printNum(bench.len);
+        DebugUart_print(" B: copy cpu ");
+        DebugUart_printNum(cpuNs);
+        DebugUart_print(" dma ");
+        DebugUart_printNum(dmaNs);
+        DebugUart_print(", fill cpu ");
+        DebugUart_printNum(DMA_BENCH_NS(bench.cpuFillTicks));
+        DebugUart_print(" dma ");
+        DebugUart_printNum(DMA_BENCH_NS(bench.dmaFillTicks));
+        DebugUart_print("\n");
+
+        // "  8  1234   987": length, then copy ns per block on the CPU and by DMA
+        p = appendStr(appendNum(line, bench.len, 3), " ");
+        p = appendStr(appendNum(p, cpuNs, 5), " ");
+        appendNum(p, dmaNs, 5);
+        Graphics_drawString(&g_sContext, (uint8_t *)line, AUTO_STRING_LENGTH, 2, 16 + 9 * i, OPAQUE_TEXT);
+        Graphics_flushBuffer(&g_sContext);
+    }
 
-    // Memory location 0 is used for input channel A0
-    // Reference voltage is set to VCC = 3.3 V
-    ADC12MCTL0 = ADC12SREF_0 + ADC12INCH_0;
+    DebugUart_print("DMA wins from: copy ");
+    DebugUart_printNum(copyCrossover);
+    DebugUart_print(" B, fill ");
+    DebugUart_printNum(fillCrossover);
+    DebugUart_print(" B (0: never)\n");
 
-    __delay_cycles(100);                        // delay to allow Ref to settle
-    ADC12CTL0 |= ADC12ENC;                      // Enable conversion
+    appendStr(appendNum(appendStr(line, "WINS >="), copyCrossover, 0), "B");
+    Graphics_drawStringCentered(&g_sContext, (uint8_t *)line, AUTO_STRING_LENGTH, 48, 90, OPAQUE_TEXT);
+    Graphics_flushBuffer(&g_sContext);
 
+    WaitForKey();
+    Telemetry_resume();
 }
 
-// Function to sample voltage, and convert and store ADC value
-void sampleVoltage() {
+// Prints the logged voltage of the last LOG_DUMP_SECONDS on the debug UART
+// as CSV. Times restart with each reset, so older sessions can show up too.
+void DumpVoltageLog() {
+    uint32_t from = (timer > LOG_DUMP_SECONDS) ? timer - LOG_DUMP_SECONDS : 0;
+    uint16_t samples;
 
-    ADC12CTL0 &= ~ADC12SC;  // clear the start bit
-    ADC12CTL0 |= ADC12SC;   // Sampling and conversion start
-                            // Single conversion (single channel)
+    Telemetry_pause();              // the dump is text on the same UART
 
-    // Poll busy bit waiting for conversion to complete
-    while (ADC12CTL1 & ADC12BUSY)
-        __no_operation();
+    DebugUart_print("time,mV\n");
+    samples = FlashLog_read(from, timer, printLogSample);
+    DebugUart_print("# ");
+    DebugUart_printNum(samples);
+    DebugUart_print(" samples\n");
 
-    in_volt = ADC12MEM0; // Read results from conversion
-
-    __no_operation(); // SET BREAKPOINT HERE
+    Telemetry_resume();
 }
 
-// Returns voltage as a float, from ADC value
-float readVoltage(unsigned int adc_out) {
+// One CSV line, written straight to the UART: this runs at the bottom of
+// FlashLog_read's stack frame
+void printLogSample(uint32_t time, const int16_t *values, uint8_t numValues) {
+    DebugUart_printNum(time);
+    DebugUart_putc(',');
+    if (values[0] < 0) {
+        DebugUart_putc('-');
+        DebugUart_printNum(-(int32_t)values[0]);
+    } else {
+        DebugUart_printNum(values[0]);
+    }
+    DebugUart_print("\n");
+}
 
-    float voltage;
+// Waits for the key being held to be let go, then for the next press
+void WaitForKey() {
+    while (getKey() != 0)
+        ;
+    while (getKey() == 0)
+        ;
+}
 
-    voltage = (float)((adc_out * vref_pos) / (4095.0));
 
-    return voltage;
+// configures UCS
+void configUCS() {
+    P5SEL |= (BIT5 | BIT4 | BIT3 |BIT2);    // enables XT1CLK and XT2CLK, both crystal clocks
 }
 
-long unsigned int TimerSetValue(long unsigned int tempTimer) {
+// Function to configure voltage meter
+void configVoltmeter() {
 
-    long unsigned int reTimer = 0;
-    unsigned char w, r;
+    // Set Port 6 Pin 0 to FUNCTION mode for ADC
+    VOLT_PORT_SEL |= VOLT_PIN_FUNC;
 
-    w = (unsigned char) (tempTimer & 0xFF);
-    MasterSPIWrite(w);
-    r = SlaveSPIRead();
-    reTimer |= (((uint32_t)r));
+    // Median of 5 followed by an EMA with alpha = 1/8 (about 1/8 s at 64 Hz)
+    Median_init(&voltMedian, 5);
+    EMA_init(&voltEma, 3);
 
-    tempTimer >>= 8;
-    w = (unsigned char) (tempTimer & 0xFF);
-    MasterSPIWrite(w);
-    r = SlaveSPIRead();
-    reTimer |= (((uint32_t)r) << 8);
+    // Start background conversions of A0 against VCC = 3.3 V.
+    // Timer A0 triggers them and the ADC12 ISR stores the results, so
+    // reading the voltage never waits on the ADC.
+    ADCStream_start(&voltStream);
 
-    tempTimer >>= 16;
-    w = (unsigned char) (tempTimer & 0xFF);
-    MasterSPIWrite(w);
-    r = SlaveSPIRead();
-    reTimer |= (((uint32_t)r) << 16);
+}
 
-    tempTimer >>= 24;
-    w = (unsigned char) (tempTimer & 0xFF);
-    MasterSPIWrite(w);
-    r = SlaveSPIRead();
-    reTimer |= (((uint32_t)r) << 24);
+// Function to sample voltage, and convert and store ADC value
+void sampleVoltage() {
 
-    return reTimer;
+    in_volt = voltEma.value;        // Filtered background conversions of A0
 
+    __no_operation(); // SET BREAKPOINT HERE
 }
 
-//long unsigned int Send_4_Bytes(long unsigned int data_4_bytes) {
-//
-//    long unsigned int slaveRead_val = 0;
-//    unsigned char w, r;
-//
-//    w = (unsigned char) (data_4_bytes & 0xFF);
-//    MasterSPIWrite(w);
-//    r = SlaveSPIRead();
-//    slaveRead_val |= (((uint32_t)r));
-//
-//    data_4_bytes >>= 8;
-//    w = (unsigned char) (data_4_bytes & 0xFF);
-//    MasterSPIWrite(w);
-//    r = SlaveSPIRead();
-//    slaveRead_val |= (((uint32_t)r) << 8);
-//
-//    data_4_bytes >>= 16;
-//    w = (unsigned char) (data_4_bytes & 0xFF);
-//    MasterSPIWrite(w);
-//    r = SlaveSPIRead();
-//    slaveRead_val |= (((uint32_t)r) << 16);
-//
-//    data_4_bytes >>= 24;
-//    w = (unsigned char) (data_4_bytes & 0xFF);
-//    MasterSPIWrite(w);
-//    r = SlaveSPIRead();
-//    slaveRead_val |= (((uint32_t)r) << 24);
-//
-//    return slaveRead_val;
-//
-//}
+// Called from the ADC12 ISR with each block of A0 conversions
+void voltBlockReady(const uint16_t *block, uint8_t numSequences) {
+
+    uint8_t i;
+    for (i = 0; i < numSequences; i++) {
+        EMA_update(&voltEma, Median_update(&voltMedian, block[i]));
+        Telemetry_record(TELEM_CH_VOLT_ADC, block[i]);
+    }
+}
 
+// Returns voltage in millivolts, from ADC value
+unsigned int readVoltage(unsigned int adc_out) {
 
+    unsigned int voltage;
+
+    voltage = SensorConv_milliVolts(adc_out, vref_pos_mV);
+
+    return voltage;
+}
 
 // Function which takes a copy of global time count as its input argument
 // Convert the time in seconds that was passed in to Hour, Minutes and Seconds
@@ -396,23 +531,54 @@ void displayTime(long unsigned int inTime) {
 
 }
 
-// Function which takes a copy of voltage variable as its input argument
+// Writes n in decimal at out, padded with leading spaces to width
+// characters, and returns the end of the string. The reports are built
+// with this and appendStr(), as the project's minimal printf has no %u,
+// %lu or field widths.
+char *appendNum(char *out, unsigned long n, uint8_t width) {
+    char digits[10];
+    uint8_t i = 0;
+
+    do {
+        digits[i++] = '0' + n % 10;
+        n /= 10;
+    } while (n);
+
+    while (width-- > i)
+        *out++ = ' ';
+    while (i)
+        *out++ = digits[--i];
+    *out = '\0';
+    return out;
+}
+
+// Copies s to out and returns the end of the string
+char *appendStr(char *out, const char *s) {
+    while (*s)
+        *out++ = *s++;
+    *out = '\0';
+    return out;
+}
+
+// Function which takes a copy of voltage variable (in millivolts) as its input argument
 // Takes above voltage variable and creates ASCII array that is displayed
 void displayVoltage(unsigned int inVolt) {
 
     // Format array for TIME
-    unsigned char voltageASCII[10];
+    unsigned char voltageASCII[12];
 
-    voltageASCII[0] = ((int)(inVolt / 10)) + '0';
+    voltageASCII[0] = (inVolt / 1000) + '0';
     voltageASCII[1] =  '.';
-    voltageASCII[2] = ((int)(inVolt % 10)) + '0';
-    voltageASCII[3] = ' ';
-    voltageASCII[4] = 'V';
-    voltageASCII[5] = 'o';
-    voltageASCII[6] = 'l';
-    voltageASCII[7] = 't';
-    voltageASCII[8] = 's';
-    voltageASCII[9] = '\0';
+    voltageASCII[2] = ((inVolt / 100) % 10) + '0';
+    voltageASCII[3] = ((inVolt / 10) % 10) + '0';
+    voltageASCII[4] = (inVolt % 10) + '0';
+    voltageASCII[5] = ' ';
+    voltageASCII[6] = 'V';
+    voltageASCII[7] = 'o';
+    voltageASCII[8] = 'l';
+    voltageASCII[9] = 't';
+    voltageASCII[10] = 's';
+    voltageASCII[11] = '\0';
 
     Graphics_drawStringCentered(&g_sContext, voltageASCII, AUTO_STRING_LENGTH, 64, 80, TRANSPARENT_TEXT);
 
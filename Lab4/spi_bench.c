@@ -0,0 +1,125 @@
+/*
+ * spi_bench.c
+ *
+ *  SPI loopback stress test. See spi_bench.h.
+ */
+
+#include "spi_bench.h"
+#include "debug_uart.h"
+#include "spi_bus.h"
+#include "spi_slave.h"
+#include "timebase.h"
+
+// Longest wait for a frame's CS edge to be handled once the bus is done
+#define SPI_BENCH_TIMEOUT_TICKS TIMEBASE_MS_TO_TICKS(5)
+
+static uint8_t txFrame[SPI_BENCH_FRAME_LEN];
+static uint8_t rxFrame[SPI_BENCH_FRAME_LEN];
+static SPIBus_Xfer xfer;                // static to keep it off the stack
+static uint16_t prbsState = 0x7FFF;
+
+
+// PRBS-15 (x^15 + x^14 + 1), eight bits at a time
+static uint8_t prbsByte(void)
+{
+    uint8_t byte = 0, i;
+    uint16_t bit;
+
+    for (i = 0; i < 8; i++) {
+        bit = ((prbsState >> 14) ^ (prbsState >> 13)) & 1;
+        prbsState = ((prbsState << 1) | bit) & 0x7FFF;
+        byte = (byte << 1) | bit;
+    }
+    return byte;
+}
+
+static uint8_t countBits(uint8_t x)
+{
+    uint8_t n = 0;
+
+    while (x) {
+        x &= x - 1;
+        n++;
+    }
+    return n;
+}
+
+// Sends SPI_BENCH_FRAMES frames at one bit rate divider and checks what
+// the slave received. The link must not be in use by anything else.
+void SPIBench_run(uint8_t device, uint16_t clkTicks, SPIBench_Result *result)
+{
+    const SPISlave_Stats *slave = SPISlave_getStats();
+    uint16_t overrunsBefore = slave->rxOverruns + slave->bufferOverruns;
+    uint32_t start, ticks;
+    uint16_t frame, i, received;
+
+    result->clkTicks = clkTicks;
+    result->bytes = 0;
+    result->byteErrors = 0;
+    result->bitErrors = 0;
+    result->lostBytes = 0;
+
+    while (SPISlave_read(rxFrame, sizeof(rxFrame)))
+        ;                               // nothing stale to compare against
+
+    SPIBus_setClock(device, clkTicks);
+
+    xfer.tx = txFrame;
+    xfer.rx = 0;
+    xfer.len = SPI_BENCH_FRAME_LEN;
+    xfer.device = device;
+    xfer.priority = SPI_BUS_PRIO_NORMAL;
+    xfer.done = 0;
+
+    start = Timebase_ticks();
+
+    for (frame = 0; frame < SPI_BENCH_FRAMES; frame++) {
+        uint32_t waitStart;
+
+        for (i = 0; i < SPI_BENCH_FRAME_LEN; i++)
+            txFrame[i] = prbsByte();
+
+        SPIBus_transfer(&xfer);
+
+        waitStart = Timebase_ticks();
+        while (!SPISlave_framesWaiting() &&
+               (Timebase_ticks() - waitStart < SPI_BENCH_TIMEOUT_TICKS))
+            ;
+        received = SPISlave_read(rxFrame, sizeof(rxFrame));
+
+        for (i = 0; i < received; i++) {
+            uint8_t diff = rxFrame[i] ^ txFrame[i];
+            if (diff) {
+                result->byteErrors++;
+                result->bitErrors += countBits(diff);
+            }
+        }
+        result->lostBytes += SPI_BENCH_FRAME_LEN - received;
+        result->bytes += SPI_BENCH_FRAME_LEN;
+    }
+
+    ticks = Timebase_ticks() - start;
+    result->bytesPerSec = ticks ? (result->bytes * TIMEBASE_TICKS_PER_SEC / ticks) : 0;
+    result->overruns = slave->rxOverruns + slave->bufferOverruns - overrunsBefore;
+}
+
+// Prints one report line on the debug UART, e.g.
+// "div 8: 10240 B/s, 4096 B, 0 byte err, 0 bit err, 0 lost, 0 ovr"
+void SPIBench_print(const SPIBench_Result *result)
+{
+    DebugUart_print("div ");
+    DebugUart_printNum(result->clkTicks);
+    DebugUart_print(": ");
+    DebugUart_printNum(result->bytesPerSec);
+    DebugUart_print(" B/s, ");
+    DebugUart_printNum(result->bytes);
+    DebugUart_print(" B, ");
+    DebugUart_printNum(result->byteErrors);
+    DebugUart_print(" byte err, ");
+    DebugUart_printNum(result->bitErrors);
+    DebugUart_print(" bit err, ");
+    DebugUart_printNum(result->lostBytes);
+    DebugUart_print(" lost, ");
+    DebugUart_printNum(result->overruns);
+    DebugUart_print(" ovr\n");
+}
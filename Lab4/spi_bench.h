@@ -0,0 +1,34 @@
+/*
+ * spi_bench.h
+ *
+ *  Stress test and throughput benchmark for the UCB0 -> UCB1 loopback.
+ *  For each bit rate divider in a list, frames of PRBS-15 bytes are sent
+ *  through the SPI bus and read back from the interrupt-driven slave
+ *  (spi_slave.h). Every received byte is compared with what was sent, so
+ *  each setting gets its sustained throughput (including the per-frame
+ *  CS and interrupt overhead) and its byte, bit and lost-byte counts.
+ */
+
+#ifndef SPI_BENCH_H_
+#define SPI_BENCH_H_
+
+#include <stdint.h>
+
+#define SPI_BENCH_FRAME_LEN     64      // bytes per frame, fits the slave ring buffer
+#define SPI_BENCH_FRAMES        64      // frames per divider setting
+
+typedef struct SPIBench_Result
+{
+    uint16_t clkTicks;          // UCB0 bit rate divider
+    uint32_t bytesPerSec;       // sustained, over all frames of the setting
+    uint32_t bytes;             // bytes sent
+    uint16_t byteErrors;        // bytes received with a wrong value
+    uint32_t bitErrors;         // bits wrong in those bytes
+    uint16_t lostBytes;         // bytes never received, including dropped frames
+    uint16_t overruns;          // UCB1 UCOE and ring buffer overruns
+} SPIBench_Result;
+
+void SPIBench_run(uint8_t device, uint16_t clkTicks, SPIBench_Result *result);
+void SPIBench_print(const SPIBench_Result *result);
+
+#endif /* SPI_BENCH_H_ */
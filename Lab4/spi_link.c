@@ -0,0 +1,86 @@
+/*
+ * spi_link.c
+ *
+ *  Framed messages over the SPI loopback. See spi_link.h.
+ */
+
+#include "spi_link.h"
+#include "crc16.h"
+
+static uint8_t linkDevice = SPI_BUS_NO_DEVICE;
+static uint8_t txFrame[SPI_LINK_MAX_FRAME];     // frame being sent, owned by the bus until done
+static SPIBus_Xfer linkXfer;
+
+
+// Sends frames to a device already registered on the SPI bus
+void SPILink_init(uint8_t device)
+{
+    linkDevice = device;
+
+    linkXfer.tx = txFrame;
+    linkXfer.rx = 0;
+    linkXfer.device = device;
+    linkXfer.priority = SPI_BUS_PRIO_NORMAL;
+    linkXfer.done = 0;
+    linkXfer.state = SPI_XFER_IDLE;
+}
+
+// Frames the payload and queues it as one bus transaction. Waits for the
+// previous frame to finish first, since the frame buffer is reused.
+// Returns 0 if the payload is too long.
+uint8_t SPILink_send(const uint8_t *payload, uint8_t len)
+{
+    uint16_t crc;
+    uint8_t i;
+
+    if ((len > SPI_LINK_MAX_PAYLOAD) || (linkDevice == SPI_BUS_NO_DEVICE))
+        return 0;
+
+    SPILink_wait();
+
+    txFrame[0] = len;
+    for (i = 0; i < len; i++)
+        txFrame[i + 1] = payload[i];
+
+    crc = CRC16_compute(txFrame, len + 1);
+    txFrame[len + 1] = crc >> 8;
+    txFrame[len + 2] = crc & 0xFF;
+
+    linkXfer.len = SPI_LINK_FRAME_LEN(len);
+    SPIBus_submit(&linkXfer);
+    return 1;
+}
+
+uint8_t SPILink_isSending(void)
+{
+    return SPIBus_isBusy(&linkXfer);
+}
+
+// Blocks until the last frame has left the shift register and CS is released
+void SPILink_wait(void)
+{
+    SPIBus_wait(&linkXfer);
+}
+
+// Checks a received frame and copies its payload out. Returns the payload
+// length, or SPI_LINK_BAD_FRAME if the length or CRC does not match.
+uint8_t SPILink_decode(const uint8_t *frame, uint16_t frameLen, uint8_t *payload)
+{
+    uint8_t len, i;
+    uint16_t crc;
+
+    if (frameLen < SPI_LINK_FRAME_LEN(0))
+        return SPI_LINK_BAD_FRAME;
+
+    len = frame[0];
+    if ((len > SPI_LINK_MAX_PAYLOAD) || (frameLen != SPI_LINK_FRAME_LEN(len)))
+        return SPI_LINK_BAD_FRAME;
+
+    crc = CRC16_compute(frame, len + 1);
+    if ((frame[len + 1] != (crc >> 8)) || (frame[len + 2] != (crc & 0xFF)))
+        return SPI_LINK_BAD_FRAME;
+
+    for (i = 0; i < len; i++)
+        payload[i] = frame[i + 1];
+    return len;
+}
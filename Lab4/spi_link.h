@@ -0,0 +1,37 @@
+/*
+ * spi_link.h
+ *
+ *  Framed messages over the UCB0 -> UCB1 SPI loopback. A message goes out
+ *  as a single SPI bus transaction, so CS (P8.2) is asserted once for the
+ *  whole frame:
+ *
+ *      len | payload (len bytes) | CRC high | CRC low
+ *
+ *  The CRC is CRC-16/CCITT (crc16.h, on the CRC16 module) over the length
+ *  byte and the payload. The receiving side hands a complete frame to
+ *  SPILink_decode(), which checks the length and the CRC.
+ */
+
+#ifndef SPI_LINK_H_
+#define SPI_LINK_H_
+
+#include <stdint.h>
+#include "spi_bus.h"
+
+#define SPI_LINK_MAX_PAYLOAD    32
+
+// Bytes on the wire for a payload of n bytes
+#define SPI_LINK_FRAME_LEN(n)   ((n) + 3)
+#define SPI_LINK_MAX_FRAME      SPI_LINK_FRAME_LEN(SPI_LINK_MAX_PAYLOAD)
+
+// Returned by SPILink_decode for a frame that fails its checks
+#define SPI_LINK_BAD_FRAME      0xFF
+
+void SPILink_init(uint8_t device);
+uint8_t SPILink_send(const uint8_t *payload, uint8_t len);
+uint8_t SPILink_isSending(void);
+void SPILink_wait(void);
+
+uint8_t SPILink_decode(const uint8_t *frame, uint16_t frameLen, uint8_t *payload);
+
+#endif /* SPI_LINK_H_ */
@@ -0,0 +1,223 @@
+/*
+ * spi_slave.c
+ *
+ *  USCI_B1 SPI slave with a receive ring buffer and CS-delimited frames.
+ *  See spi_slave.h.
+ */
+
+#include "spi_slave.h"
+
+#define RING_MASK       (SPI_SLAVE_BUFFER_LEN - 1)
+
+typedef struct Frame
+{
+    uint8_t start;              // ring index of the first byte
+    uint8_t len;
+} Frame;
+
+static uint8_t ring[SPI_SLAVE_BUFFER_LEN];
+static volatile uint8_t head;           // next byte written by the ISR
+static volatile uint8_t tail;           // first byte not yet read
+static uint8_t frameStart;              // ring index where the open frame began
+static uint8_t frameDamaged;            // the open frame lost a byte
+static uint8_t inFrame;                 // CS is asserted
+
+static Frame frames[SPI_SLAVE_MAX_FRAMES];
+static volatile uint8_t frameHead;
+static volatile uint8_t frameCount;
+
+static SPISlave_Stats stats;
+
+
+static void openFrame(void);
+
+// Moves one byte from RXBUF into the ring. Called with interrupts disabled.
+static void receive(void)
+{
+    uint8_t c;
+
+    if (!inFrame)
+        openFrame();                    // its CS edge was missed
+
+    if (SPI_SLAVE_REG_STAT & UCOE) {
+        stats.rxOverruns++;
+        frameDamaged = 1;
+    }
+    c = SPI_SLAVE_REG_RXBUF;            // also clears UCOE and UCRXIFG
+    stats.bytes++;
+
+    if (((head - tail) & 0xFF) >= SPI_SLAVE_BUFFER_LEN) {
+        stats.bufferOverruns++;
+        frameDamaged = 1;
+        return;
+    }
+
+    ring[head & RING_MASK] = c;
+    head++;
+}
+
+// CS went low: everything from here on belongs to a new frame
+static void openFrame(void)
+{
+    inFrame = 1;
+    frameStart = head;
+    frameDamaged = 0;
+}
+
+// CS went high: queues the frame, or drops it and gives its bytes back
+static uint8_t closeFrame(void)
+{
+    uint8_t len = head - frameStart;
+
+    inFrame = 0;
+
+    if (len == 0)
+        return 0;
+
+    if (frameDamaged || (frameCount >= SPI_SLAVE_MAX_FRAMES)) {
+        stats.framesDropped++;
+        head = frameStart;
+        return 0;
+    }
+
+    frames[(frameHead + frameCount) % SPI_SLAVE_MAX_FRAMES].start = frameStart;
+    frames[(frameHead + frameCount) % SPI_SLAVE_MAX_FRAMES].len = len;
+    frameCount++;
+    stats.frames++;
+    return 1;
+}
+
+
+// Configures UCB1 as a slave receiving into the ring buffer and starts
+// capturing CS edges
+void SPISlave_init(void)
+{
+    head = 0;
+    tail = 0;
+    frameHead = 0;
+    frameCount = 0;
+    inFrame = 0;
+    SPISlave_resetStats();
+
+    // SCLK, SOMI and SIMO for peripheral mode
+    SPI_SLAVE_PORT_SEL |= (SPI_SLAVE_PIN_MOSI | SPI_SLAVE_PIN_MISO | SPI_SLAVE_PIN_SCLK);
+
+    // CS is an input with a pull-up, routed to the TB0.1 capture input
+    SPI_SLAVE_PORT_DIR &= ~SPI_SLAVE_PIN_CS;
+    SPI_SLAVE_PORT_REN |= SPI_SLAVE_PIN_CS;
+    SPI_SLAVE_PORT_OUT |= SPI_SLAVE_PIN_CS;
+    PMAPKEYID = PMAPKEY;
+    P4MAP0 = PM_TB0CCR1A;
+    PMAPKEYID = 0;
+    SPI_SLAVE_PORT_SEL |= SPI_SLAVE_PIN_CS;
+
+    // Capture both edges of CS. The buzzer reprograms TB0CTL but never
+    // stops the timer.
+    if ((TB0CTL & MC_3) == 0)
+        TB0CTL = TBSSEL__ACLK | MC__CONTINUOUS;
+    TB0CCTL1 = CM_3 | CCIS_0 | CAP | CCIE;
+
+    // Capture data on the first edge, inactive low clock, MSB first,
+    // 8 bits, slave, synchronous. 3-wire mode: P4.0 now feeds the timer
+    // instead of UCB1STE, and framing is done from its edges.
+    SPI_SLAVE_REG_CTL1 |= UCSWRST;
+    SPI_SLAVE_REG_CTL0 = UCCKPH | UCMSB | UCMODE_0 | UCSYNC;
+    SPI_SLAVE_REG_CTL1 &= ~UCSSEL_3;    // clocked by the master's SCLK
+    SPI_SLAVE_REG_CTL1 &= ~UCSWRST;
+    SPI_SLAVE_REG_IFG &= ~UCRXIFG;
+    SPI_SLAVE_REG_IE |= UCRXIE;
+
+    if (!(P4IN & SPI_SLAVE_PIN_CS))
+        openFrame();                    // started mid-frame, keep what follows
+}
+
+// Copies the oldest complete frame into frame and frees its space.
+// Returns its length, or 0 if no frame is waiting. A frame longer than
+// maxLen is cut to maxLen.
+uint16_t SPISlave_read(uint8_t *frame, uint16_t maxLen)
+{
+    __istate_t intState;
+    Frame f;
+    uint16_t i;
+
+    if (frameCount == 0)
+        return 0;
+
+    f = frames[frameHead];
+    for (i = 0; (i < f.len) && (i < maxLen); i++)
+        frame[i] = ring[(uint8_t)(f.start + i) & RING_MASK];
+
+    intState = __get_interrupt_state();
+    __disable_interrupt();
+    frameHead = (frameHead + 1) % SPI_SLAVE_MAX_FRAMES;
+    frameCount--;
+    tail = f.start + f.len;
+    __set_interrupt_state(intState);
+
+    return i;
+}
+
+uint8_t SPISlave_framesWaiting(void)
+{
+    return frameCount;
+}
+
+const SPISlave_Stats *SPISlave_getStats(void)
+{
+    return &stats;
+}
+
+void SPISlave_resetStats(void)
+{
+    stats.bytes = 0;
+    stats.frames = 0;
+    stats.rxOverruns = 0;
+    stats.bufferOverruns = 0;
+    stats.framesDropped = 0;
+    stats.csOverruns = 0;
+}
+
+//------------------------------------------------------------------------------
+// USCI_B1 Interrupt Service Routine
+//------------------------------------------------------------------------------
+#pragma vector=USCI_B1_VECTOR
+__interrupt void USCI_B1_ISR(void)
+{
+    if (SPI_SLAVE_REG_IFG & UCRXIFG)
+        receive();
+}
+
+//------------------------------------------------------------------------------
+// Timer B0 CCR1 Interrupt Service Routine, CS edges
+//------------------------------------------------------------------------------
+#pragma vector=TIMER0_B1_VECTOR
+__interrupt void TIMER0_B1_ISR(void)
+{
+    switch (TB0IV) {
+    case TB0IV_TBCCR1:
+        if (TB0CCTL1 & COV) {
+            // CS changed again before this interrupt ran, so the bytes
+            // of the frames around the missed edge can't be told apart.
+            // The open frame is dropped and CCI gives the state now.
+            TB0CCTL1 &= ~COV;
+            stats.csOverruns++;
+            if (SPI_SLAVE_REG_IFG & UCRXIFG)
+                receive();
+            frameDamaged = 1;
+            if (inFrame)
+                closeFrame();
+            if (!(TB0CCTL1 & CCI))
+                openFrame();
+        } else if (TB0CCTL1 & CCI) {
+            // Rising edge. The last byte may still be waiting for the
+            // lower priority USCI_B1 interrupt.
+            if (SPI_SLAVE_REG_IFG & UCRXIFG)
+                receive();
+            if (inFrame && closeFrame())
+                __bic_SR_register_on_exit(LPM3_bits);
+        } else {
+            openFrame();
+        }
+        break;
+    }
+}
@@ -0,0 +1,64 @@
+/*
+ * spi_slave.h
+ *
+ *  Interrupt-driven SPI slave on USCI_B1 (P4.1 SIMO, P4.2 SOMI, P4.3 CLK)
+ *  for the Lab 4 loopback. Every byte is taken from RXBUF in the USCI_B1
+ *  interrupt and stored in a ring buffer, so the slave keeps up with the
+ *  master however busy the main loop is.
+ *
+ *  Frames are delimited by the chip select on P4.0. Port 4 has no pin
+ *  interrupts on the F5529, so P4.0 is port-mapped to the Timer B0 CCR1
+ *  capture input and both of its edges are captured: a falling edge opens
+ *  a frame, a rising edge closes it. If CS changes twice before the
+ *  capture interrupt runs, the capture overflows (COV); the frame around
+ *  the missed edge is dropped and counted. Timer B0 also drives the
+ *  buzzer; the buzzer functions leave CCR1 alone.
+ *
+ *  Complete frames are taken with the non-blocking SPISlave_read(). A frame
+ *  that lost bytes to a full ring buffer, or that arrives while the frame
+ *  queue is full, is dropped and counted rather than handed on.
+ */
+
+#ifndef SPI_SLAVE_H_
+#define SPI_SLAVE_H_
+
+#include <msp430.h>
+#include <stdint.h>
+
+#define SPI_SLAVE_BUFFER_LEN    128     // bytes, a power of two
+#define SPI_SLAVE_MAX_FRAMES    8       // complete frames waiting to be read
+
+#define SPI_SLAVE_REG_CTL0      UCB1CTL0
+#define SPI_SLAVE_REG_CTL1      UCB1CTL1
+#define SPI_SLAVE_REG_IE        UCB1IE
+#define SPI_SLAVE_REG_IFG       UCB1IFG
+#define SPI_SLAVE_REG_STAT      UCB1STAT
+#define SPI_SLAVE_REG_RXBUF     UCB1RXBUF
+
+#define SPI_SLAVE_PORT_SEL      P4SEL
+#define SPI_SLAVE_PORT_DIR      P4DIR
+#define SPI_SLAVE_PORT_REN      P4REN
+#define SPI_SLAVE_PORT_OUT      P4OUT
+#define SPI_SLAVE_PIN_MOSI      BIT1
+#define SPI_SLAVE_PIN_MISO      BIT2
+#define SPI_SLAVE_PIN_SCLK      BIT3
+#define SPI_SLAVE_PIN_CS        BIT0
+
+typedef struct SPISlave_Stats
+{
+    uint32_t bytes;             // bytes received
+    uint16_t frames;            // frames queued for SPISlave_read()
+    uint16_t rxOverruns;        // UCOE: a byte arrived before the last was read
+    uint16_t bufferOverruns;    // bytes lost to a full ring buffer
+    uint16_t framesDropped;     // frames lost to overruns or a full frame queue
+    uint16_t csOverruns;        // COV: a CS edge came before the last was handled
+} SPISlave_Stats;
+
+void SPISlave_init(void);
+uint16_t SPISlave_read(uint8_t *frame, uint16_t maxLen);
+uint8_t SPISlave_framesWaiting(void);
+
+const SPISlave_Stats *SPISlave_getStats(void);
+void SPISlave_resetStats(void);
+
+#endif /* SPI_SLAVE_H_ */
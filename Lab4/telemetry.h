@@ -0,0 +1,58 @@
+/*
+ * telemetry.h
+ *
+ *  Binary telemetry stream to a PC on the USCI_A1 back-channel UART
+ *  (debug_uart.h sets up the port and baud rate). Each record is a time
+ *  base timestamp, a channel number and a signed value. Records collect
+ *  in one half of a double buffer while DMA feeds the other half to
+ *  UCA1TXBUF, so Telemetry_record() never waits for the UART.
+ *
+ *  Packets on the wire, multi-byte fields LSB first except the CRC:
+ *
+ *      0xA5 0x5A | seq | count | count records | CRC high | CRC low
+ *      record:   ticks (4) | channel (1) | value (4)
+ *
+ *  seq counts packets, so the receiver can tell that some were lost. The
+ *  CRC is CRC-16/CCITT (crc16.h) over seq, count and the records. A packet
+ *  goes out as soon as the DMA is free: at low rates each carries one
+ *  record, at high rates up to TELEMETRY_MAX_RECORDS. A record that finds
+ *  both halves busy is dropped and counted. Plain text on the same UART
+ *  (DebugUart_print) goes between Telemetry_pause() and Telemetry_resume().
+ *
+ *  Other packets, built complete by their owner (lcd_mirror.h), share the
+ *  stream through Telemetry_send(). One can be queued at a time; it goes
+ *  out after the packet on the wire, ahead of waiting records. Receivers
+ *  tell the kinds apart by the second sync byte.
+ *
+ *  The PC side is tools/telemetry/telemrx.c, which writes CSV.
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <msp430.h>
+#include <stdint.h>
+
+#define TELEMETRY_MAX_RECORDS   16      // per packet, 150 bytes
+
+#define TELEMETRY_SYNC1         0xA5
+#define TELEMETRY_SYNC2         0x5A
+#define TELEMETRY_HEADER_LEN    4
+#define TELEMETRY_RECORD_LEN    9
+
+// Bytes on the wire for a packet of n records
+#define TELEMETRY_PACKET_LEN(n) (TELEMETRY_HEADER_LEN + (n) * TELEMETRY_RECORD_LEN + 2)
+
+#define TELEMETRY_REG_TXBUF     UCA1TXBUF
+#define TELEMETRY_REG_IFG       UCA1IFG
+#define TELEMETRY_REG_STAT      UCA1STAT
+
+uint8_t Telemetry_init(void);
+void Telemetry_record(uint8_t channel, int32_t value);
+void Telemetry_pause(void);
+void Telemetry_resume(void);
+uint16_t Telemetry_dropped(void);
+uint8_t Telemetry_send(const uint8_t *packet, uint16_t len);
+uint8_t Telemetry_sendIdle(void);
+
+#endif /* TELEMETRY_H_ */
@@ -0,0 +1,42 @@
+/*
+ * timebase.h
+ *
+ *  Monotonic time base shared by everything that needs to measure time.
+ *  Timer A1 counts ACLK (32768 Hz) in continuous mode and its overflow
+ *  interrupt extends the 16-bit count with a 32-bit overflow counter, so
+ *  time never drifts and never needs correcting with leap counts.
+ *
+ *  Conversions are exact: one overflow is 2 s, i.e. 2000 ms or 2000000 us,
+ *  and within an overflow ms = ticks * 125 / 4096 and us = ticks * 15625 / 512.
+ *
+ *  Timer A1 CCR0 stays free for the LCD VCOM toggle (see configDisplay) and
+ *  CCR1 is handed to one compare handler, the software timers (swtimer.h).
+ *  Nothing may stop, clear or reconfigure Timer A1.
+ */
+
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
+#include <msp430.h>
+#include <stdint.h>
+
+#define TIMEBASE_TICKS_PER_SEC      32768UL
+
+// Durations to ticks, rounded to the nearest tick (up to 17 minutes in ms, 8 s in us)
+#define TIMEBASE_MS_TO_TICKS(ms)    ((((uint32_t)(ms)) * 4096UL + 62) / 125)
+#define TIMEBASE_US_TO_TICKS(us)    ((((uint32_t)(us)) * 512UL + 7812) / 15625)
+
+// Runs from the Timer A1 ISR when CCR1 matches. Returns nonzero to wake
+// the CPU from low power mode on exit from the ISR.
+typedef uint8_t (*Timebase_CompareHandler)(void);
+
+void Timebase_init(void);
+void Timebase_setCompareHandler(Timebase_CompareHandler handler);
+
+uint32_t Timebase_ticks(void);          // wraps after 36.4 hours
+uint64_t Timebase_ticks64(void);
+uint32_t Timebase_seconds(void);
+uint32_t now_ms(void);                  // wraps after 49.7 days
+uint32_t now_us(void);                  // wraps after 71.6 minutes
+
+#endif /* TIMEBASE_H_ */
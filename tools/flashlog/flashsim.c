@@ -0,0 +1,318 @@
+/*
+ * flashsim.c
+ *
+ *  Host runner for the flash sample log (Lab4/flash_log.h, the same file
+ *  as Lab3's). Built with HOST_BUILD, flash_log.c keeps its ring of
+ *  segments in a RAM array with the flash erase and write rules, and this
+ *  feeds it scripted sessions of samples and reads them back.
+ *
+ *  Every sample appended is remembered. A read must return a subsequence
+ *  of them, in order and with the same times and values, and every sample
+ *  it leaves out after the first one returned must repeat the values of
+ *  the last one returned before it: the log may fold unchanged samples,
+ *  never lose a change. Samples before the first one returned are history
+ *  the ring has overwritten, allowed only where a scenario fills the ring.
+ *  A range read must return exactly the samples of the full read in the
+ *  range.
+ *
+ *  Scenarios:
+ *      day         a day of 1 Hz readings with noise, a steady stretch
+ *                  that needs filler records, a gap that starts a new
+ *                  block and a reset partway through; fills the ring
+ *      restart     two sessions whose clock starts over after a reset,
+ *                  read back in session order
+ *      foreign     a log kept with another value count is erased, and
+ *                  two values per sample round-trip
+ *
+ *  The exit status is 0 when every check passes.
+ *
+ *  Build:  cc -O2 -DHOST_BUILD -I../../Lab4 -o flashsim flashsim.c \
+ *             ../../Lab4/flash_log.c ../../Lab4/crc16.c -lm
+ *  Use:    flashsim [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "flash_log.h"
+
+#define MAX_SAMPLES     200000
+
+typedef struct Sample
+{
+    uint32_t time;
+    int16_t values[FLASH_LOG_MAX_VALUES];
+} Sample;
+
+static Sample logged[MAX_SAMPLES];      // everything appended, in order
+static uint32_t numLogged;
+static Sample readBack[MAX_SAMPLES];    // what the last read returned
+static uint32_t numRead;
+static uint8_t numValues;
+
+static int verbose;
+static int errors;
+
+
+static void fail(const char *scenario, const char *what, uint32_t time)
+{
+    fprintf(stderr, "flashsim: %s: %s at %lu\n", scenario, what, (unsigned long)time);
+    errors++;
+}
+
+static int sameValues(const int16_t *a, const int16_t *b)
+{
+    uint8_t v;
+
+    for (v = 0; v < numValues; v++)
+        if (a[v] != b[v])
+            return 0;
+    return 1;
+}
+
+static void startLog(uint8_t values)
+{
+    numValues = values;
+    numLogged = 0;
+    FlashLog_init(values);
+}
+
+static void append(uint32_t time, const int16_t *values)
+{
+    uint8_t v;
+
+    logged[numLogged].time = time;
+    for (v = 0; v < numValues; v++)
+        logged[numLogged].values[v] = values[v];
+    numLogged++;
+
+    FlashLog_append(time, values);
+}
+
+static void collect(uint32_t time, const int16_t *values, uint8_t count)
+{
+    uint8_t v;
+
+    if (count != numValues) {
+        fail("read", "wrong value count", time);
+        return;
+    }
+    if (numRead >= MAX_SAMPLES)
+        return;
+
+    readBack[numRead].time = time;
+    for (v = 0; v < count; v++)
+        readBack[numRead].values[v] = values[v];
+    numRead++;
+}
+
+static uint16_t readLog(uint32_t from, uint32_t to)
+{
+    uint16_t samples;
+
+    numRead = 0;
+    samples = FlashLog_read(from, to, collect);
+    if (samples != (uint16_t)numRead)
+        fail("read", "returned count differs from the samples passed", 0);
+    return samples;
+}
+
+// Checks the full read against everything appended. Returns how many
+// samples came before the first one read, lost to the ring wrapping.
+static uint32_t checkFullRead(const char *scenario)
+{
+    uint32_t k = 0, r;
+
+    for (r = 0; r < numRead; r++) {
+        const Sample *s = &readBack[r];
+
+        // Find the sample read; the ones passed over must be repeats
+        while ((k < numLogged) &&
+               ((logged[k].time != s->time) || !sameValues(logged[k].values, s->values))) {
+            if ((r > 0) && !sameValues(logged[k].values, readBack[r - 1].values)) {
+                fail(scenario, "change missing from the log", logged[k].time);
+                return 0;
+            }
+            k++;
+        }
+        if (k == numLogged) {
+            fail(scenario, "sample read that was never logged", s->time);
+            return 0;
+        }
+        k++;
+    }
+
+    if (numRead == 0) {
+        if (numLogged)
+            fail(scenario, "nothing read back", 0);
+        return numLogged;
+    }
+
+    for (; k < numLogged; k++)
+        if (!sameValues(logged[k].values, readBack[numRead - 1].values)) {
+            fail(scenario, "change after the last sample read", logged[k].time);
+            break;
+        }
+
+    for (k = 0; (k < numLogged) && (logged[k].time != readBack[0].time); k++)
+        ;
+    return k;
+}
+
+// A range read must give the full read's samples in [from, to]
+static void checkRangeRead(const char *scenario, uint32_t from, uint32_t to)
+{
+    static Sample full[MAX_SAMPLES];
+    uint32_t numFull = numRead, i, j = 0;
+
+    for (i = 0; i < numFull; i++)
+        full[i] = readBack[i];
+
+    readLog(from, to);
+    for (i = 0; i < numFull; i++) {
+        if ((full[i].time < from) || (full[i].time > to))
+            continue;
+        if ((j >= numRead) || (readBack[j].time != full[i].time) ||
+            !sameValues(readBack[j].values, full[i].values)) {
+            fail(scenario, "range read differs from the full read", full[i].time);
+            break;
+        }
+        j++;
+    }
+    if (j != numRead)
+        fail(scenario, "range read returned samples outside the range", from);
+
+    if (verbose)
+        printf("  range %lu-%lu: %lu samples\n", (unsigned long)from, (unsigned long)to,
+               (unsigned long)numRead);
+
+    // Leave the full read in readBack for the caller
+    for (i = 0; i < numFull; i++)
+        readBack[i] = full[i];
+    numRead = numFull;
+}
+
+// A day of 1 Hz readings. A slow swing with some noise, 2000 s held
+// steady (filler records), 3000 s with no samples (a new block) and a
+// reset at 40000 s.
+static void scenarioDay(void)
+{
+    const uint32_t start = 1000, length = 86400;
+    uint32_t t, lost;
+    int16_t value;
+
+    FlashLog_erase();
+    startLog(1);
+    srand(1);
+
+    for (t = start; t < start + length; t++) {
+        if ((t >= start + 60000) && (t < start + 63000))
+            continue;                   // logging stopped
+        if (t == start + 40000)
+            FlashLog_init(1);           // reset: seals the open block
+
+        if ((t >= start + 50000) && (t < start + 52000))
+            value = 200;
+        else
+            value = (int16_t)(230 + 30 * sin(t / 7000.0) + (((rand() % 100) < 3) ? 1 : 0));
+        append(t, &value);
+    }
+
+    readLog(0, 0xFFFFFFFF);
+    lost = checkFullRead("day");
+    if (lost == 0)
+        fail("day", "a day should overwrite the oldest blocks", 0);
+
+    printf("day: %lu samples logged, %lu read back, the last %.1f hours kept\n",
+           (unsigned long)numLogged, (unsigned long)numRead,
+           (start + length - readBack[0].time) / 3600.0);
+
+    checkRangeRead("day", start + 80000, start + 80100);
+    checkRangeRead("day", start + 50000 - 10, start + 52000 + 10);
+    checkRangeRead("day", start + 59990, start + 63010);
+}
+
+// Two sessions, the clock starting over at 0 after a reset in between
+static void scenarioRestart(void)
+{
+    uint32_t t, lost;
+    int16_t value;
+
+    FlashLog_erase();
+    startLog(1);
+
+    for (t = 0; t < 600; t++) {
+        value = (int16_t)(t / 7);
+        append(t, &value);
+    }
+    FlashLog_init(1);
+    for (t = 0; t < 600; t++) {
+        value = (int16_t)(-1000 - t / 5);
+        append(t, &value);
+    }
+
+    readLog(0, 0xFFFFFFFF);
+    lost = checkFullRead("restart");
+    if (lost)
+        fail("restart", "samples lost without the ring filling", 0);
+    if ((numRead == 0) || (readBack[numRead - 1].values[0] != -1000 - 599 / 5))
+        fail("restart", "the second session is not read last", 0);
+
+    printf("restart: %lu samples logged, %lu read back\n",
+           (unsigned long)numLogged, (unsigned long)numRead);
+}
+
+// A one-value log, then the firmware starting with two values per sample
+static void scenarioForeign(void)
+{
+    uint32_t t, lost;
+    int16_t values[2];
+
+    FlashLog_erase();
+    startLog(1);
+    for (t = 0; t < 300; t++) {
+        values[0] = (int16_t)(t / 3);
+        append(t, values);
+    }
+
+    startLog(2);
+    if (readLog(0, 0xFFFFFFFF) != 0)
+        fail("foreign", "one-value blocks read as two-value ones", 0);
+
+    for (t = 0; t < 3000; t++) {
+        values[0] = (int16_t)(t / 11);
+        values[1] = (int16_t)(32767 - (int16_t)(t / 4) * 9);
+        append(t, values);
+    }
+    readLog(0, 0xFFFFFFFF);
+    lost = checkFullRead("foreign");
+    if (lost)
+        fail("foreign", "samples lost without the ring filling", 0);
+
+    printf("foreign: %lu two-value samples logged, %lu read back\n",
+           (unsigned long)numLogged, (unsigned long)numRead);
+}
+
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+        case 'v': verbose++; break;
+        default:
+            fprintf(stderr, "usage: flashsim [-v]\n");
+            return 1;
+        }
+    }
+
+    scenarioDay();
+    scenarioRestart();
+    scenarioForeign();
+
+    printf("%s\n", errors ? "FAILED" : "all checks passed");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,515 @@
+/*
+ * lcdview.c
+ *
+ *  Host viewer for the display mirror of Lab3/Lab4 (lcd_mirror.h). Reads
+ *  the telemetry stream from the LaunchPad's application COM port, keeps
+ *  a copy of the 128x128 display buffer up to date from the changed lines
+ *  in each packet, and redraws it in the terminal, two pixel rows to a
+ *  character. Telemetry record packets on the same stream are skipped
+ *  whole, so telemrx and lcdview can be pointed at recordings of the same
+ *  session. Lines that have not arrived yet show as grey.
+ *
+ *  With -o the picture is also written to a PBM file after every packet,
+ *  for keeping or for an image viewer that reloads it. A summary of
+ *  packets, lines, bytes, CRC errors and lost packets goes to stderr at
+ *  the end.
+ *
+ *  With -b the program is a stand-in for the board instead: it opens a
+ *  pseudo-terminal, prints the path to give the viewer, and sends a
+ *  made-up screen with a moving bar and a counter, changed lines only.
+ *  -e n damages every nth packet.
+ *
+ *  Build:  cc -O2 -o lcdview lcdview.c
+ *  Use:    lcdview [-s baud] [-o screen.pbm] /dev/ttyACM0
+ *          lcdview -b [-f frames/s] [-e n]
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+
+#define SYNC1           0xA5
+#define SYNC2_MIRROR    0xC3
+#define SYNC2_TELEMETRY 0x5A
+
+#define HEADER_LEN      7
+#define FLAG_ROTATE_90  0x01
+
+#define LINES           128
+#define LINE_BYTES      16
+#define MAX_DATA        (LINES * (2 + LINE_BYTES))
+#define PACKET_LEN(n)   (HEADER_LEN + (n) + 2)
+
+#define TELEMETRY_LEN(n) (4 + (n) * 9 + 2)
+#define TELEMETRY_MAX   64
+
+static volatile sig_atomic_t stop;
+
+static unsigned long packets, linesRead, bytesRead, crcErrors, lostPackets, skippedBytes;
+
+static uint8_t screen[LINES][LINE_BYTES];
+static uint8_t known[LINES];            // line has arrived at least once
+static uint8_t rotated;
+
+
+static void onSignal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+// CRC-16/CCITT as on the board: polynomial 0x1021, initial 0xFFFF, MSB first
+static uint16_t crc16(const uint8_t *p, int len)
+{
+    uint16_t crc = 0xFFFF;
+    int i;
+
+    while (len--) {
+        crc ^= (uint16_t)*p++ << 8;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+static speed_t baudConstant(long baud)
+{
+    switch (baud) {
+    case 9600:      return B9600;
+    case 19200:     return B19200;
+    case 38400:     return B38400;
+    case 57600:     return B57600;
+    case 115200:    return B115200;
+    case 230400:    return B230400;
+    case 460800:    return B460800;
+    case 921600:    return B921600;
+    }
+    fprintf(stderr, "lcdview: unsupported baud rate %ld\n", baud);
+    exit(1);
+}
+
+// Raw 8N1 at the given rate. Pseudo-terminals take the settings and
+// ignore the rate.
+static void setupPort(int fd, long baud)
+{
+    struct termios tio;
+
+    if (!isatty(fd) || (tcgetattr(fd, &tio) < 0))
+        return;
+
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, baudConstant(baud));
+    cfsetospeed(&tio, baudConstant(baud));
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+
+//------------------------------------------------------------------------------
+// Screen
+//------------------------------------------------------------------------------
+
+// Pixel (x, y) as the application drew it: 1 white, 0 black, -1 unknown.
+// With ROTATE_90 the driver keeps column x in buffer line 127 - x.
+static int pixel(int x, int y)
+{
+    int line = rotated ? LINES - 1 - x : y;
+    int bit = rotated ? y : x;
+
+    if (!known[line])
+        return -1;
+    return (screen[line][bit >> 3] >> (7 - (bit & 7))) & 1;
+}
+
+static void draw(FILE *out)
+{
+    static const char *colour[] = { "\033[90m", "\033[30m", "\033[97m" };
+    int x, y;
+
+    fprintf(out, "\033[H");
+    for (y = 0; y < LINES; y += 2) {
+        fprintf(out, "\033[40m");
+        for (x = 0; x < LINES; x++) {
+            int top = pixel(x, y), bottom = pixel(x, y + 1);
+
+            // Upper half block in the top pixel's colour on the bottom's
+            fprintf(out, "%s\033[%dm▀", colour[top + 1],
+                    bottom == 1 ? 107 : bottom == 0 ? 40 : 100);
+        }
+        fprintf(out, "\033[0m\n");
+    }
+    fprintf(out, "packets %lu  lines %lu  bytes %lu  CRC errors %lu  lost %lu\033[K\n",
+            packets, linesRead, bytesRead, crcErrors, lostPackets);
+    fflush(out);
+}
+
+// Writes the picture as a binary PBM, by way of a temporary file so a
+// viewer never sees half of one. Unknown pixels come out white.
+static void writePbm(const char *path)
+{
+    char tmp[1024];
+    FILE *f;
+    int x, y;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    f = fopen(tmp, "wb");
+    if (!f) {
+        perror(tmp);
+        return;
+    }
+
+    fprintf(f, "P4\n%d %d\n", LINES, LINES);
+    for (y = 0; y < LINES; y++) {
+        for (x = 0; x < LINES; x += 8) {
+            uint8_t b = 0;
+            int i;
+
+            for (i = 0; i < 8; i++)
+                b = (b << 1) | (pixel(x + i, y) == 0);     // PBM 1 is black
+            fputc(b, f);
+        }
+    }
+
+    fclose(f);
+    rename(tmp, path);
+}
+
+
+//------------------------------------------------------------------------------
+// Receiver
+//------------------------------------------------------------------------------
+
+// Decodes one run-length encoded line into out. Returns the bytes of p
+// used, or 0 if the encoding runs past the line or the data.
+static int decodeLine(const uint8_t *p, int avail, uint8_t *out)
+{
+    int pos = 0, have = 0, n;
+
+    while (have < LINE_BYTES) {
+        if (pos >= avail)
+            return 0;
+        n = (p[pos] & 0x7F) + 1;
+        if (have + n > LINE_BYTES)
+            return 0;
+
+        if (p[pos] & 0x80) {
+            if (pos + 2 > avail)
+                return 0;
+            memset(out + have, p[pos + 1], n);
+            pos += 2;
+        } else {
+            if (pos + 1 + n > avail)
+                return 0;
+            memcpy(out + have, p + pos + 1, n);
+            pos += 1 + n;
+        }
+        have += n;
+    }
+    return pos;
+}
+
+// Applies the lines of a packet whose CRC has been checked. Nothing is
+// changed if the contents do not add up.
+static int applyPacket(const uint8_t *p)
+{
+    static uint8_t lines[LINES][LINE_BYTES];
+    static uint8_t numbers[LINES];
+    int count = p[4], len = p[5] | (p[6] << 8);
+    const uint8_t *data = p + HEADER_LEN;
+    int pos = 0, i, used;
+
+    if (count > LINES)
+        return 0;
+
+    for (i = 0; i < count; i++) {
+        if ((pos >= len) || (data[pos] >= LINES))
+            return 0;
+        numbers[i] = data[pos++];
+        used = decodeLine(data + pos, len - pos, lines[i]);
+        if (!used)
+            return 0;
+        pos += used;
+    }
+    if (pos != len)
+        return 0;
+
+    for (i = 0; i < count; i++) {
+        memcpy(screen[numbers[i]], lines[i], LINE_BYTES);
+        known[numbers[i]] = 1;
+    }
+    rotated = p[3] & FLAG_ROTATE_90;
+    linesRead += count;
+    return 1;
+}
+
+// Takes every complete packet from the front of buf. Returns the number
+// of bytes used up; the rest is kept for the next read.
+static int decode(const uint8_t *buf, int len, int *changed)
+{
+    static int haveSeq;
+    static uint8_t nextSeq;
+    int pos = 0;
+
+    while (len - pos >= HEADER_LEN) {
+        const uint8_t *p = buf + pos;
+        int total;
+
+        // Telemetry records: check and step over them
+        if ((p[0] == SYNC1) && (p[1] == SYNC2_TELEMETRY) && (p[3] <= TELEMETRY_MAX)) {
+            total = TELEMETRY_LEN(p[3]);
+            if (len - pos < total)
+                break;
+            if (crc16(p + 2, total - 4) == ((p[total - 2] << 8) | p[total - 1])) {
+                pos += total;
+                continue;
+            }
+        }
+
+        if ((p[0] != SYNC1) || (p[1] != SYNC2_MIRROR) || ((p[5] | (p[6] << 8)) > MAX_DATA)) {
+            pos++;
+            skippedBytes++;
+            continue;
+        }
+
+        total = PACKET_LEN(p[5] | (p[6] << 8));
+        if (len - pos < total)
+            break;                      // wait for the rest
+
+        if ((crc16(p + 2, total - 4) != ((p[total - 2] << 8) | p[total - 1])) ||
+            !applyPacket(p)) {
+            crcErrors++;
+            pos++;                      // look for the next sync from here
+            skippedBytes++;
+            continue;
+        }
+
+        if (haveSeq && (p[2] != nextSeq))
+            lostPackets += (uint8_t)(p[2] - nextSeq);
+        haveSeq = 1;
+        nextSeq = p[2] + 1;
+        packets++;
+        bytesRead += total;
+        *changed = 1;
+
+        pos += total;
+    }
+    return pos;
+}
+
+static int receive(const char *path, long baud, const char *pbmPath)
+{
+    static uint8_t buf[8192];
+    int fd, have = 0;
+
+    fd = open(path, O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    setupPort(fd, baud);
+
+    printf("\033[2J");
+    draw(stdout);
+
+    while (!stop) {
+        ssize_t n = read(fd, buf + have, sizeof(buf) - have);
+        int used, changed = 0;
+
+        if (n <= 0)
+            break;                      // EOF, board gone, or interrupted
+        have += n;
+
+        used = decode(buf, have, &changed);
+        memmove(buf, buf + used, have - used);
+        have -= used;
+
+        if (have == sizeof(buf)) {      // cannot happen with valid packets
+            skippedBytes += have;
+            have = 0;
+        }
+
+        if (changed) {
+            draw(stdout);
+            if (pbmPath)
+                writePbm(pbmPath);
+        }
+    }
+
+    close(fd);
+    fprintf(stderr, "lcdview: %lu packets, %lu lines, %lu bytes, %lu CRC errors, %lu lost packets, %lu bytes skipped\n",
+            packets, linesRead, bytesRead, crcErrors, lostPackets, skippedBytes);
+    return 0;
+}
+
+
+//------------------------------------------------------------------------------
+// Stand-in board
+//------------------------------------------------------------------------------
+
+// Same encoding as the board: runs of three or more become a repeat
+static int encodeLine(uint8_t *out, const uint8_t *line)
+{
+    uint8_t *start = out;
+    int i = 0, n, first;
+
+    while (i < LINE_BYTES) {
+        for (n = 1; (i + n < LINE_BYTES) && (line[i + n] == line[i]); n++)
+            ;
+
+        if (n >= 3) {
+            *out++ = 0x80 | (n - 1);
+            *out++ = line[i];
+            i += n;
+            continue;
+        }
+
+        first = i;
+        do {
+            i += n;
+            if (i >= LINE_BYTES)
+                break;
+            for (n = 1; (i + n < LINE_BYTES) && (line[i + n] == line[i]); n++)
+                ;
+        } while (n < 3);
+
+        *out++ = i - first - 1;
+        while (first < i)
+            *out++ = line[first++];
+    }
+    return out - start;
+}
+
+// Black pixel at (x, y) as the application sees it, stored turned as
+// with ROTATE_90
+static void setBlack(uint8_t fb[LINES][LINE_BYTES], int x, int y)
+{
+    fb[LINES - 1 - x][y >> 3] &= ~(0x80 >> (y & 7));
+}
+
+// A bar that sweeps across and a binary counter
+static void drawFrame(uint8_t fb[LINES][LINE_BYTES], unsigned long frame)
+{
+    int x, y, bit;
+
+    memset(fb, 0xFF, LINES * LINE_BYTES);
+
+    for (y = 20; y < 30; y++)
+        for (x = 0; x < (int)(frame % 96); x++)
+            setBlack(fb, x, y);
+
+    for (bit = 0; bit < 16; bit++)
+        if (frame & (1UL << bit))
+            for (y = 50; y < 56; y++)
+                for (x = 90 - bit * 6; x < 94 - bit * 6; x++)
+                    setBlack(fb, x, y);
+}
+
+static int board(int framesPerSec, int damageEvery)
+{
+    static uint8_t fb[LINES][LINE_BYTES];
+    static uint8_t sent[LINES][LINE_BYTES];
+    static uint8_t packet[PACKET_LEN(MAX_DATA)];
+    unsigned long frame = 0, sentPackets = 0;
+    uint8_t seq = 0;
+    int refresh = 0;
+    int fd, l;
+
+    fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((fd < 0) || (grantpt(fd) < 0) || (unlockpt(fd) < 0)) {
+        perror("posix_openpt");
+        return 1;
+    }
+    setupPort(fd, 115200);
+    fprintf(stderr, "lcdview: board on %s\n", ptsname(fd));
+
+    memset(sent, 0x55, sizeof(sent));   // nothing matches, so all lines go first
+
+    while (!stop) {
+        int pos = HEADER_LEN, count = 0, len;
+        uint16_t crc;
+
+        drawFrame(fb, frame++);
+
+        for (l = 0; l < LINES; l++) {
+            int due = (l == refresh) || (l == (refresh + 1) % LINES);
+
+            if (due || memcmp(fb[l], sent[l], LINE_BYTES)) {
+                packet[pos++] = l;
+                pos += encodeLine(packet + pos, fb[l]);
+                memcpy(sent[l], fb[l], LINE_BYTES);
+                count++;
+            }
+        }
+        refresh = (refresh + 2) % LINES;
+
+        len = pos - HEADER_LEN;
+        packet[0] = SYNC1;
+        packet[1] = SYNC2_MIRROR;
+        packet[2] = seq++;
+        packet[3] = FLAG_ROTATE_90;
+        packet[4] = count;
+        packet[5] = len & 0xFF;
+        packet[6] = len >> 8;
+        crc = crc16(packet + 2, pos - 2);
+        packet[pos++] = crc >> 8;
+        packet[pos++] = crc & 0xFF;
+
+        sentPackets++;
+        if (damageEvery && (sentPackets % damageEvery == 0))
+            packet[HEADER_LEN + 1] ^= 0x01;
+
+        if (write(fd, packet, pos) != pos)
+            break;
+
+        usleep(1000000L / framesPerSec);
+    }
+
+    close(fd);
+    fprintf(stderr, "lcdview: %lu packets sent\n", sentPackets);
+    return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+    long baud = 115200;
+    const char *pbmPath = NULL;
+    int boardMode = 0, framesPerSec = 10, damageEvery = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:o:bf:e:")) != -1) {
+        switch (opt) {
+        case 's': baud = atol(optarg); break;
+        case 'o': pbmPath = optarg; break;
+        case 'b': boardMode = 1; break;
+        case 'f': framesPerSec = atoi(optarg); break;
+        case 'e': damageEvery = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: lcdview [-s baud] [-o screen.pbm] device\n"
+                            "       lcdview -b [-f frames/s] [-e n]\n");
+            return 1;
+        }
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    if (boardMode)
+        return board(framesPerSec > 0 ? framesPerSec : 10, damageEvery);
+
+    if (optind >= argc) {
+        fprintf(stderr, "lcdview: no device given\n");
+        return 1;
+    }
+    return receive(argv[optind], baud, pbmPath);
+}
@@ -0,0 +1,274 @@
+/*
+ * rtcsim.c
+ *
+ *  Host runner for the Lab 3 RTC_A clock backend (Lab3/rtc_clock.h).
+ *  Built with HOST_BUILD, rtc_clock.c talks to a simulated register block
+ *  and RTCClock_simTick() plays one second of the RTC_A hardware, running
+ *  the module's own interrupt handler. This sets the clock, ticks it and
+ *  checks what RTCClock_read() and RTCClock_takeEvents() report against a
+ *  reference calendar worked out here from a day count, independently of
+ *  Lab3/calendar.c.
+ *
+ *  Checks:
+ *      set/read    the time set is read back, also while the clock runs
+ *      events      every tick posts the second event, and the minute event
+ *                  exactly when the minute changes; nothing while held
+ *      rollover    month ends, February in leap and common years
+ *                  (2000, 2023, 2024, 2100), and the end of a year
+ *      long run    every second from 2023-12-30 to 2025-01-02, with the
+ *                  day of week counting along
+ *
+ *  The exit status is 0 when every check passes.
+ *
+ *  Build:  cc -O2 -DHOST_BUILD -I../../Lab3 -o rtcsim rtcsim.c \
+ *             ../../Lab3/rtc_clock.c ../../Lab3/calendar.c
+ *  Use:    rtcsim [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "rtc_clock.h"
+
+static int verbose;
+static int errors;
+
+
+// Days since 1970-01-01 of a proleptic Gregorian date, and back
+static long daysFromCivil(long y, unsigned m, unsigned d)
+{
+    long era;
+    unsigned yoe, doy, doe;
+
+    y -= (m <= 2);
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = (unsigned)(y - era * 400);
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (long)doe - 719468;
+}
+
+static void civilFromDays(long z, CalendarTime *t)
+{
+    long era, y;
+    unsigned doe, yoe, doy, mp;
+
+    z += 719468;
+    era = (z >= 0 ? z : z - 146096) / 146097;
+    doe = (unsigned)(z - era * 146097);
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    y = (long)yoe + era * 400;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+    t->day = doy - (153 * mp + 2) / 5 + 1;
+    t->month = mp < 10 ? mp + 3 : mp - 9;
+    t->year = (uint16_t)(y + (t->month <= 2));
+}
+
+static long long toSeconds(const CalendarTime *t)
+{
+    return daysFromCivil(t->year, t->month, t->day) * 86400LL +
+           t->hours * 3600L + t->minutes * 60L + t->seconds;
+}
+
+static void fromSeconds(long long s, CalendarTime *t)
+{
+    long days = (long)(s / 86400);
+    long rem = (long)(s % 86400);
+
+    civilFromDays(days, t);
+    t->hours = rem / 3600;
+    t->minutes = (rem / 60) % 60;
+    t->seconds = rem % 60;
+}
+
+static CalendarTime makeTime(uint16_t year, uint8_t month, uint8_t day,
+                             uint8_t hours, uint8_t minutes, uint8_t seconds)
+{
+    CalendarTime t;
+
+    t.year = year;
+    t.month = month;
+    t.day = day;
+    t.hours = hours;
+    t.minutes = minutes;
+    t.seconds = seconds;
+    return t;
+}
+
+static int sameTime(const CalendarTime *a, const CalendarTime *b)
+{
+    return (a->year == b->year) && (a->month == b->month) && (a->day == b->day) &&
+           (a->hours == b->hours) && (a->minutes == b->minutes) && (a->seconds == b->seconds);
+}
+
+static void fail(const char *check, const char *what, const CalendarTime *got,
+                 const CalendarTime *want)
+{
+    fprintf(stderr, "rtcsim: %s: %s", check, what);
+    if (got)
+        fprintf(stderr, ", read %04u-%02u-%02u %02u:%02u:%02u", got->year, got->month,
+                got->day, got->hours, got->minutes, got->seconds);
+    if (want)
+        fprintf(stderr, ", expected %04u-%02u-%02u %02u:%02u:%02u", want->year,
+                want->month, want->day, want->hours, want->minutes, want->seconds);
+    fputc('\n', stderr);
+    errors++;
+}
+
+// Ticks n seconds from the time last set, checking the time read and the
+// events after each one against the reference. Stops at the first
+// failure. Returns the seconds the reference reached.
+static long long run(const char *check, long long s, long n)
+{
+    CalendarTime got, want;
+    uint8_t events, expected;
+    long i;
+
+    for (i = 0; i < n; i++) {
+        RTCClock_simTick();
+        s++;
+        fromSeconds(s, &want);
+        RTCClock_read(&got);
+
+        if (!sameTime(&got, &want)) {
+            fail(check, "time", &got, &want);
+            break;
+        }
+
+        events = RTCClock_takeEvents();
+        expected = RTC_EVENT_SECOND | ((want.seconds == 0) ? RTC_EVENT_MINUTE : 0);
+        if (events != expected) {
+            fail(check, (events & RTC_EVENT_MINUTE) ? "unexpected minute event" :
+                        (expected & RTC_EVENT_MINUTE) ? "missed minute event" :
+                        "missed second event", &got, 0);
+            break;
+        }
+    }
+
+    if (verbose)
+        printf("  %s: %ld s to %04u-%02u-%02u %02u:%02u:%02u\n", check, i, want.year,
+               want.month, want.day, want.hours, want.minutes, want.seconds);
+    return s;
+}
+
+static void setRead(void)
+{
+    CalendarTime start = makeTime(2024, 6, 15, 13, 59, 58);
+    CalendarTime later = makeTime(2031, 11, 2, 7, 5, 0);
+    CalendarTime got;
+    uint8_t events;
+
+    RTCClock_init(&start);
+    RTCClock_read(&got);
+    if (!sameTime(&got, &start))
+        fail("set/read", "time after init", &got, &start);
+
+    events = RTCClock_takeEvents();
+    if (events != (RTC_EVENT_SECOND | RTC_EVENT_MINUTE))
+        fail("set/read", "init does not report the starting time", 0, 0);
+    if (RTCClock_takeEvents() != 0)
+        fail("set/read", "events not cleared when taken", 0, 0);
+
+    // 13:59:58 -> 14:00:05, across the hour
+    run("set/read", toSeconds(&start), 7);
+
+    // Setting a running clock
+    RTCClock_set(&later);
+    RTCClock_read(&got);
+    if (!sameTime(&got, &later))
+        fail("set/read", "time after set", &got, &later);
+    if (rtcSimRegs.ctl01 & RTCHOLD)
+        fail("set/read", "set leaves the calendar held", 0, 0);
+    run("set/read", toSeconds(&later), 125);
+
+    // Held: nothing advances and nothing is posted
+    RTCClock_takeEvents();
+    RTCClock_read(&got);
+    rtcSimRegs.ctl01 |= RTCHOLD;
+    RTCClock_simTick();
+    RTCClock_simTick();
+    {
+        CalendarTime held;
+
+        RTCClock_read(&held);
+        if (!sameTime(&held, &got))
+            fail("events", "time moved while held", &held, &got);
+    }
+    if (RTCClock_takeEvents() != 0)
+        fail("events", "event posted while held", 0, 0);
+    rtcSimRegs.ctl01 &= ~RTCHOLD;
+    run("events", toSeconds(&got), 61);
+}
+
+// Starts just before a rollover and runs across it
+static void rollover(const char *name, CalendarTime start, long seconds)
+{
+    RTCClock_set(&start);
+    RTCClock_takeEvents();
+    run(name, toSeconds(&start), seconds);
+}
+
+static void rollovers(void)
+{
+    static const uint8_t monthDays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    uint8_t m;
+
+    for (m = 1; m <= 12; m++)
+        if (m != 2)
+            rollover("month end", makeTime(2025, m, monthDays[m - 1], 23, 59, 50), 20);
+
+    rollover("leap 2024", makeTime(2024, 2, 28, 23, 59, 50), 86400 + 20);
+    rollover("common 2023", makeTime(2023, 2, 28, 23, 59, 50), 20);
+    rollover("leap 2000", makeTime(2000, 2, 28, 23, 59, 50), 86400 + 20);
+    rollover("common 2100", makeTime(2100, 2, 28, 23, 59, 50), 20);
+    rollover("year end", makeTime(2025, 12, 31, 23, 59, 50), 20);
+    rollover("year end 2099", makeTime(2099, 12, 31, 23, 59, 50), 20);
+}
+
+// Every second of a leap year and both of its ends, and the day of week
+static void longRun(void)
+{
+    CalendarTime start = makeTime(2023, 12, 30, 0, 0, 0);
+    CalendarTime end = makeTime(2025, 1, 2, 0, 0, 0);
+    long startDay = daysFromCivil(start.year, start.month, start.day);
+    long long s = toSeconds(&start), stop = toSeconds(&end);
+    int before = errors;
+
+    RTCClock_set(&start);
+    RTCClock_takeEvents();
+    rtcSimRegs.dow = 0;
+
+    while ((s < stop) && (errors == before)) {
+        s = run("long run", s, 86400);
+        if (rtcSimRegs.dow != (s / 86400 - startDay) % 7) {
+            fail("long run", "day of week", 0, 0);
+            break;
+        }
+    }
+
+    printf("long run: %lld s ticked\n", s - toSeconds(&start));
+}
+
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+        case 'v': verbose++; break;
+        default:
+            fprintf(stderr, "usage: rtcsim [-v]\n");
+            return 1;
+        }
+    }
+
+    setRead();
+    rollovers();
+    longRun();
+
+    printf("%s\n", errors ? "FAILED" : "all checks passed");
+    return errors ? 1 : 0;
+}
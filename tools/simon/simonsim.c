@@ -0,0 +1,502 @@
+/*
+ * simonsim.c
+ *
+ *  Host runner for the Lab1 Simon engine (Lab1/simon_engine.h). Plays
+ *  scripted games against the engine on a simulated clock counted in
+ *  engine delay units, the way the firmware adapter in Lab1/main.c drives
+ *  it: a non-zero delay in an output arms the one timeout, replacing any
+ *  earlier one, and a zero delay leaves it as it is.
+ *
+ *  The scripted player learns the sequence from the numbers the engine
+ *  shows during playback, as a person would, and types it back with
+ *  different timing in each scenario: after each echo, a whole round at
+ *  once, keys typed during an echo, wrong and invalid keys, keys during
+ *  playback, and a replay of the same seed. Every output is checked
+ *  against the delays the engine promises (countdown, number shown for
+ *  the round's speed, one unit gap, tune notes, the hold after the tune
+ *  and the win message), and each scenario checks how the game ended.
+ *
+ *  Input-to-feedback latency is the time from a key press to its number
+ *  being shown, in delay units and in ms at DELAY_UNIT_MS. A key typed
+ *  during an echo waits for the echo and the gap after it; every other
+ *  key must be shown at once. The exit status is 0 when every check
+ *  passes.
+ *
+ *  Build:  cc -O2 -DHOST_BUILD -I../../Lab1 -o simonsim simonsim.c \
+ *             ../../Lab1/simon_engine.c ../../Lab1/prng.c
+ *  Use:    simonsim [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "simon_engine.h"
+
+#define DELAY_UNIT_MS   40              // as in Lab1/main.c
+#define MAX_PENDING     64
+#define STEP_LIMIT      100000          // timeouts before a scenario counts as stuck
+
+typedef struct Sim
+{
+    const char *name;
+    SimonEngine g;
+    SimonOutput out;
+
+    unsigned long now;                  // delay units since the start
+    unsigned long timeoutAt;
+    int armed;
+
+    uint8_t shown[SIMON_ROUNDS];        // the sequence as played back this round
+    int shownCount;
+
+    unsigned long pressedAt[MAX_PENDING];   // keys waiting for their echo
+    uint8_t pressedKey[MAX_PENDING];
+    int pending;
+
+    int echoes, wins, gameOvers, titles, tuneNotes;
+    unsigned long maxLatency, totalLatency;
+    int errors;
+} Sim;
+
+static int verbose;
+
+
+static void fail(Sim *s, const char *format, ...)
+{
+    va_list args;
+
+    fprintf(stderr, "simonsim: %s at %lu: ", s->name, s->now);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+    s->errors++;
+}
+
+static const char *stateName(uint8_t state)
+{
+    static const char *names[] = {
+        "attract", "countdown", "playback", "wait key", "echo", "game over", "won"
+    };
+
+    return (state < sizeof(names) / sizeof(names[0])) ? names[state] : "?";
+}
+
+// Checks one output against the state it came from and the state it led
+// to, records what the player sees, and arms the timeout like the adapter
+static void apply(Sim *s, uint8_t before)
+{
+    const SimonOutput *o = &s->out;
+    uint8_t after = s->g.state;
+
+    if (verbose)
+        printf("%6lu  %-9s -> %-9s  display %d sound %d number %d delay %d\n",
+               s->now, stateName(before), stateName(after),
+               o->display, o->sound, o->number, o->delay);
+
+    switch (o->display) {
+    case SIMON_SHOW_TITLE:
+        s->titles++;
+        if (o->delay != 0)
+            fail(s, "title with delay %d", o->delay);
+        break;
+
+    case SIMON_SHOW_COUNT:
+        if ((o->delay != 10) || (o->number < 0) || (o->number > 3))
+            fail(s, "countdown %d with delay %d", o->number, o->delay);
+        break;
+
+    case SIMON_SHOW_NUMBER:
+        if ((o->number < 1) || (o->number > 4))
+            fail(s, "number %d out of range", o->number);
+        if (s->g.speed != SIMON_START_SPEED - s->g.turn)
+            fail(s, "speed %d in round %d", s->g.speed, s->g.turn);
+        if (o->delay != s->g.speed)
+            fail(s, "number shown for %d, speed is %d", o->delay, s->g.speed);
+        if ((o->sound != SIMON_SOUND_NUMBER))
+            fail(s, "number shown without its tone");
+
+        if (after == SIMON_PLAYBACK) {
+            if (before != SIMON_PLAYBACK)
+                s->shownCount = 0;
+            if (o->number != SimonEngine_numberAt(&s->g, s->shownCount))
+                fail(s, "played back %d at %d, sequence has %d", o->number,
+                     s->shownCount, SimonEngine_numberAt(&s->g, s->shownCount));
+            if (s->shownCount < SIMON_ROUNDS)
+                s->shown[s->shownCount++] = o->number;
+
+        } else if (after == SIMON_ECHO) {
+            unsigned long latency;
+
+            if (s->pending == 0) {
+                fail(s, "echo of %d with no key pressed", o->number);
+                break;
+            }
+            latency = s->now - s->pressedAt[0];
+            if (o->number != s->pressedKey[0] - '0')
+                fail(s, "echoed %d for key %c", o->number, s->pressedKey[0]);
+
+            s->pending--;
+            memmove(s->pressedAt, s->pressedAt + 1, s->pending * sizeof(s->pressedAt[0]));
+            memmove(s->pressedKey, s->pressedKey + 1, s->pending);
+
+            s->echoes++;
+            s->totalLatency += latency;
+            if (latency > s->maxLatency)
+                s->maxLatency = latency;
+
+            // Only a key that arrived during an echo may wait, for at most
+            // the rest of the round's echoes and gaps
+            if (latency > (unsigned long)s->g.count * (s->g.speed + 1))
+                fail(s, "key %d of round %d waited %lu", s->g.count, s->g.turn, latency);
+        }
+        break;
+
+    case SIMON_SHOW_CLEAR:
+        if ((o->sound == SIMON_SOUND_OFF) && (o->delay != 1))
+            fail(s, "gap of %d", o->delay);
+        break;
+
+    case SIMON_SHOW_GAME_OVER:
+        s->gameOvers++;
+        s->tuneNotes++;
+        s->pending = 0;
+        if ((o->delay != 4) || (o->sound != SIMON_SOUND_TUNE) || (o->number != 0))
+            fail(s, "game over with delay %d, sound %d", o->delay, o->sound);
+        break;
+
+    case SIMON_SHOW_WON:
+        s->wins++;
+        if (o->delay != 40)
+            fail(s, "won with delay %d", o->delay);
+        break;
+
+    case SIMON_SHOW_NOTHING:
+        if (o->sound == SIMON_SOUND_TUNE) {
+            if ((o->number != s->tuneNotes) || (o->delay != 4))
+                fail(s, "tune note %d with delay %d", o->number, o->delay);
+            s->tuneNotes++;
+        } else if ((before == SIMON_GAME_OVER) && (o->delay != 0) && (o->delay != 40)) {
+            fail(s, "tune held for %d", o->delay);
+        }
+        break;
+    }
+
+    // Typed-ahead keys do not carry into the next round
+    if ((after == SIMON_PLAYBACK) && (before != SIMON_PLAYBACK))
+        s->pending = 0;
+
+    if (o->delay) {
+        s->timeoutAt = s->now + o->delay;
+        s->armed = 1;
+    }
+}
+
+static void stepTimeout(Sim *s)
+{
+    SimonInput in = {SIMON_IN_TIMEOUT, 0, 0};
+    uint8_t before = s->g.state;
+
+    s->now = s->timeoutAt;
+    s->armed = 0;
+    SimonEngine_step(&s->g, &in, &s->out);
+    apply(s, before);
+}
+
+// Lets simulated time pass up to t, taking every timeout on the way
+static void runUntil(Sim *s, unsigned long t)
+{
+    while (s->armed && (s->timeoutAt <= t))
+        stepTimeout(s);
+    if (t > s->now)
+        s->now = t;
+}
+
+// Takes timeouts until the engine is in state or nothing more will happen
+static int waitFor(Sim *s, uint8_t state)
+{
+    int steps = 0;
+
+    while ((s->g.state != state) && s->armed && (steps++ < STEP_LIMIT))
+        stepTimeout(s);
+
+    if (s->g.state != state) {
+        fail(s, "stuck in %s waiting for %s", stateName(s->g.state), stateName(state));
+        return 0;
+    }
+    return 1;
+}
+
+// Takes timeouts until no timeout is armed
+static void settle(Sim *s)
+{
+    int steps = 0;
+
+    while (s->armed && (steps++ < STEP_LIMIT))
+        stepTimeout(s);
+}
+
+static void press(Sim *s, uint8_t key, uint32_t seed)
+{
+    SimonInput in;
+    uint8_t before = s->g.state;
+
+    in.type = SIMON_IN_KEY;
+    in.key = key;
+    in.seed = SimonEngine_wantsSeed(&s->g) ? seed : 0;
+
+    if ((key >= '1') && (key <= '4') &&
+        ((before == SIMON_WAIT_KEY) || (before == SIMON_ECHO)) && (s->pending < MAX_PENDING)) {
+        s->pressedAt[s->pending] = s->now;
+        s->pressedKey[s->pending] = key;
+        s->pending++;
+    }
+
+    SimonEngine_step(&s->g, &in, &s->out);
+    apply(s, before);
+}
+
+static void start(Sim *s, const char *name, uint8_t key, uint32_t seed)
+{
+    if (name) {
+        memset(s, 0, sizeof(*s));
+        s->name = name;
+        SimonEngine_init(&s->g, &s->out);
+        apply(s, SIMON_ATTRACT);
+    }
+    press(s, key, seed);
+}
+
+
+//------------------------------------------------------------------------------
+// Players
+//------------------------------------------------------------------------------
+
+#define TYPE_AFTER_ECHO 0               // each key once the last echo is over
+#define TYPE_BURST      1               // the whole round at one instant
+#define TYPE_IN_ECHO    2               // each key one unit into the last echo
+
+// Plays rounds until the game ends, typing the sequence as shown. In
+// round wrongRound the number at wrongAt is typed wrong.
+static void play(Sim *s, int style, int wrongRound, int wrongAt)
+{
+    int i;
+
+    while ((s->g.state != SIMON_WON) && (s->g.state != SIMON_GAME_OVER)) {
+        if (!waitFor(s, SIMON_WAIT_KEY))
+            return;
+
+        for (i = 0; i < s->shownCount; i++) {
+            uint8_t key = '0' + s->shown[i];
+
+            if ((s->g.turn == wrongRound) && (i == wrongAt))
+                key = '0' + (s->shown[i] % 4) + 1;
+
+            press(s, key, 0);
+
+            if (style == TYPE_AFTER_ECHO) {
+                while (s->g.state == SIMON_ECHO)
+                    stepTimeout(s);
+                runUntil(s, s->now + 3);
+            } else if (style == TYPE_IN_ECHO) {
+                runUntil(s, s->now + 1);
+            }
+            if (s->g.state == SIMON_GAME_OVER)
+                return;
+        }
+
+        // Finish the round's echoes
+        while ((s->g.state == SIMON_ECHO) || (s->g.state == SIMON_WAIT_KEY && s->armed))
+            stepTimeout(s);
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Scenarios
+//------------------------------------------------------------------------------
+
+#define ALL_KEYS    (SIMON_ROUNDS * (SIMON_ROUNDS + 1) / 2)
+
+static void expectEnd(Sim *s, int wins, int gameOvers, int echoes)
+{
+    if (s->wins != wins)
+        fail(s, "%d wins, expected %d", s->wins, wins);
+    if (s->gameOvers != gameOvers)
+        fail(s, "%d games over, expected %d", s->gameOvers, gameOvers);
+    if (s->echoes != echoes)
+        fail(s, "%d keys echoed, expected %d", s->echoes, echoes);
+    if (s->pending)
+        fail(s, "%d keys never echoed", s->pending);
+}
+
+static void report(const Sim *s)
+{
+    printf("%-20s %s  %3d keys  latency max %3lu units (%4lu ms), mean %5.2f\n",
+           s->name, s->errors ? "FAIL" : "ok  ", s->echoes,
+           s->maxLatency, s->maxLatency * DELAY_UNIT_MS,
+           s->echoes ? (double)s->totalLatency / s->echoes : 0.0);
+}
+
+// Each key after the previous echo: every key shown at once
+static int steady(void)
+{
+    Sim s;
+
+    start(&s, "steady", '*', 0x12345678UL);
+    play(&s, TYPE_AFTER_ECHO, -1, 0);
+    settle(&s);
+    expectEnd(&s, 1, 0, ALL_KEYS);
+    if (s.maxLatency != 0)
+        fail(&s, "latency %lu with no keys typed ahead", s.maxLatency);
+    if ((s.g.state != SIMON_ATTRACT) || (s.titles != 2))
+        fail(&s, "not back on the title screen");
+    report(&s);
+    return s.errors;
+}
+
+// A whole round typed in one instant: key k waits k echoes and gaps
+static int burst(void)
+{
+    Sim s;
+    unsigned long worst = 0;
+    int turn;
+
+    for (turn = 0; turn < SIMON_ROUNDS; turn++) {
+        unsigned long w = (unsigned long)turn * (SIMON_START_SPEED - turn + 1);
+        if (w > worst)
+            worst = w;
+    }
+
+    start(&s, "type-ahead burst", '*', 0xCAFEF00DUL);
+    play(&s, TYPE_BURST, -1, 0);
+    settle(&s);
+    expectEnd(&s, 1, 0, ALL_KEYS);
+    if (s.maxLatency != worst)
+        fail(&s, "worst latency %lu, expected %lu", s.maxLatency, worst);
+    report(&s);
+    return s.errors;
+}
+
+// Each key one unit into the previous echo: none lost, each waits for
+// the rest of that echo and the gap
+static int inEcho(void)
+{
+    Sim s;
+
+    start(&s, "type during echo", '*', 0x0BADBEEFUL);
+    play(&s, TYPE_IN_ECHO, -1, 0);
+    settle(&s);
+    expectEnd(&s, 1, 0, ALL_KEYS);
+    if (s.maxLatency > SIMON_START_SPEED * (SIMON_ROUNDS - 1))
+        fail(&s, "latency %lu", s.maxLatency);
+    report(&s);
+    return s.errors;
+}
+
+// Wrong number in round 3: its echo, then the tune and the title
+static int wrongKey(void)
+{
+    Sim s;
+    int echoes = 1 + 2 + 3 + 2;         // rounds 0-2 right, then two keys of round 3
+
+    start(&s, "wrong key", '*', 42);
+    play(&s, TYPE_AFTER_ECHO, 3, 1);
+    waitFor(&s, SIMON_GAME_OVER);
+    settle(&s);
+    expectEnd(&s, 0, 1, echoes);
+    if (s.g.turn != 3)
+        fail(&s, "lost in round %d", s.g.turn);
+    if (s.tuneNotes != SIMON_TUNE_NOTES)
+        fail(&s, "%d tune notes", s.tuneNotes);
+    if (s.g.state != SIMON_ATTRACT)
+        fail(&s, "not back on the title screen");
+    report(&s);
+    return s.errors;
+}
+
+// A key other than 1-4 ends the game at once, without an echo
+static int invalidKey(void)
+{
+    Sim s;
+    unsigned long pressed;
+
+    start(&s, "invalid key", '*', 7);
+    waitFor(&s, SIMON_WAIT_KEY);
+    pressed = s.now;
+    press(&s, '9', 0);
+    if ((s.g.state != SIMON_GAME_OVER) || (s.now != pressed))
+        fail(&s, "'9' did not end the game at once");
+    settle(&s);
+    expectEnd(&s, 0, 1, 0);
+    report(&s);
+    return s.errors;
+}
+
+// Keys during playback are ignored and do not count as answers
+static int keysInPlayback(void)
+{
+    Sim s;
+
+    start(&s, "keys in playback", '*', 0x5EED);
+    waitFor(&s, SIMON_PLAYBACK);
+    press(&s, '1', 0);
+    press(&s, '2', 0);
+    if (s.g.state != SIMON_PLAYBACK)
+        fail(&s, "keys left playback");
+    play(&s, TYPE_AFTER_ECHO, -1, 0);
+    settle(&s);
+    expectEnd(&s, 1, 0, ALL_KEYS);
+    report(&s);
+    return s.errors;
+}
+
+// '#' on the title screen replays the last game's sequence
+static int replay(void)
+{
+    Sim s;
+    uint8_t first[SIMON_ROUNDS];
+
+    start(&s, "replay", '*', 0xDEC0DE);
+    play(&s, TYPE_AFTER_ECHO, -1, 0);
+    settle(&s);
+    memcpy(first, s.shown, sizeof(first));
+
+    start(&s, 0, '#', 0x11111111UL);    // the seed must be ignored
+    play(&s, TYPE_BURST, -1, 0);
+    settle(&s);
+    if (memcmp(first, s.shown, sizeof(first)))
+        fail(&s, "replayed a different sequence");
+    expectEnd(&s, 2, 0, 2 * ALL_KEYS);
+    report(&s);
+    return s.errors;
+}
+
+
+int main(int argc, char **argv)
+{
+    int errors = 0, opt;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+        case 'v': verbose = 1; break;
+        default:
+            fprintf(stderr, "usage: simonsim [-v]\n");
+            return 1;
+        }
+    }
+
+    errors += steady();
+    errors += burst();
+    errors += inEcho();
+    errors += wrongKey();
+    errors += invalidKey();
+    errors += keysInPlayback();
+    errors += replay();
+
+    printf("%s\n", errors ? "FAILED" : "all games as expected");
+    return errors ? 1 : 0;
+}
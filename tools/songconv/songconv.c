@@ -0,0 +1,441 @@
+/*
+ * songconv.c
+ *
+ *  Host tool that converts a song to the packed format of Lab2/song.h and
+ *  prints it as a C array ready to paste into Lab2/songs.h.
+ *
+ *  Input is either an RTTTL ringtone ("name:d=4,o=5,b=120:8e6,8e6,...")
+ *  or a standard MIDI file. From a MIDI file the track with the most notes
+ *  is taken and played one note at a time: a note starting while another
+ *  sounds cuts the first one short, gaps become rests, and the drum
+ *  channel is ignored. Lengths are matched to the nearest 1/d note,
+ *  dotted or not, and notes longer than a whole note are split.
+ *
+ *  Build:  cc -O2 -o songconv songconv.c
+ *  Use:    songconv [-n arrayName] file.mid|file.txt
+ *          songconv [-n arrayName] -r "rtttl string"
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#define MAX_NOTES       4096
+#define MAX_DIVISOR     63              // largest SONG_LEN
+#define NUM_PITCHES     89              // B0 to DS8
+#define DRUM_CHANNEL    9
+
+typedef struct Note
+{
+    int index;                          // as SONG_NOTE, 0 for a rest
+    int divisor;
+    int dotted;
+} Note;
+
+static Note notes[MAX_NOTES];
+static int noteCount;
+static int bpm;                         // 0 if the song does not set one
+
+static const char *semitoneName[12] = {
+    "C", "CS", "D", "DS", "E", "F", "FS", "G", "GS", "A", "AS", "B"
+};
+
+static void fail(const char *message)
+{
+    fprintf(stderr, "songconv: %s\n", message);
+    exit(1);
+}
+
+static void addNote(int index, int divisor, int dotted)
+{
+    if (noteCount >= MAX_NOTES)
+        fail("too many notes");
+
+    if ((index < 1) || (index > NUM_PITCHES))
+        index = 0;
+
+    notes[noteCount].index = index;
+    notes[noteCount].divisor = divisor;
+    notes[noteCount].dotted = dotted;
+    noteCount++;
+}
+
+
+// RTTTL
+
+// Same rules as Song_openRtttl() and Song_next() on the board
+static void parseRtttl(const char *text)
+{
+    static const int semitone[8] = { 9, 11, 0, 2, 4, 5, 7, 11 };   // 'a' to 'h'
+    int divisor = 4, octave = 6;
+
+    while (*text && (*text != ':'))
+        text++;
+    if (*text)
+        text++;
+
+    while (1) {
+        char key;
+        int value;
+
+        while ((*text == ' ') || (*text == ','))
+            text++;
+        if ((*text == '\0') || (*text == ':'))
+            break;
+
+        key = tolower((unsigned char)*text++);
+        while ((*text == ' ') || (*text == '='))
+            text++;
+        value = (int)strtol(text, (char **)&text, 10);
+
+        if ((key == 'd') && (value >= 1) && (value <= MAX_DIVISOR))
+            divisor = value;
+        else if ((key == 'o') && (value >= 0) && (value <= 8))
+            octave = value;
+        else if (key == 'b')
+            bpm = value;
+
+        while (*text && (*text != ',') && (*text != ':'))
+            text++;
+    }
+    if (*text == ':')
+        text++;
+
+    while (1) {
+        int d = 0, o = octave, dotted = 0, index = 0;
+        char letter;
+
+        while (isspace((unsigned char)*text) || (*text == ','))
+            text++;
+        if (*text == '\0')
+            break;
+
+        while (isdigit((unsigned char)*text))
+            d = d * 10 + (*text++ - '0');
+        if ((d < 1) || (d > MAX_DIVISOR))
+            d = divisor;
+
+        letter = tolower((unsigned char)*text);
+        if (*text)
+            text++;
+
+        if ((letter >= 'a') && (letter <= 'h')) {
+            index = semitone[letter - 'a'];
+            if (*text == '#') {
+                index++;
+                text++;
+            }
+            if (*text == '.') {
+                dotted = 1;
+                text++;
+            }
+            if (isdigit((unsigned char)*text))
+                o = (int)strtol(text, (char **)&text, 10);
+            index += o * 12 - 10;
+        }
+
+        if (*text == '.') {
+            dotted = 1;
+            text++;
+        }
+        while (*text && (*text != ','))
+            text++;
+
+        addNote(index, d, dotted);
+    }
+}
+
+
+// MIDI
+
+static const uint8_t *midi;
+static size_t midiSize;
+
+static uint32_t readBE(size_t at, int bytes)
+{
+    uint32_t value = 0;
+
+    if (at + bytes > midiSize)
+        fail("truncated MIDI file");
+    while (bytes--)
+        value = (value << 8) | midi[at++];
+    return value;
+}
+
+static uint32_t readVarLen(size_t *at, size_t end)
+{
+    uint32_t value = 0;
+    uint8_t byte;
+
+    do {
+        if (*at >= end)
+            fail("truncated MIDI track");
+        byte = midi[(*at)++];
+        value = (value << 7) | (byte & 0x7F);
+    } while (byte & 0x80);
+
+    return value;
+}
+
+static unsigned ticksPerWhole;
+
+// Matches a length in ticks to whole notes and the nearest 1/d note,
+// preferring the length already in force when two fit equally well
+static void emit(int index, uint32_t ticks)
+{
+    int d, dot, bestD = 0, bestDot = 0;
+    double best = 0;
+
+    while (ticks >= ticksPerWhole) {
+        addNote(index, 1, 0);
+        ticks -= ticksPerWhole;
+    }
+
+    if (ticks * 2 * MAX_DIVISOR < ticksPerWhole)
+        return;                             // too short to keep
+
+    for (d = 1; d <= MAX_DIVISOR; d++) {
+        for (dot = 0; dot <= 1; dot++) {
+            double length = (double)ticksPerWhole / d * (dot ? 1.5 : 1.0);
+            double error = (length > ticks) ? (length - ticks) : (ticks - length);
+            int current = noteCount && (notes[noteCount - 1].divisor == d) && !dot;
+
+            if ((bestD == 0) || (error < best) || ((error == best) && current)) {
+                best = error;
+                bestD = d;
+                bestDot = dot;
+            }
+        }
+    }
+
+    addNote(index, bestD, bestDot);
+}
+
+// Walks one track. With out 0 it only counts the note-ons, otherwise it
+// adds the track's notes and rests. The first tempo found sets bpm.
+static int walkTrack(size_t at, size_t end, int out)
+{
+    uint32_t now = 0, start = 0, lastEnd = 0;
+    uint8_t status = 0;
+    int sounding = -1, noteOns = 0;
+
+    while (at < end) {
+        uint8_t type, channel, key = 0, velocity = 0;
+
+        now += readVarLen(&at, end);
+
+        if (midi[at] & 0x80)
+            status = midi[at++];
+        else if (status == 0)
+            fail("MIDI data without a status byte");
+
+        if (status == 0xFF) {               // meta event
+            uint8_t meta = (uint8_t)readBE(at++, 1);
+            uint32_t length = readVarLen(&at, end);
+
+            if ((meta == 0x51) && (length == 3) && (bpm == 0))
+                bpm = (int)((60000000UL + readBE(at, 3) / 2) / readBE(at, 3));
+            if (meta == 0x2F)
+                break;
+            at += length;
+            status = 0;
+            continue;
+        }
+        if ((status == 0xF0) || (status == 0xF7)) { // sysex
+            at += readVarLen(&at, end);
+            status = 0;
+            continue;
+        }
+
+        type = status & 0xF0;
+        channel = status & 0x0F;
+
+        if ((type == 0xC0) || (type == 0xD0)) {
+            at += 1;
+            continue;
+        }
+
+        key = (uint8_t)readBE(at, 1);
+        velocity = (uint8_t)readBE(at + 1, 1);
+        at += 2;
+
+        if ((channel == DRUM_CHANNEL) || ((type != 0x80) && (type != 0x90)))
+            continue;
+
+        if ((type == 0x90) && velocity) {
+            noteOns++;
+            if (!out)
+                continue;
+
+            if (sounding >= 0) {
+                emit(sounding - 22, now - start);
+                lastEnd = now;
+            } else if (now > lastEnd) {
+                emit(0, now - lastEnd);
+            }
+            sounding = key;
+            start = now;
+        } else if (out && (key == sounding)) {
+            emit(sounding - 22, now - start);   // MIDI 60 is C4, SONG_NOTE(C, 4) is 38
+            sounding = -1;
+            lastEnd = now;
+        }
+    }
+
+    if (out && (sounding >= 0))
+        emit(sounding - 22, now - start);
+
+    return noteOns;
+}
+
+static void parseMidi(void)
+{
+    size_t at, track, chosen = 0, chosenEnd = 0;
+    unsigned tracks, division, i;
+    int most = -1;
+
+    if ((midiSize < 14) || memcmp(midi, "MThd", 4))
+        fail("not a MIDI file");
+
+    tracks = readBE(10, 2);
+    division = readBE(12, 2);
+    if (division & 0x8000)
+        fail("SMPTE time division is not supported");
+    ticksPerWhole = division * 4;
+
+    // The tempo usually lives in the first track, so walk them all for it
+    // and keep the one with the most notes
+    at = 8 + readBE(4, 4);
+    for (i = 0; i < tracks; i++) {
+        size_t length;
+        int count;
+
+        if (readBE(at, 4) != 0x4D54726BUL)      // "MTrk"
+            fail("bad MIDI track header");
+        length = readBE(at + 4, 4);
+        track = at + 8;
+        if (track + length > midiSize)
+            fail("truncated MIDI file");
+
+        count = walkTrack(track, track + length, 0);
+        if (count > most) {
+            most = count;
+            chosen = track;
+            chosenEnd = track + length;
+        }
+        at = track + length;
+    }
+
+    if (most <= 0)
+        fail("no notes in the MIDI file");
+
+    walkTrack(chosen, chosenEnd, 1);
+}
+
+
+// Output
+
+static void print(const char *arrayName, const char *source)
+{
+    int i, divisor = 4, column = 0;
+
+    printf("// Converted by songconv from %s\n", source);
+    printf("const uint8_t %s[] = {\n   ", arrayName);
+
+    if (bpm) {
+        if (bpm > 255) {
+            fprintf(stderr, "songconv: tempo %d is above 255, kept at 255\n", bpm);
+            bpm = 255;
+        }
+        printf(" SONG_TEMPO(%d),", bpm);
+        column++;
+    }
+
+    for (i = 0; i < noteCount; i++) {
+        const Note *n = &notes[i];
+
+        if (n->divisor != divisor) {
+            divisor = n->divisor;
+            printf("\n    SONG_LEN(%d),", divisor);
+            column = 1;
+        }
+        if (column >= 6) {
+            printf("\n   ");
+            column = 0;
+        }
+        if (n->dotted)
+            printf(" SONG_DOT,");
+        if (n->index)
+            printf(" SONG_NOTE(%s, %d),", semitoneName[(n->index + 10) % 12], (n->index + 10) / 12);
+        else
+            printf(" SONG_REST,");
+        column++;
+    }
+
+    printf("\n    SONG_END\n};\n");
+}
+
+static char *readFile(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    char *data;
+    long length;
+
+    if (!f)
+        fail("cannot open the input file");
+
+    fseek(f, 0, SEEK_END);
+    length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    data = malloc(length + 1);
+    if (!data || (fread(data, 1, length, f) != (size_t)length))
+        fail("cannot read the input file");
+    data[length] = '\0';
+    fclose(f);
+
+    *size = length;
+    return data;
+}
+
+int main(int argc, char **argv)
+{
+    const char *arrayName = "songNew";
+    const char *rtttl = 0, *path = 0;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+            arrayName = argv[++i];
+        else if (!strcmp(argv[i], "-r") && (i + 1 < argc))
+            rtttl = argv[++i];
+        else
+            path = argv[i];
+    }
+
+    if (rtttl) {
+        parseRtttl(rtttl);
+        print(arrayName, "RTTTL");
+    } else if (path) {
+        size_t size;
+        char *data = readFile(path, &size);
+
+        if ((size >= 4) && !memcmp(data, "MThd", 4)) {
+            midi = (const uint8_t *)data;
+            midiSize = size;
+            parseMidi();
+        } else {
+            parseRtttl(data);
+        }
+        print(arrayName, path);
+        free(data);
+    } else {
+        fprintf(stderr, "usage: songconv [-n arrayName] file.mid|file.txt\n"
+                        "       songconv [-n arrayName] -r \"rtttl string\"\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * msp430.h
+ *
+ *  Host stand-in for the TI device header, used by spibench in place of
+ *  the real one so Lab4/spi_slave.c and Lab4/spi_bench.c build unchanged
+ *  on a PC. It holds only what those files and the headers they include
+ *  need. The bit values are the F5529's. The USCI_B1, Timer B0 and port
+ *  registers are variables in spimodel.c. Reading UCB1RXBUF or TB0IV goes
+ *  through the model, so the reads clear their flags as on the chip.
+ *  Interrupt intrinsics do nothing: the model calls the ISRs itself, one
+ *  at a time.
+ */
+
+#ifndef HOST_MSP430_H_
+#define HOST_MSP430_H_
+
+#include <stdint.h>
+
+#define BIT0    0x0001
+#define BIT1    0x0002
+#define BIT2    0x0004
+#define BIT3    0x0008
+#define BIT4    0x0010
+#define BIT5    0x0020
+#define BIT6    0x0040
+#define BIT7    0x0080
+
+// USCI
+#define UCSWRST         0x01
+#define UCSSEL_3        0xC0
+#define UCCKPH          0x80
+#define UCMSB           0x20
+#define UCMODE_0        0x00
+#define UCSYNC          0x01
+#define UCRXIFG         0x01
+#define UCTXIFG         0x02
+#define UCRXIE          0x01
+#define UCOE            0x20
+
+// Timer B
+#define MC_3            0x0030
+#define MC__CONTINUOUS  0x0020
+#define TBSSEL__ACLK    0x0100
+#define CM_3            0xC000
+#define CCIS_0          0x0000
+#define CAP             0x0100
+#define CCIE            0x0010
+#define CCI             0x0008
+#define COV             0x0002
+#define TB0IV_TBCCR1    0x0002
+
+// Port mapping
+#define PMAPKEY         0x2D52
+#define PM_TB0CCR1A     23
+
+#define LPM3_bits       0x00D0
+
+extern volatile uint8_t UCB1CTL0, UCB1CTL1, UCB1IE, UCB1IFG, UCB1STAT;
+extern volatile uint8_t P4SEL, P4DIR, P4REN, P4OUT, P4IN, P4MAP0;
+extern volatile uint16_t PMAPKEYID, TB0CTL, TB0CCTL1;
+
+uint8_t Model_readUCB1RXBUF(void);
+uint16_t Model_readTB0IV(void);
+
+#define UCB1RXBUF       Model_readUCB1RXBUF()
+#define TB0IV           Model_readTB0IV()
+
+typedef uint16_t __istate_t;
+
+#define __get_interrupt_state()         ((__istate_t)0)
+#define __set_interrupt_state(s)        ((void)(s))
+#define __disable_interrupt()           ((void)0)
+#define __enable_interrupt()            ((void)0)
+#define __bic_SR_register_on_exit(x)    ((void)(x))
+#define __interrupt
+
+#endif /* HOST_MSP430_H_ */
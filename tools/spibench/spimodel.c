@@ -0,0 +1,353 @@
+/*
+ * spimodel.c
+ *
+ *  Host stand-in for the Lab 4 SPI loopback, so the stress test of
+ *  Lab4/spi_bench.c runs on Linux (e.g. in CI) unchanged. The real slave
+ *  driver, Lab4/spi_slave.c, runs on top of a register model of USCI_B1
+ *  and the Timer B0 CS capture. The master side, USCI_B0 behind the SPI
+ *  bus, is modelled at its API: SPIBus_setClock() and SPIBus_transfer().
+ *
+ *  Time is counted in SMCLK cycles. The master shifts a byte in 8 x the
+ *  divider, with TXBUF double buffering. One CPU runs the interrupts in
+ *  F5529 priority order: Timer0_B1 (CS edges), then USCI_B0 (master TX),
+ *  then USCI_B1 (slave RX). Each takes a set number of cycles. A byte that
+ *  reaches UCB1RXBUF before the last one was read sets UCOE, as on the
+ *  chip, so fast dividers overrun when the master interrupt starves the
+ *  slave's. The cycle counts are estimates for the default 1.048576 MHz
+ *  clocks and can be changed on the command line. Only the relative
+ *  throughput of the settings means much.
+ *
+ *  -e injects bit errors on the wire. The model keeps its own tally of the
+ *  frames the slave must drop and the bits that reach the bench flipped.
+ *  After each setting it checks SPIBench_run()'s result against that
+ *  tally, and the exit status is non-zero on any mismatch.
+ *
+ *  Build:  cc -O2 -I. -I../../Lab4 -o spibench spimodel.c \
+ *             ../../Lab4/spi_bench.c ../../Lab4/spi_slave.c
+ *  Use:    spibench [-e bit error rate] [-m master ISR] [-s slave ISR] [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <msp430.h>
+#include "spi_bus.h"
+#include "spi_slave.h"
+#include "spi_bench.h"
+#include "timebase.h"
+#include "debug_uart.h"
+
+#define SMCLK_HZ        1048576ULL
+
+// The F5529 USCI_B1 ISR and Timer0_B1 ISR in spi_slave.c
+void USCI_B1_ISR(void);
+void TIMER0_B1_ISR(void);
+
+volatile uint8_t UCB1CTL0, UCB1CTL1, UCB1IE, UCB1IFG, UCB1STAT;
+volatile uint8_t P4SEL, P4DIR, P4REN, P4OUT, P4IN = BIT0, P4MAP0;
+volatile uint16_t PMAPKEYID, TB0CTL, TB0CCTL1;
+
+static uint8_t rxbuf;
+static uint16_t tb0iv;
+
+// Cycle costs, estimates at 1 MHz
+static unsigned setupCycles = 60;       // queue the transaction, CS low, first TXBUF write
+static unsigned masterIsrCycles = 35;   // USCI_B0 TX interrupt: next byte into TXBUF
+static unsigned slaveIsrCycles = 45;    // USCI_B1 RX interrupt, RXBUF read in the middle
+static unsigned slaveReadCycles = 25;
+static unsigned csIsrCycles = 40;       // Timer0_B1 CS edge interrupt
+static unsigned endCycles = 50;         // wait for UCBUSY, CS hold, CS high, completion
+static unsigned pollCycles = 12;        // one pass of a wait loop around Timebase_ticks()
+
+static double bitErrorRate;
+static int verbose;
+
+static uint64_t now;                    // SMCLK cycles
+static uint16_t clkTicks = 8;
+
+// What the bench must find, tallied by the model
+typedef struct Truth
+{
+    uint32_t bitErrors;
+    uint16_t byteErrors;
+    uint16_t lostBytes;
+    uint16_t overruns;
+} Truth;
+
+static Truth truth;
+
+
+uint8_t Model_readUCB1RXBUF(void)
+{
+    UCB1IFG &= ~UCRXIFG;
+    UCB1STAT &= ~UCOE;
+    return rxbuf;
+}
+
+uint16_t Model_readTB0IV(void)
+{
+    uint16_t iv = tb0iv;
+
+    tb0iv = 0;
+    return iv;
+}
+
+uint32_t Timebase_ticks(void)
+{
+    now += pollCycles;
+    return (uint32_t)(now * TIMEBASE_TICKS_PER_SEC / SMCLK_HZ);
+}
+
+// The bench reports on the debug UART; here that is stdout
+void DebugUart_print(const char *s)
+{
+    fputs(s, stdout);
+}
+
+void DebugUart_printNum(uint32_t n)
+{
+    printf("%lu", (unsigned long)n);
+}
+
+void SPIBus_setClock(uint8_t device, uint16_t ticks)
+{
+    (void)device;
+    clkTicks = ticks ? ticks : 1;
+}
+
+static uint8_t noise(void)
+{
+    uint8_t flip = 0;
+    int b;
+
+    if (bitErrorRate <= 0)
+        return 0;
+    for (b = 0; b < 8; b++)
+        if (drand48() < bitErrorRate)
+            flip |= 1 << b;
+    return flip;
+}
+
+static int countBits(uint8_t x)
+{
+    int n = 0;
+
+    while (x) {
+        x &= x - 1;
+        n++;
+    }
+    return n;
+}
+
+// Counts of one frame
+typedef struct FrameTally
+{
+    int overrun;                // some byte was lost in RXBUF
+    int flippedBits;
+    int flippedBytes;
+} FrameTally;
+
+// The byte in the master's shifter has reached UCB1RXBUF
+static void byteArrives(uint8_t byte, FrameTally *tally)
+{
+    uint8_t flip = noise();
+
+    if (UCB1IFG & UCRXIFG) {
+        UCB1STAT |= UCOE;               // the unread byte is lost
+        tally->overrun = 1;
+    }
+    rxbuf = byte ^ flip;
+    UCB1IFG |= UCRXIFG;
+
+    if (flip) {
+        tally->flippedBits += countBits(flip);
+        tally->flippedBytes++;
+    }
+}
+
+// A CS edge as the Timer B0 capture sees it
+static void csEdge(int high)
+{
+    if (high) {
+        P4IN |= BIT0;
+        TB0CCTL1 |= CCI;
+    } else {
+        P4IN &= ~BIT0;
+        TB0CCTL1 &= ~CCI;
+    }
+    tb0iv = TB0IV_TBCCR1;
+    TIMER0_B1_ISR();
+}
+
+// Runs one frame through the loopback: the master shifting bytes out, the
+// CPU taking the interrupts, the slave driver receiving. Returns when CS
+// has gone high and the transaction is complete.
+void SPIBus_transfer(SPIBus_Xfer *xfer)
+{
+    const uint64_t byteTime = 8ULL * clkTicks;
+    uint16_t len = xfer->len;
+    uint16_t written, shifting;         // bytes written to TXBUF, byte in the shifter
+    int txbufFull = 0, shifterBusy;
+    uint64_t shiftEnd, cpuFree;
+    int masterWants, slaveWants;
+    FrameTally tally = {0, 0, 0};
+
+    if (len == 0)
+        return;
+
+    now += setupCycles;
+
+    // CS low: the capture interrupt opens the frame
+    csEdge(0);
+    cpuFree = now + csIsrCycles;
+
+    // Byte 0 goes straight to the shifter, TXBUF is empty again
+    written = 1;
+    shifting = 0;
+    shifterBusy = 1;
+    shiftEnd = now + byteTime;
+    masterWants = (written < len);
+    slaveWants = 0;
+
+    while (shifterBusy || masterWants || slaveWants) {
+        uint64_t start = (cpuFree > now) ? cpuFree : now;
+
+        // A byte that finishes before the CPU is free lands first
+        if (shifterBusy && (shiftEnd <= start || (!masterWants && !slaveWants))) {
+            now = shiftEnd;
+            byteArrives(xfer->tx[shifting++], &tally);
+            slaveWants = 1;
+
+            if (txbufFull) {
+                txbufFull = 0;
+                shiftEnd = now + byteTime;
+                masterWants = (written < len);
+            } else {
+                shifterBusy = 0;
+            }
+            continue;
+        }
+
+        now = start;
+        if (masterWants) {
+            // USCI_B0 outranks USCI_B1
+            masterWants = 0;
+            cpuFree = now + masterIsrCycles;
+            if (shifterBusy && (shiftEnd < cpuFree)) {
+                // The write lands after the byte in the shifter is done
+                now = shiftEnd;
+                byteArrives(xfer->tx[shifting++], &tally);
+                slaveWants = 1;
+                shifterBusy = 0;
+            }
+            now = cpuFree;
+            written++;
+            if (!shifterBusy) {
+                shifterBusy = 1;
+                shiftEnd = now + byteTime;
+                masterWants = (written < len);
+            } else {
+                txbufFull = 1;
+            }
+        } else if (slaveWants) {
+            slaveWants = 0;
+            now += slaveReadCycles;
+            if (shifterBusy && (shiftEnd <= now) && !txbufFull) {
+                // Another byte lands before RXBUF is read
+                byteArrives(xfer->tx[shifting++], &tally);
+                shifterBusy = 0;
+            }
+            if (UCB1STAT & UCOE)
+                truth.overruns++;
+            USCI_B1_ISR();
+            cpuFree = now + (slaveIsrCycles - slaveReadCycles);
+        }
+    }
+
+    // CS high once the last byte is out; the capture interrupt takes a
+    // byte still in RXBUF and closes the frame
+    now = ((cpuFree > now) ? cpuFree : now) + endCycles;
+    if (UCB1STAT & UCOE)
+        truth.overruns++;
+    csEdge(1);
+    now += csIsrCycles;
+
+    if (tally.overrun) {
+        truth.lostBytes += len;
+    } else {
+        truth.bitErrors += tally.flippedBits;
+        truth.byteErrors += tally.flippedBytes;
+    }
+
+    if (verbose > 1)
+        printf("  frame of %u at %llu: %s, %d bits flipped\n", len,
+               (unsigned long long)now, tally.overrun ? "overrun" : "ok", tally.flippedBits);
+}
+
+
+static int check(const SPIBench_Result *r)
+{
+    int errors = 0;
+
+    if (r->bitErrors != truth.bitErrors) {
+        fprintf(stderr, "spibench: /%u bit errors %lu, model flipped %lu\n", r->clkTicks,
+                (unsigned long)r->bitErrors, (unsigned long)truth.bitErrors);
+        errors++;
+    }
+    if (r->byteErrors != truth.byteErrors) {
+        fprintf(stderr, "spibench: /%u byte errors %u, model %u\n", r->clkTicks,
+                r->byteErrors, truth.byteErrors);
+        errors++;
+    }
+    if (r->lostBytes != truth.lostBytes) {
+        fprintf(stderr, "spibench: /%u lost %u bytes, model dropped %u\n", r->clkTicks,
+                r->lostBytes, truth.lostBytes);
+        errors++;
+    }
+    if (r->overruns != truth.overruns) {
+        fprintf(stderr, "spibench: /%u %u overruns, model %u\n", r->clkTicks,
+                r->overruns, truth.overruns);
+        errors++;
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    // As benchDividers in Lab4/main.c
+    static const uint16_t dividers[] = {64, 32, 16, 8, 4, 2, 1};
+    SPIBench_Result result;
+    int errors = 0, opt;
+    unsigned i;
+
+    while ((opt = getopt(argc, argv, "e:m:s:v")) != -1) {
+        switch (opt) {
+        case 'e': bitErrorRate = atof(optarg); break;
+        case 'm': masterIsrCycles = atoi(optarg); break;
+        case 's': slaveIsrCycles = atoi(optarg); break;
+        case 'v': verbose++; break;
+        default:
+            fprintf(stderr, "usage: spibench [-e bit error rate] [-m master ISR cycles] "
+                            "[-s slave ISR cycles] [-v]\n");
+            return 1;
+        }
+    }
+    if (slaveReadCycles > slaveIsrCycles)
+        slaveReadCycles = slaveIsrCycles;
+
+    srand48(1);
+    SPISlave_init();
+
+    for (i = 0; i < sizeof(dividers) / sizeof(dividers[0]); i++) {
+        Truth none = {0, 0, 0, 0};
+
+        truth = none;
+        SPIBench_run(0, dividers[i], &result);
+        SPIBench_print(&result);
+        errors += check(&result);
+    }
+
+    printf("%s\n", errors ? "FAILED: the bench and the model disagree" : "bench counts match the model");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,358 @@
+/*
+ * telemrx.c
+ *
+ *  Host receiver for the telemetry stream of Lab3/Lab4 (telemetry.h).
+ *  Reads packets from the LaunchPad's application COM port, checks each
+ *  one's CRC, and writes every record as a CSV line:
+ *
+ *      host_time,board_time,channel,value
+ *
+ *  host_time is when the packet arrived (Unix seconds), board_time the
+ *  record's time base stamp in seconds, kept counting across the 32-bit
+ *  tick wrap. Bytes that are not part of a valid packet are skipped, so
+ *  the receiver picks the stream up mid-packet or after debug text.
+ *  Display mirror packets (lcd_mirror.h, read by tools/lcdmirror) are
+ *  checked and stepped over. A
+ *  summary of packets, records, CRC errors and lost packets goes to
+ *  stderr at the end.
+ *
+ *  With -b the program is a stand-in for the board instead: it opens a
+ *  pseudo-terminal, prints the path to give the receiver, and sends
+ *  packets of made-up readings on it. -e n damages every nth packet.
+ *
+ *  Build:  cc -O2 -o telemrx telemrx.c -lm
+ *  Use:    telemrx [-s baud] /dev/ttyACM0 > log.csv
+ *          telemrx -b [-r records/s] [-e n]
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <math.h>
+
+#define SYNC1           0xA5
+#define SYNC2           0x5A
+#define HEADER_LEN      4
+#define RECORD_LEN      9
+#define PACKET_LEN(n)   (HEADER_LEN + (n) * RECORD_LEN + 2)
+#define MAX_RECORDS     64              // larger counts are taken as noise
+#define TICKS_PER_SEC   32768.0
+
+#define SYNC2_MIRROR    0xC3
+#define MIRROR_HEADER_LEN 7
+#define MIRROR_MAX_DATA 2304            // 128 lines of 18 bytes
+#define MIRROR_LEN(n)   (MIRROR_HEADER_LEN + (n) + 2)
+
+static volatile sig_atomic_t stop;
+
+static unsigned long packets, records, crcErrors, lostPackets, skippedBytes;
+
+
+static void onSignal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+// CRC-16/CCITT as on the board: polynomial 0x1021, initial 0xFFFF, MSB first
+static uint16_t crc16(const uint8_t *p, int len)
+{
+    uint16_t crc = 0xFFFF;
+    int i;
+
+    while (len--) {
+        crc ^= (uint16_t)*p++ << 8;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+static double hostTime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static speed_t baudConstant(long baud)
+{
+    switch (baud) {
+    case 9600:      return B9600;
+    case 19200:     return B19200;
+    case 38400:     return B38400;
+    case 57600:     return B57600;
+    case 115200:    return B115200;
+    case 230400:    return B230400;
+    case 460800:    return B460800;
+    case 921600:    return B921600;
+    }
+    fprintf(stderr, "telemrx: unsupported baud rate %ld\n", baud);
+    exit(1);
+}
+
+// Raw 8N1 at the given rate. Pseudo-terminals take the settings and
+// ignore the rate.
+static void setupPort(int fd, long baud)
+{
+    struct termios tio;
+
+    if (!isatty(fd) || (tcgetattr(fd, &tio) < 0))
+        return;
+
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, baudConstant(baud));
+    cfsetospeed(&tio, baudConstant(baud));
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+
+//------------------------------------------------------------------------------
+// Receiver
+//------------------------------------------------------------------------------
+
+// Tracks the 32-bit tick count across wraps
+static uint32_t lastTicks;
+static uint64_t tickBase;
+static int haveTicks;
+
+static double boardTime(uint32_t ticks)
+{
+    if (haveTicks && (ticks < lastTicks) && (lastTicks - ticks > 0x80000000UL))
+        tickBase += 0x100000000ULL;
+    lastTicks = ticks;
+    haveTicks = 1;
+    return (tickBase + ticks) / TICKS_PER_SEC;
+}
+
+static void writeRecords(const uint8_t *packet, int count, double arrived)
+{
+    const uint8_t *r = packet + HEADER_LEN;
+    int i;
+
+    for (i = 0; i < count; i++, r += RECORD_LEN) {
+        printf("%.6f,%.6f,%u,%ld\n", arrived, boardTime(get32(r)), r[4],
+               (long)(int32_t)get32(r + 5));
+        records++;
+    }
+    fflush(stdout);
+}
+
+// Takes every complete packet from the front of buf. Returns the number
+// of bytes used up; the rest is kept for the next read.
+static int decode(const uint8_t *buf, int len, double arrived)
+{
+    static int haveSeq;
+    static uint8_t nextSeq;
+    int pos = 0;
+
+    while (len - pos >= HEADER_LEN) {
+        const uint8_t *p = buf + pos;
+        int count, total;
+
+        // Display mirror packets are not ours, but are not noise either
+        if ((p[0] == SYNC1) && (p[1] == SYNC2_MIRROR)) {
+            if (len - pos < MIRROR_HEADER_LEN)
+                break;
+            total = MIRROR_LEN(p[5] | (p[6] << 8));
+            if ((total <= MIRROR_LEN(MIRROR_MAX_DATA)) && (len - pos < total))
+                break;
+            if ((total <= MIRROR_LEN(MIRROR_MAX_DATA)) &&
+                (crc16(p + 2, total - 4) == ((p[total - 2] << 8) | p[total - 1]))) {
+                pos += total;
+                continue;
+            }
+        }
+
+        if ((p[0] != SYNC1) || (p[1] != SYNC2) || (p[3] > MAX_RECORDS)) {
+            pos++;
+            skippedBytes++;
+            continue;
+        }
+
+        count = p[3];
+        total = PACKET_LEN(count);
+        if (len - pos < total)
+            break;                      // wait for the rest
+
+        if (crc16(p + 2, total - 4) != ((p[total - 2] << 8) | p[total - 1])) {
+            crcErrors++;
+            pos++;                      // look for the next sync from here
+            skippedBytes++;
+            continue;
+        }
+
+        if (haveSeq && (p[2] != nextSeq))
+            lostPackets += (uint8_t)(p[2] - nextSeq);
+        haveSeq = 1;
+        nextSeq = p[2] + 1;
+        packets++;
+
+        writeRecords(p, count, arrived);
+        pos += total;
+    }
+    return pos;
+}
+
+static int receive(const char *path, long baud)
+{
+    static uint8_t buf[4096];
+    int fd, have = 0;
+
+    fd = open(path, O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    setupPort(fd, baud);
+
+    printf("host_time,board_time,channel,value\n");
+
+    while (!stop) {
+        ssize_t n = read(fd, buf + have, sizeof(buf) - have);
+        int used;
+
+        if (n <= 0)
+            break;                      // EOF, board gone, or interrupted
+        have += n;
+
+        used = decode(buf, have, hostTime());
+        memmove(buf, buf + used, have - used);
+        have -= used;
+
+        if (have == sizeof(buf)) {      // cannot happen with valid packets
+            skippedBytes += have;
+            have = 0;
+        }
+    }
+
+    close(fd);
+    fprintf(stderr, "telemrx: %lu packets, %lu records, %lu CRC errors, %lu lost packets, %lu bytes skipped\n",
+            packets, records, crcErrors, lostPackets, skippedBytes);
+    return 0;
+}
+
+
+//------------------------------------------------------------------------------
+// Stand-in board
+//------------------------------------------------------------------------------
+
+static int board(int recordsPerSec, int damageEvery)
+{
+    uint8_t packet[PACKET_LEN(16)];
+    uint32_t ticks = 0;
+    uint8_t seq = 0;
+    unsigned long sent = 0;
+    int fd, count, i;
+
+    fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((fd < 0) || (grantpt(fd) < 0) || (unlockpt(fd) < 0)) {
+        perror("posix_openpt");
+        return 1;
+    }
+    setupPort(fd, 115200);
+    fprintf(stderr, "telemrx: board on %s\n", ptsname(fd));
+
+    // Three channels at a time, as Lab3 does once a second
+    count = 3;
+
+    while (!stop) {
+        uint16_t crc;
+        int len = PACKET_LEN(count);
+
+        packet[0] = SYNC1;
+        packet[1] = SYNC2;
+        packet[2] = seq++;
+        packet[3] = count;
+        for (i = 0; i < count; i++) {
+            uint8_t *r = packet + HEADER_LEN + i * RECORD_LEN;
+            double t = ticks / TICKS_PER_SEC;
+            int32_t value;
+
+            switch (i) {
+            case 0:  value = 2048 + (int32_t)(1000 * sin(t)); break;
+            case 1:  value = 250 + (int32_t)(20 * sin(t / 10)); break;
+            default: value = -(int32_t)sent; break;
+            }
+            put32(r, ticks);
+            r[4] = i + 1;
+            put32(r + 5, (uint32_t)value);
+        }
+        crc = crc16(packet + 2, len - 4);
+        packet[len - 2] = crc >> 8;
+        packet[len - 1] = crc & 0xFF;
+
+        sent++;
+        if (damageEvery && (sent % damageEvery == 0))
+            packet[HEADER_LEN] ^= 0x01;
+
+        if (write(fd, packet, len) != len)
+            break;
+
+        ticks += (uint32_t)(TICKS_PER_SEC * count / recordsPerSec);
+        usleep(1000000L * count / recordsPerSec);
+    }
+
+    close(fd);
+    fprintf(stderr, "telemrx: %lu packets sent\n", sent);
+    return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+    long baud = 115200;
+    int boardMode = 0, recordsPerSec = 30, damageEvery = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:br:e:")) != -1) {
+        switch (opt) {
+        case 's': baud = atol(optarg); break;
+        case 'b': boardMode = 1; break;
+        case 'r': recordsPerSec = atoi(optarg); break;
+        case 'e': damageEvery = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: telemrx [-s baud] device > log.csv\n"
+                            "       telemrx -b [-r records/s] [-e n]\n");
+            return 1;
+        }
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    if (boardMode)
+        return board(recordsPerSec > 0 ? recordsPerSec : 30, damageEvery);
+
+    if (optind >= argc) {
+        fprintf(stderr, "telemrx: no device given\n");
+        return 1;
+    }
+    return receive(argv[optind], baud);
+}